@@ -38,11 +38,24 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
 #include <time.h>
 #include <math.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <algorithm>
 // Needed for definition of remote attestation messages.
 #include "remote_attestation_result.h"
 
@@ -82,6 +95,33 @@ int oblivStructureSizes[NUM_STRUCTURES] = {0};
 int oblivStructureTypes[NUM_STRUCTURES] = {0};
 uint8_t* oblivStructures[NUM_STRUCTURES] = {0}; //hold pointers to start of each oblivious data structure
 FILE *readFile = NULL;
+int readTableSize = -1; //snapshot readFile belongs to, its mapped blocks are in testTable<readTableSize>.dat
+std::atomic<long> blockTransitions(0); //ocalls that move structure blocks, lets benchmarks count enclave transitions. scan workers make them from several threads at once
+std::atomic<long> oramBytesMoved(0); //bytes the oram path and slot ocalls copy, lets benchmarks compare oram bandwidth
+Storage_Type oblivStorage[NUM_STRUCTURES] = {STORAGE_MEMORY}; //how each structure's blocks are held
+long oblivStorageBytes[NUM_STRUCTURES] = {0};
+int oblivBlockSizes[NUM_STRUCTURES] = {0}; //bytes per stored block, the enclave picks it
+const char* storageDir = "."; //where STORAGE_MMAP files go, one per structure id
+int mmapSequentialHint = 1; //tell the kernel linear scan files are read front to back
+long mmapPopulateLimit = 64L*1024*1024; //files up to this size are faulted in when they are mapped
+
+typedef struct{ //batches of one linear scan copied out of storage ahead of the enclave, see ocall_open_prefetch
+	int inUse;
+	int structureId;
+	int startIndex; //blocks [startIndex, endIndex)
+	int endIndex;
+	int blockSize;
+	uint8_t* data; //PREFETCH_RING_BATCHES slots of SCAN_BATCH_SIZE blocks, batch b goes in slot b%PREFETCH_RING_BATCHES
+	long filled; //batches copied in so far
+	long taken; //batches handed to the enclave so far
+	int stop;
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread worker;
+} Prefetch_Ring;
+Prefetch_Ring prefetchRings[MAX_PREFETCH_RINGS];
+std::mutex prefetchRingsLock;
+int prefetchEnabled = 1; //0 makes every scan read its batches itself
 
 uint8_t* msg1_samples[] = { msg1_sample1, msg1_sample2 };
 uint8_t* msg2_samples[] = { msg2_sample1, msg2_sample2 };
@@ -203,6 +243,7 @@ void ocall_read_block(int structureId, int index, int blockSize, void *buffer){
 	}//printf("heer\n");fflush(stdout);
 	//printf("index: %d, blockSize: %d structureId: %d\n", index, blockSize, structureId);
 	//printf("start %d, addr: %d, expGap: %d\n", oblivStructures[structureId], oblivStructures[structureId]+index*blockSize, index*blockSize);fflush(stdout);
+	blockTransitions++;
 	memcpy(buffer, oblivStructures[structureId]+((long)index*blockSize), blockSize);//printf("heer\n");fflush(stdout);
 	//printf("beginning of mac(app)? %d\n", ((Encrypted_Linear_Scan_Block*)(oblivStructures[structureId]+(index*encBlockSize)))->macTag[0]);
 	//printf("beginning of mac(buf)? %d\n", ((Encrypted_Linear_Scan_Block*)(buffer))->macTag[0]);
@@ -221,6 +262,7 @@ void ocall_write_block(int structureId, int index, int blockSize, void *buffer){
 		printf("in structure 3");fflush(stdout);
 	}*/
 	//printf("here! blocksize %d, index %d, structureId %d\n", blockSize, index, structureId);
+	blockTransitions++;
 	memcpy(oblivStructures[structureId]+((long)index*blockSize), buffer, blockSize);
 	//printf("here2\n");
 	//debug code
@@ -228,37 +270,274 @@ void ocall_write_block(int structureId, int index, int blockSize, void *buffer){
 	//printf("beginning of mac? %d\n", ((Encrypted_Linear_Scan_Block*)(oblivStructures[structureId]+(index*encBlockSize)))->macTag[0]);
 }
 
+void ocall_read_blocks(int structureId, int index, int numBlocks, int blockSize, void *buffer){ //read numBlocks consecutive blocks in to buffer
+	if(blockSize == 0){
+		printf("unkown oblivious data type\n");
+		return;
+	}
+	blockTransitions++;
+	memcpy(buffer, oblivStructures[structureId]+((long)index*blockSize), (long)numBlocks*blockSize);
+}
+
+void ocall_write_blocks(int structureId, int index, int numBlocks, int blockSize, void *buffer){ //write out numBlocks consecutive blocks from buffer
+	if(blockSize == 0){
+		printf("unkown oblivious data type\n");
+		return;
+	}
+	blockTransitions++;
+	memcpy(oblivStructures[structureId]+((long)index*blockSize), buffer, (long)numBlocks*blockSize);
+}
+
+//a dml pass hands back one batch and takes the next in the same transition, the write goes first
+void ocall_swap_blocks(int structureId, int writeIndex, int numWrite, int readIndex, int numRead, int blockSize, void *writeBuffer, void *readBuffer){
+	if(blockSize == 0){
+		printf("unkown oblivious data type\n");
+		return;
+	}
+	blockTransitions++;
+	memcpy(oblivStructures[structureId]+((long)writeIndex*blockSize), writeBuffer, (long)numWrite*blockSize);
+	memcpy(readBuffer, oblivStructures[structureId]+((long)readIndex*blockSize), (long)numRead*blockSize);
+}
+
+void ocall_read_path(int structureId, int leaf, int numBuckets, int bucketSize, void *buffer){ //read the buckets from leaf up to the root, leaf first
+	blockTransitions++;
+	oramBytesMoved += (long)numBuckets*bucketSize;
+	long nodeNumber = oblivStructureSizes[structureId]/2+leaf;
+	for(int i = 0; i < numBuckets; i++){
+		memcpy((uint8_t*)buffer+(long)i*bucketSize, oblivStructures[structureId]+nodeNumber*bucketSize, bucketSize);
+		nodeNumber = (nodeNumber-1)/2;
+	}
+}
+
+void ocall_write_path(int structureId, int leaf, int numBuckets, int bucketSize, void *buffer){ //write the buckets from leaf up to the root, leaf first
+	blockTransitions++;
+	oramBytesMoved += (long)numBuckets*bucketSize;
+	long nodeNumber = oblivStructureSizes[structureId]/2+leaf;
+	for(int i = 0; i < numBuckets; i++){
+		memcpy(oblivStructures[structureId]+nodeNumber*bucketSize, (uint8_t*)buffer+(long)i*bucketSize, bucketSize);
+		nodeNumber = (nodeNumber-1)/2;
+	}
+}
+
+void ocall_read_slots(int structureId, int numBlocks, int blockSize, int *indices, void *buffer){ //gather single blocks of a ring oram
+	blockTransitions++;
+	oramBytesMoved += (long)numBlocks*blockSize;
+	for(int i = 0; i < numBlocks; i++){
+		memcpy((uint8_t*)buffer+(long)i*blockSize, oblivStructures[structureId]+(long)indices[i]*blockSize, blockSize);
+	}
+}
+
+void ocall_write_slots(int structureId, int numBlocks, int blockSize, int *indices, void *buffer){
+	blockTransitions++;
+	oramBytesMoved += (long)numBlocks*blockSize;
+	for(int i = 0; i < numBlocks; i++){
+		memcpy(oblivStructures[structureId]+(long)indices[i]*blockSize, (uint8_t*)buffer+(long)i*blockSize, blockSize);
+	}
+}
+
 void ocall_respond( uint8_t* message, size_t message_size, uint8_t* gcm_mac){
 	printf("ocall response\n");
 }
 
-void ocall_newStructure(int newId, Obliv_Type type, int size){ //this is actual size, the logical size will be smaller for orams
+//runs on its own thread, copying batches into the ring until the scan's range is done or the ring is closed
+void prefetchLoop(Prefetch_Ring* ring){
+	long batchBytes = (long)SCAN_BATCH_SIZE*ring->blockSize;
+	for(long batch = 0; ; batch++){
+		long index = ring->startIndex + batch*SCAN_BATCH_SIZE;
+		if(index >= ring->endIndex) break;
+		int numBlocks = ring->endIndex - index;
+		if(numBlocks > SCAN_BATCH_SIZE) numBlocks = SCAN_BATCH_SIZE;
+		{
+			std::unique_lock<std::mutex> guard(ring->lock);
+			while(!ring->stop && batch - ring->taken >= PREFETCH_RING_BATCHES) ring->changed.wait(guard);
+			if(ring->stop) break;
+		}
+		//the slot is free until the enclave takes this batch, so the copy needs no lock
+		memcpy(ring->data+(batch%PREFETCH_RING_BATCHES)*batchBytes, oblivStructures[ring->structureId]+index*ring->blockSize, (long)numBlocks*ring->blockSize);
+		{
+			std::lock_guard<std::mutex> guard(ring->lock);
+			ring->filled++;
+		}
+		ring->changed.notify_all();
+	}
+}
+
+//starts copying blocks [startIndex, endIndex) of a structure into a free ring, a batch at a time
+//returns the ring id, or -1 if prefetching is off or every ring is busy, in which case the enclave reads directly
+int ocall_open_prefetch(int structureId, int startIndex, int endIndex, int blockSize){
+	if(!prefetchEnabled) return -1;
+	std::lock_guard<std::mutex> guard(prefetchRingsLock);
+	for(int i = 0; i < MAX_PREFETCH_RINGS; i++){
+		Prefetch_Ring* ring = &prefetchRings[i];
+		if(ring->inUse) continue;
+		ring->data = (uint8_t*)malloc((long)PREFETCH_RING_BATCHES*SCAN_BATCH_SIZE*blockSize);
+		if(!ring->data) return -1;
+		ring->structureId = structureId;
+		ring->startIndex = startIndex;
+		ring->endIndex = endIndex;
+		ring->blockSize = blockSize;
+		ring->filled = 0;
+		ring->taken = 0;
+		ring->stop = 0;
+		ring->inUse = 1;
+		ring->worker = std::thread(prefetchLoop, ring);
+		return i;
+	}
+	return -1;
+}
+
+//hands the enclave the next batch in order, waiting for the prefetch thread if it has not got there yet
+void ocall_read_prefetched(int ringId, int numBlocks, int blockSize, void *buffer){
+	Prefetch_Ring* ring = &prefetchRings[ringId];
+	blockTransitions++;
+	std::unique_lock<std::mutex> guard(ring->lock);
+	while(ring->filled <= ring->taken) ring->changed.wait(guard);
+	long slot = ring->taken%PREFETCH_RING_BATCHES;
+	guard.unlock();
+	memcpy(buffer, ring->data+slot*SCAN_BATCH_SIZE*blockSize, (long)numBlocks*blockSize);
+	guard.lock();
+	ring->taken++;
+	guard.unlock();
+	ring->changed.notify_all();
+}
+
+void ocall_close_prefetch(int ringId){
+	Prefetch_Ring* ring = &prefetchRings[ringId];
+	{
+		std::lock_guard<std::mutex> guard(ring->lock);
+		ring->stop = 1;
+	}
+	ring->changed.notify_all();
+	ring->worker.join();
+	free(ring->data);
+	ring->data = NULL;
+	std::lock_guard<std::mutex> guard(prefetchRingsLock);
+	ring->inUse = 0;
+}
+
+void structureFileName(int structureId, char* name, int nameLen){
+	snprintf(name, nameLen, "%s/oblivStructure%d.dat", storageDir, structureId);
+}
+
+//maps a file of val bytes for the structure; the file is sparse, so untouched blocks take no disk
+uint8_t* mapStructureFile(int structureId, Obliv_Type type, long val){
+	char name[256];
+	structureFileName(structureId, name, sizeof(name));
+	int fd = open(name, O_RDWR | O_CREAT, 0600);
+	if(fd == -1) return NULL;
+	if(ftruncate(fd, val) != 0){
+		close(fd);
+		return NULL;
+	}
+	int flags = MAP_SHARED;
+	if(val <= mmapPopulateLimit) flags |= MAP_POPULATE;
+	void* addr = mmap(NULL, val, PROT_READ | PROT_WRITE, flags, fd, 0);
+	close(fd); //the mapping keeps the file open
+	if(addr == MAP_FAILED) return NULL;
+	if(type == TYPE_LINEAR_SCAN || type == TYPE_LINEAR_UNENCRYPTED){
+		if(mmapSequentialHint) madvise(addr, val, MADV_SEQUENTIAL);
+	}
+	else {
+		madvise(addr, val, MADV_RANDOM); //oram paths are all over the file
+	}
+	return (uint8_t*)addr;
+}
+
+//writes back a mapped structure and drops its pages from the page cache, so the next scan reads it from disk
+int evictStructurePages(int structureId){
+	if(oblivStorage[structureId] != STORAGE_MMAP) return 1;
+	char name[256];
+	structureFileName(structureId, name, sizeof(name));
+	if(msync(oblivStructures[structureId], oblivStorageBytes[structureId], MS_SYNC) != 0) return 1;
+	madvise(oblivStructures[structureId], oblivStorageBytes[structureId], MADV_DONTNEED);
+	int fd = open(name, O_RDONLY);
+	if(fd == -1) return 1;
+	int ret = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+	return ret != 0;
+}
+
+void ocall_newStructure(int newId, Obliv_Type type, int size, int blockSize, Storage_Type storage){ //this is actual size, the logical size will be smaller for orams
     //printf("app: initializing structure type %d of capacity %d blocks\n", type, size);
-    int encBlockSize = getEncBlockSize(type);
-    if(type == TYPE_ORAM || type == TYPE_TREE_ORAM) encBlockSize = sizeof(Encrypted_Oram_Bucket);
-    //printf("Encrypted blocks of this type get %d bytes of storage\n", encBlockSize);
+    //printf("Encrypted blocks of this type get %d bytes of storage\n", blockSize);
     oblivStructureSizes[newId] = size;
     oblivStructureTypes[newId] = type;
-    long val = (long)encBlockSize*size;
+    oblivBlockSizes[newId] = blockSize;
+    long val = (long)blockSize*size;
+    oblivStorage[newId] = storage;
+    oblivStorageBytes[newId] = val;
     //printf("mallocing %ld bytes\n", val);
-    oblivStructures[newId] = (uint8_t*)malloc(val);
+    if(storage == STORAGE_MMAP){
+    	oblivStructures[newId] = mapStructureFile(newId, type, val);
+    }
+    else {
+    	oblivStructures[newId] = (uint8_t*)malloc(val);
+    }
     if(!oblivStructures[newId]) {
     	printf("failed to allocate space (%ld bytes) for structure\n", val);fflush(stdout);
     }
 }
 
+int ocall_resizeStructure(int structureId, int newSize){
+	Obliv_Type type = (Obliv_Type)oblivStructureTypes[structureId];
+	long oldVal = oblivStorageBytes[structureId];
+	long val = (long)oblivBlockSizes[structureId]*newSize;
+	uint8_t* grown;
+	if(oblivStorage[structureId] == STORAGE_MMAP){
+		//the file keeps its contents up to the new length, so just map it again
+		munmap(oblivStructures[structureId], oldVal);
+		grown = mapStructureFile(structureId, type, val);
+		if(!grown) oblivStructures[structureId] = mapStructureFile(structureId, type, oldVal);
+	}
+	else {
+		grown = (uint8_t*)realloc(oblivStructures[structureId], val);
+	}
+	if(!grown){
+		printf("failed to resize structure %d to %ld bytes\n", structureId, val);fflush(stdout);
+		return 1;
+	}
+	oblivStructures[structureId] = grown;
+	oblivStructureSizes[structureId] = newSize;
+	oblivStorageBytes[structureId] = val;
+	return 0;
+}
+
 void ocall_deleteStructure(int structureId){
 
 	oblivStructureSizes[structureId] = 0;
 	oblivStructureTypes[structureId] = 0;
-	free(oblivStructures[structureId]); //hold pointers to start of each oblivious data structure
+	if(oblivStorage[structureId] == STORAGE_MMAP){
+		char name[256];
+		munmap(oblivStructures[structureId], oblivStorageBytes[structureId]);
+		structureFileName(structureId, name, sizeof(name));
+		unlink(name);
+	}
+	else {
+		free(oblivStructures[structureId]); //hold pointers to start of each oblivious data structure
+	}
+	oblivStructures[structureId] = NULL;
+	oblivStorage[structureId] = STORAGE_MEMORY;
+	oblivStorageBytes[structureId] = 0;
+	oblivBlockSizes[structureId] = 0;
+}
+
+//a save starts its snapshot from an empty file, and a block file left by an older save under the same name goes too
+void ocall_open_write(int tableSize){
+	char tableName[20], mappedName[32];
+	sprintf(tableName, "testTable%d", tableSize);
+	FILE *outFile = fopen((char*)tableName, "w");
+	if(outFile != NULL) fclose(outFile);
+	sprintf(mappedName, "testTable%d.dat", tableSize);
+	remove(mappedName);
 }
 
 void ocall_open_read(int tableSize){
 	char tableName[20];
 	sprintf(tableName, "testTable%d", tableSize);
 	//printf("table's name is %s\n", tableName);fflush(stdout);
+	if(readFile != NULL) fclose(readFile);
 	readFile = fopen((char*)tableName, "r");
+	readTableSize = tableSize;
 	//printf("here a function is called\n");fflush(stdout);
 }
 
@@ -288,6 +567,68 @@ void ocall_read_file(void *dest, int dsize){
 
 }
 
+//a mapped structure's blocks go to testTable<tableSize>.dat instead, which ocall_read_structure copies back into the structure's file
+void ocall_write_structure(int structureId, int tableSize){
+	char tableName[32];
+	if(oblivStorage[structureId] == STORAGE_MMAP) sprintf(tableName, "testTable%d.dat", tableSize);
+	else sprintf(tableName, "testTable%d", tableSize);
+	FILE *outFile = fopen((char*)tableName, (oblivStorage[structureId] == STORAGE_MMAP) ? "w" : "a");
+	fwrite(oblivStructures[structureId], oblivStorageBytes[structureId], 1, outFile);
+	fclose(outFile);
+}
+
+//copies the saved block file of the open snapshot over the structure's own file and maps it, the blocks don't pass
+//through the app. the snapshot is left as it was so it can be loaded again. filesystems that share extents clone it
+//without copying, anything else (including a storageDir on another mount) gets a kernel side copy
+int attachStructureFile(int structureId){
+	char savedName[32], name[256];
+	sprintf(savedName, "testTable%d.dat", readTableSize);
+	structureFileName(structureId, name, sizeof(name));
+	int in = open(savedName, O_RDONLY);
+	if(in == -1) return 1;
+	struct stat st;
+	if(fstat(in, &st) != 0 || st.st_size != oblivStorageBytes[structureId]){
+		close(in);
+		return 1;
+	}
+	munmap(oblivStructures[structureId], oblivStorageBytes[structureId]);
+	oblivStructures[structureId] = NULL;
+	int out = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if(out == -1){
+		close(in);
+		return 1;
+	}
+	int failed = 0;
+	if(ioctl(out, FICLONE, in) != 0){
+		off_t offset = 0;
+		while(offset < st.st_size){
+			ssize_t sent = sendfile(out, in, &offset, st.st_size - offset);
+			if(sent <= 0){
+				failed = 1;
+				break;
+			}
+		}
+	}
+	close(in);
+	close(out);
+	if(failed) return 1;
+	oblivStructures[structureId] = mapStructureFile(structureId, (Obliv_Type)oblivStructureTypes[structureId], oblivStorageBytes[structureId]);
+	return oblivStructures[structureId] == NULL;
+}
+
+int ocall_read_structure(int structureId){
+	if(readFile == NULL || oblivStructures[structureId] == NULL) return 1;
+	if(oblivStorage[structureId] == STORAGE_MMAP) return attachStructureFile(structureId);
+	posix_fadvise(fileno(readFile), 0, 0, POSIX_FADV_SEQUENTIAL);
+	long done = 0;
+	while(done < oblivStorageBytes[structureId]){
+		size_t got = fread(oblivStructures[structureId]+done, 1, oblivStorageBytes[structureId]-done, readFile);
+		if(got == 0) return 1;
+		done += got;
+	}
+	return 0;
+}
+
 void BDB1Index(sgx_enclave_id_t enclave_id, int status){
 	//block size needs to be 512
 
@@ -363,6 +704,7 @@ void BDB1Index(sgx_enclave_id_t enclave_id, int status){
 	double elapsedTime;
 	//printTable(enclave_id, (int*)&status, "rankings");
 
+	refillJunkPools(enclave_id, (sgx_status_t*)&status);//encrypt dummy buckets before the clock starts
 	startTime = clock();
 	indexSelect(enclave_id, (int*)&status, "rankings", -1, cond, -1, -1, 2, 1000, INT_MAX, 0);
 	//char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int key_start, int key_end
@@ -371,6 +713,7 @@ void BDB1Index(sgx_enclave_id_t enclave_id, int status){
 	printf("BDB1 running time (small): %.5f\n", elapsedTime);
 	//printTable(enclave_id, (int*)&status, "ReturnTable");
     deleteTable(enclave_id, (int*)&status, "ReturnTable");
+	refillJunkPools(enclave_id, (sgx_status_t*)&status);
 	startTime = clock();
 	indexSelect(enclave_id, (int*)&status, "rankings", -1, cond, -1, -1, 3, 1000, INT_MAX, 0);
 	//char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int key_start, int key_end
@@ -379,6 +722,7 @@ void BDB1Index(sgx_enclave_id_t enclave_id, int status){
 	printf("BDB1 running time (hash): %.5f\n", elapsedTime);
 	printTable(enclave_id, (int*)&status, "ReturnTable");
     deleteTable(enclave_id, (int*)&status, "ReturnTable");
+	refillJunkPools(enclave_id, (sgx_status_t*)&status);
 	startTime = clock();
 	indexSelect(enclave_id, (int*)&status, "rankings", -1, cond, -1, -1, 5, 1000, INT_MAX, 0);
 	//char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int key_start, int key_end
@@ -2485,6 +2829,1209 @@ void joinTests(sgx_enclave_id_t enclave_id, int status){
 }
 
 
+void oramPathTests(sgx_enclave_id_t enclave_id, int status){
+	//enclave transitions and throughput of single oram accesses, each access is one ecall plus its ocalls
+	int testSizes[] = {1023, 16383, 131071};
+	int numTests = 3;
+	int numQueries = 1000;
+	Oram_Block* b = (Oram_Block*)malloc(sizeof(Oram_Block));
+
+	for(int t = 0; t < numTests; t++){
+		int numBlocks = testSizes[t];
+		setupPerformanceTest(enclave_id, (sgx_status_t*)&status, 0, numBlocks, TYPE_ORAM);
+		if(status != SGX_SUCCESS){
+			printf("setting up oram failed.\n");
+			break;
+		}
+		//touch every block so the tree is realistically full
+		for(int i = 0; i < numBlocks; i++){
+			testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, i, b, sizeof(Oram_Block));
+		}
+		refillJunkPools(enclave_id, (sgx_status_t*)&status);
+
+		blockTransitions = 0;
+		time_t startTime = clock();
+		for(int i = 0; i < numQueries; i++){
+			testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, rand() % numBlocks, b, sizeof(Oram_Block));
+		}
+		time_t endTime = clock();
+		double elapsedTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+		printf("ORAM path| numBlocks: %d, numQueries: %d, transitions/access: %.2f, accesses/sec: %.1f\n", numBlocks, numQueries, (double)(blockTransitions+numQueries)/numQueries, numQueries/elapsedTime);
+
+		free_oram(enclave_id, (sgx_status_t*)&status, 0);
+		free(oblivStructures[0]);
+		oblivStructures[0] = NULL;
+	}
+	free(b);
+}
+
+void cryptoThroughputTests(sgx_enclave_id_t enclave_id, int status){
+	//block encryption + decryption throughput inside the enclave, one block per call vs whole batches
+	//the gcm kernel runs up to GCM_LANES blocks of a batch side by side, so throughput should climb until then
+	int batchSizes[] = {1, 2, 4, GCM_LANES, SCAN_BATCH_SIZE};
+	int numTests = 5;
+	double singleRate = 0;
+	int numBlocks = 4096;
+	int rounds = 50;
+	Schema benchSchema;
+	benchSchema.numFields = 1;
+	benchSchema.fieldOffsets[0] = 0;
+	benchSchema.fieldSizes[0] = 1;
+	benchSchema.fieldTypes[0] = CHAR;
+	int structureId = -1;
+	createTable(enclave_id, (int*)&status, &benchSchema, "cryptoBench", strlen("cryptoBench"), TYPE_LINEAR_SCAN, SCAN_BATCH_SIZE, &structureId);
+
+	for(int t = 0; t < numTests; t++){
+		sgx_status_t ret = SGX_SUCCESS;
+		time_t startTime = clock();
+		testBlockCryptoPerformance(enclave_id, &ret, structureId, numBlocks, rounds, batchSizes[t]);
+		time_t endTime = clock();
+		double elapsedTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+		if(ret != SGX_SUCCESS) printf("block crypto benchmark failed.\n");
+		double bytes = 2.0*numBlocks*rounds*sizeof(Real_Linear_Scan_Block);
+		double rate = bytes/elapsedTime/1e9;
+		if(t == 0) singleRate = rate;
+		printf("Block crypto| batch: %d, blocks: %d, rounds: %d, enc+dec: %.3f GB/s, %.2fx one block per call\n", batchSizes[t], numBlocks, rounds, rate, rate/singleRate);
+	}
+	deleteTable(enclave_id, (int*)&status, "cryptoBench");
+}
+
+void mmapStorageTests(sgx_enclave_id_t enclave_id, int status){
+	//the same linear table held in app memory and in an mmap'd file
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	Storage_Type storages[] = {STORAGE_MEMORY, STORAGE_MMAP};
+	const char* storageNames[] = {"memory", "mmap"};
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema mmapSchema;
+	mmapSchema.numFields = 3;
+	mmapSchema.fieldOffsets[0] = 0;
+	mmapSchema.fieldSizes[0] = 1;
+	mmapSchema.fieldTypes[0] = CHAR;
+	mmapSchema.fieldOffsets[1] = 1;
+	mmapSchema.fieldSizes[1] = 4;
+	mmapSchema.fieldTypes[1] = INTEGER;
+	mmapSchema.fieldOffsets[2] = 5;
+	mmapSchema.fieldSizes[2] = 255;
+	mmapSchema.fieldTypes[2] = TINYTEXT;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		for(int m = 0; m < 2; m++){
+			Table_Options options = {0};
+			options.storage = storages[m];
+			int structureId = -1;
+			time_t startTime = clock();
+			createTableWithOptions(enclave_id, (int*)&status, &mmapSchema, "mmapTable", strlen("mmapTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId, options);
+			time_t endTime = clock();
+			double createTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+			if(status != 0){
+				printf("creating %s table failed.\n", storageNames[m]);
+				continue;
+			}
+			for(int i = 0; i < numberOfRows; i++){
+				int key = i % 1000;
+				memset(row, 'a', BLOCK_DATA_SIZE);
+				memcpy(&row[mmapSchema.fieldOffsets[1]], &key, 4);
+				insertLinRowFast(enclave_id, (int*)&status, "mmapTable", row);
+			}
+			startTime = clock();
+			selectRows(enclave_id, (int*)&status, "mmapTable", -1, cond, -1, -1, 2, 0);
+			endTime = clock();
+			double selectTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			printf("Storage| rows: %d, %s, create: %.3f s, select: %.3f s\n", numberOfRows, storageNames[m], createTime, selectTime);
+			deleteTable(enclave_id, (int*)&status, "mmapTable");
+		}
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void prefetchTests(sgx_enclave_id_t enclave_id, int status){
+	//linear scan select with and without the app reading batches ahead, on memory and mmap'd tables.
+	//the mmap'd table is mapped without MAP_POPULATE and its pages are evicted before each scan, so those reads hit the disk
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	Storage_Type storages[] = {STORAGE_MEMORY, STORAGE_MMAP};
+	const char* storageNames[] = {"memory", "mmap"};
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema prefetchSchema;
+	prefetchSchema.numFields = 3;
+	prefetchSchema.fieldOffsets[0] = 0;
+	prefetchSchema.fieldSizes[0] = 1;
+	prefetchSchema.fieldTypes[0] = CHAR;
+	prefetchSchema.fieldOffsets[1] = 1;
+	prefetchSchema.fieldSizes[1] = 4;
+	prefetchSchema.fieldTypes[1] = INTEGER;
+	prefetchSchema.fieldOffsets[2] = 5;
+	prefetchSchema.fieldSizes[2] = 255;
+	prefetchSchema.fieldTypes[2] = TINYTEXT;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+	long populateLimit = mmapPopulateLimit;
+	mmapPopulateLimit = 0;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		for(int m = 0; m < 2; m++){
+			Table_Options options = {0};
+			options.storage = storages[m];
+			int structureId = -1;
+			createTableWithOptions(enclave_id, (int*)&status, &prefetchSchema, "prefetchTable", strlen("prefetchTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId, options);
+			if(status != 0){
+				printf("creating %s table failed.\n", storageNames[m]);
+				continue;
+			}
+			for(int i = 0; i < numberOfRows; i++){
+				int key = i % 1000;
+				memset(row, 'a', BLOCK_DATA_SIZE);
+				memcpy(&row[prefetchSchema.fieldOffsets[1]], &key, 4);
+				insertLinRowFast(enclave_id, (int*)&status, "prefetchTable", row);
+			}
+			double selectTimes[2];
+			for(int p = 0; p < 2; p++){
+				prefetchEnabled = p;
+				if(storages[m] == STORAGE_MMAP && evictStructurePages(structureId)) printf("could not evict the table's pages, this scan is warm.\n");
+				//wall time, clock() would add up the cpu time of the prefetch threads
+				std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+				selectRows(enclave_id, (int*)&status, "prefetchTable", -1, cond, -1, -1, 2, 0);
+				std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+				selectTimes[p] = std::chrono::duration<double>(endTime - startTime).count();
+				deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			}
+			prefetchEnabled = 1;
+			printf("Prefetch| rows: %d, %s%s, direct: %.3f s, prefetched: %.3f s\n", numberOfRows, storageNames[m], (storages[m] == STORAGE_MMAP) ? " (cold cache)" : "", selectTimes[0], selectTimes[1]);
+			deleteTable(enclave_id, (int*)&status, "prefetchTable");
+		}
+	}
+	mmapPopulateLimit = populateLimit;
+	free(cond.values[0]);
+	free(row);
+}
+
+void saveLoadTests(sgx_enclave_id_t enclave_id, int status){
+	//building a table a row at a time vs loading a saved copy of it
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	int fileId = 9001;
+	char fileName[20];
+	sprintf(fileName, "testTable%d", fileId);
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema saveSchema;
+	saveSchema.numFields = 3;
+	saveSchema.fieldOffsets[0] = 0;
+	saveSchema.fieldSizes[0] = 1;
+	saveSchema.fieldTypes[0] = CHAR;
+	saveSchema.fieldOffsets[1] = 1;
+	saveSchema.fieldSizes[1] = 4;
+	saveSchema.fieldTypes[1] = INTEGER;
+	saveSchema.fieldOffsets[2] = 5;
+	saveSchema.fieldSizes[2] = 255;
+	saveSchema.fieldTypes[2] = TINYTEXT;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+
+	//a table in a mapped file is saved as a copy of that file, which the load copies or clones into place without reading it
+	Storage_Type storages[] = {STORAGE_MEMORY, STORAGE_MMAP};
+	const char* storageNames[] = {"memory", "mmap"};
+	char mappedFileName[32];
+	sprintf(mappedFileName, "testTable%d.dat", fileId);
+
+	for(int t = 0; t < 2*numTests; t++){
+		int numberOfRows = testSizes[t/2];
+		int structureId = -1;
+		Table_Options options = {0};
+		options.storage = storages[t%2];
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		createTableWithOptions(enclave_id, (int*)&status, &saveSchema, "saveTable", strlen("saveTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId, options);
+		for(int i = 0; i < numberOfRows; i++){
+			int key = i % 1000;
+			memset(row, 'a', BLOCK_DATA_SIZE);
+			memcpy(&row[saveSchema.fieldOffsets[1]], &key, 4);
+			insertLinRowFast(enclave_id, (int*)&status, "saveTable", row);
+		}
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+		double buildTime = std::chrono::duration<double>(endTime - startTime).count();
+
+		remove(fileName);
+		remove(mappedFileName);
+		startTime = std::chrono::steady_clock::now();
+		saveTable(enclave_id, (int*)&status, "saveTable", fileId);
+		endTime = std::chrono::steady_clock::now();
+		double saveTime = std::chrono::duration<double>(endTime - startTime).count();
+		deleteTable(enclave_id, (int*)&status, "saveTable");
+
+		startTime = std::chrono::steady_clock::now();
+		loadTable(enclave_id, (int*)&status, "saveTable", fileId);
+		endTime = std::chrono::steady_clock::now();
+		double loadTime = std::chrono::duration<double>(endTime - startTime).count();
+		if(status != 0) printf("loading saved table failed.\n");
+
+		selectRows(enclave_id, (int*)&status, "saveTable", -1, cond, -1, -1, 2, 0);
+		deleteTable(enclave_id, (int*)&status, "ReturnTable");
+		printf("Save/load| rows: %d, %s, build: %.3f s, save: %.3f s, load: %.3f s\n", numberOfRows, storageNames[t%2], buildTime, saveTime, loadTime);
+		deleteTable(enclave_id, (int*)&status, "saveTable");
+		remove(fileName);
+		remove(mappedFileName);
+	}
+
+	//index snapshots copy the encrypted buckets the same way
+	int indexSizes[] = {10000, 100000};
+	int indexFileId = 9002;
+	char indexFileName[20];
+	sprintf(indexFileName, "testTable%d", indexFileId);
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = indexSizes[t];
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		createTestTableIndex(enclave_id, (int*)&status, "saveIndex", numberOfRows);
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+		double buildTime = std::chrono::duration<double>(endTime - startTime).count();
+
+		remove(indexFileName);
+		startTime = std::chrono::steady_clock::now();
+		saveIndexTable(enclave_id, (int*)&status, "saveIndex", indexFileId);
+		endTime = std::chrono::steady_clock::now();
+		double saveTime = std::chrono::duration<double>(endTime - startTime).count();
+		deleteTable(enclave_id, (int*)&status, "saveIndex");
+
+		startTime = std::chrono::steady_clock::now();
+		loadIndexTable(enclave_id, (int*)&status, indexFileId);
+		endTime = std::chrono::steady_clock::now();
+		double loadTime = std::chrono::duration<double>(endTime - startTime).count();
+		if(status != 0) printf("loading index snapshot failed.\n");
+
+		indexSelect(enclave_id, (int*)&status, indexFileName, -1, cond, -1, -1, -1, 0, 1000, 0);
+		deleteTable(enclave_id, (int*)&status, "ReturnTable");
+		printf("Index snapshot| rows: %d, build: %.3f s, save: %.3f s, load: %.3f s\n", numberOfRows, buildTime, saveTime, loadTime);
+		deleteTable(enclave_id, (int*)&status, indexFileName);
+		remove(indexFileName);
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void growthTests(sgx_enclave_id_t enclave_id, int status){
+	//filling a table created at its final size vs one created small that grows as rows come in
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	int startSize = 1024;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema growSchema;
+	growSchema.numFields = 3;
+	growSchema.fieldOffsets[0] = 0;
+	growSchema.fieldSizes[0] = 1;
+	growSchema.fieldTypes[0] = CHAR;
+	growSchema.fieldOffsets[1] = 1;
+	growSchema.fieldSizes[1] = 4;
+	growSchema.fieldTypes[1] = INTEGER;
+	growSchema.fieldOffsets[2] = 5;
+	growSchema.fieldSizes[2] = 255;
+	growSchema.fieldTypes[2] = TINYTEXT;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+	Obliv_Type types[] = {TYPE_LINEAR_SCAN, TYPE_TREE_ORAM};
+	const char* typeNames[] = {"linear", "index"};
+
+	for(int t = 0; t < numTests; t++){
+		for(int k = 0; k < 2; k++){
+			int numberOfRows = testSizes[t];
+			if(types[k] == TYPE_TREE_ORAM) numberOfRows /= 10;
+			double fillTime[2];
+			for(int g = 0; g < 2; g++){
+				int structureId = -1;
+				std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+				createTable(enclave_id, (int*)&status, &growSchema, "growTable", strlen("growTable"), types[k], g ? startSize : numberOfRows, &structureId);
+				for(int i = 0; i < numberOfRows; i++){
+					int key = i % 1000;
+					memset(row, 'a', BLOCK_DATA_SIZE);
+					memcpy(&row[growSchema.fieldOffsets[1]], &key, 4);
+					if(types[k] == TYPE_TREE_ORAM) insertIndexRowFast(enclave_id, (int*)&status, "growTable", row, i);
+					else insertLinRowFast(enclave_id, (int*)&status, "growTable", row);
+				}
+				std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+				fillTime[g] = std::chrono::duration<double>(endTime - startTime).count();
+				if(types[k] == TYPE_TREE_ORAM) indexSelect(enclave_id, (int*)&status, "growTable", -1, cond, -1, -1, -1, 0, 1000, 0);
+				else selectRows(enclave_id, (int*)&status, "growTable", -1, cond, -1, -1, 2, 0);
+				deleteTable(enclave_id, (int*)&status, "ReturnTable");
+				deleteTable(enclave_id, (int*)&status, "growTable");
+			}
+			printf("Growth| rows: %d, %s, preallocated: %.3f s, grown from %d: %.3f s\n", numberOfRows, typeNames[k], fillTime[0], startSize, fillTime[1]);
+		}
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void lazyInitTests(sgx_enclave_id_t enclave_id, int status){
+	//block ocalls made by createTable with every block written up front vs left until first use
+	int testSizes[] = {100000, 350000};
+	int numTests = 2;
+	Schema initSchema;
+	initSchema.numFields = 2;
+	initSchema.fieldOffsets[0] = 0;
+	initSchema.fieldSizes[0] = 1;
+	initSchema.fieldTypes[0] = CHAR;
+	initSchema.fieldOffsets[1] = 1;
+	initSchema.fieldSizes[1] = 4;
+	initSchema.fieldTypes[1] = INTEGER;
+	Obliv_Type types[] = {TYPE_LINEAR_SCAN, TYPE_TREE_ORAM};
+	const char* typeNames[] = {"linear", "index"};
+	const char* modeNames[] = {"eager", "lazy"};
+	int ret = 0;
+
+	for(int t = 0; t < numTests; t++){
+		for(int k = 0; k < 2; k++){
+			for(int lazy = 0; lazy < 2; lazy++){
+				setLazyInit(enclave_id, &ret, lazy);
+				int structureId = -1;
+				blockTransitions = 0;
+				std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+				createTable(enclave_id, (int*)&status, &initSchema, "initTable", strlen("initTable"), types[k], testSizes[t], &structureId);
+				std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+				double createTime = std::chrono::duration<double>(endTime - startTime).count();
+				printf("Create| rows: %d, %s, %s, block ocalls: %ld, time: %.3f s\n", testSizes[t], typeNames[k], modeNames[lazy], blockTransitions.load(), createTime);
+				deleteTable(enclave_id, (int*)&status, "initTable");
+			}
+		}
+	}
+	setLazyInit(enclave_id, &ret, 1);
+}
+
+void blockSizeTests(sgx_enclave_id_t enclave_id, int status){
+	//the same narrow table stored in full BLOCK_DATA_SIZE blocks and in blocks just big enough for its rows
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	int blockSizes[] = {0, 64};
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema narrowSchema;
+	narrowSchema.numFields = 3;
+	narrowSchema.fieldOffsets[0] = 0;
+	narrowSchema.fieldSizes[0] = 1;
+	narrowSchema.fieldTypes[0] = CHAR;
+	narrowSchema.fieldOffsets[1] = 1;
+	narrowSchema.fieldSizes[1] = 4;
+	narrowSchema.fieldTypes[1] = INTEGER;
+	narrowSchema.fieldOffsets[2] = 5;
+	narrowSchema.fieldSizes[2] = 4;
+	narrowSchema.fieldTypes[2] = INTEGER;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		for(int b = 0; b < 2; b++){
+			Table_Options options = {0};
+			options.blockSize = blockSizes[b];
+			int structureId = -1;
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			createTableWithOptions(enclave_id, (int*)&status, &narrowSchema, "narrowTable", strlen("narrowTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId, options);
+			for(int i = 0; i < numberOfRows; i++){
+				int key = i % 1000;
+				memset(row, 0, BLOCK_DATA_SIZE);
+				row[0] = 'a';
+				memcpy(&row[narrowSchema.fieldOffsets[1]], &key, 4);
+				memcpy(&row[narrowSchema.fieldOffsets[2]], &i, 4);
+				insertLinRowFast(enclave_id, (int*)&status, "narrowTable", row);
+			}
+			std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+			double fillTime = std::chrono::duration<double>(endTime - startTime).count();
+			long storageBytes = oblivStorageBytes[structureId];
+			startTime = std::chrono::steady_clock::now();
+			selectRows(enclave_id, (int*)&status, "narrowTable", -1, cond, -1, -1, 2, 0);
+			endTime = std::chrono::steady_clock::now();
+			double selectTime = std::chrono::duration<double>(endTime - startTime).count();
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			printf("Block size| rows: %d, block: %d, storage: %ld bytes, fill: %.3f s, select: %.3f s\n", numberOfRows, blockSizes[b] ? blockSizes[b] : BLOCK_DATA_SIZE, storageBytes, fillTime, selectTime);
+			deleteTable(enclave_id, (int*)&status, "narrowTable");
+		}
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void packedRowsTests(sgx_enclave_id_t enclave_id, int status){
+	//the same narrow table with one row per block and with as many rows per block as fit
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	int packing[] = {0, SCAN_BATCH_SIZE};
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema narrowSchema;
+	narrowSchema.numFields = 3;
+	narrowSchema.fieldOffsets[0] = 0;
+	narrowSchema.fieldSizes[0] = 1;
+	narrowSchema.fieldTypes[0] = CHAR;
+	narrowSchema.fieldOffsets[1] = 1;
+	narrowSchema.fieldSizes[1] = 4;
+	narrowSchema.fieldTypes[1] = INTEGER;
+	narrowSchema.fieldOffsets[2] = 5;
+	narrowSchema.fieldSizes[2] = 4;
+	narrowSchema.fieldTypes[2] = INTEGER;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		for(int p = 0; p < 2; p++){
+			Table_Options options = {0};
+			options.rowsPerBlock = packing[p];
+			int structureId = -1;
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			createTableWithOptions(enclave_id, (int*)&status, &narrowSchema, "packedTable", strlen("packedTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId, options);
+			for(int i = 0; i < numberOfRows; i++){
+				int key = i % 1000;
+				memset(row, 0, BLOCK_DATA_SIZE);
+				row[0] = 'a';
+				memcpy(&row[narrowSchema.fieldOffsets[1]], &key, 4);
+				memcpy(&row[narrowSchema.fieldOffsets[2]], &i, 4);
+				insertLinRowFast(enclave_id, (int*)&status, "packedTable", row);
+			}
+			std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+			double fillTime = std::chrono::duration<double>(endTime - startTime).count();
+			long storageBytes = oblivStorageBytes[structureId];
+			startTime = std::chrono::steady_clock::now();
+			selectRows(enclave_id, (int*)&status, "packedTable", -1, cond, -1, -1, 2, 0);
+			endTime = std::chrono::steady_clock::now();
+			double selectTime = std::chrono::duration<double>(endTime - startTime).count();
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			startTime = std::chrono::steady_clock::now();
+			deleteRows(enclave_id, (int*)&status, "packedTable", cond, -1, -1);
+			endTime = std::chrono::steady_clock::now();
+			double deleteTime = std::chrono::duration<double>(endTime - startTime).count();
+			printf("Packed rows| rows: %d, max rows per block: %d, storage: %ld bytes, fill: %.3f s, select: %.3f s, delete: %.3f s\n", numberOfRows, packing[p] ? packing[p] : 1, storageBytes, fillTime, selectTime, deleteTime);
+			deleteTable(enclave_id, (int*)&status, "packedTable");
+		}
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void columnGroupTests(sgx_enclave_id_t enclave_id, int status){
+	//an aggregate and a group by over two small columns of a table with a wide text column,
+	//stored as whole rows and with the text column in a group of its own
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema wideSchema;
+	wideSchema.numFields = 4;
+	wideSchema.fieldOffsets[0] = 0;
+	wideSchema.fieldSizes[0] = 1;
+	wideSchema.fieldTypes[0] = CHAR;
+	wideSchema.fieldOffsets[1] = 1;
+	wideSchema.fieldSizes[1] = 4;
+	wideSchema.fieldTypes[1] = INTEGER;
+	wideSchema.fieldOffsets[2] = 5;
+	wideSchema.fieldSizes[2] = 4;
+	wideSchema.fieldTypes[2] = INTEGER;
+	wideSchema.fieldOffsets[3] = 9;
+	wideSchema.fieldSizes[3] = 255;
+	wideSchema.fieldTypes[3] = TINYTEXT;
+	Condition cond;
+	cond.numClauses = 0;
+	cond.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		for(int split = 0; split < 2; split++){
+			Table_Options options = {0};
+			if(split) options.columnGroups[3] = 1;
+			int structureId = -1;
+			createTableWithOptions(enclave_id, (int*)&status, &wideSchema, "wideTable", strlen("wideTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId, options);
+			for(int i = 0; i < numberOfRows; i++){
+				int key = i % 1000;
+				memset(row, 0, BLOCK_DATA_SIZE);
+				row[0] = 'a';
+				memcpy(&row[wideSchema.fieldOffsets[1]], &key, 4);
+				memcpy(&row[wideSchema.fieldOffsets[2]], &i, 4);
+				sprintf((char*)&row[wideSchema.fieldOffsets[3]], "http://www.example.com/page%d.html", i);
+				insertLinRowFast(enclave_id, (int*)&status, "wideTable", row);
+			}
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			selectRows(enclave_id, (int*)&status, "wideTable", 2, cond, 1, -1, -1, 0);
+			std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+			double aggTime = std::chrono::duration<double>(endTime - startTime).count();
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			startTime = std::chrono::steady_clock::now();
+			highCardLinGroupBy(enclave_id, (int*)&status, "wideTable", 2, cond, 1, 1, -1, 0);
+			endTime = std::chrono::steady_clock::now();
+			double groupTime = std::chrono::duration<double>(endTime - startTime).count();
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			printf("Column groups| rows: %d, split: %d, sum: %.3f s, group by: %.3f s\n", numberOfRows, split, aggTime, groupTime);
+			deleteTable(enclave_id, (int*)&status, "wideTable");
+		}
+	}
+	free(row);
+}
+
+void dmlSwapTests(sgx_enclave_id_t enclave_id, int status){
+	//linear delete, update and insert passes, each block goes back out in the ocall that brings the next batch in
+	int testSizes[] = {10000, 100000, 1000000};
+	int numTests = 3;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema dmlSchema;
+	dmlSchema.numFields = 3;
+	dmlSchema.fieldOffsets[0] = 0;
+	dmlSchema.fieldSizes[0] = 1;
+	dmlSchema.fieldTypes[0] = CHAR;
+	dmlSchema.fieldOffsets[1] = 1;
+	dmlSchema.fieldSizes[1] = 4;
+	dmlSchema.fieldTypes[1] = INTEGER;
+	dmlSchema.fieldOffsets[2] = 5;
+	dmlSchema.fieldSizes[2] = 4;
+	dmlSchema.fieldTypes[2] = INTEGER;
+	Condition cond;
+	int val = 10;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &val, 4);
+	cond.nextCondition = NULL;
+	int newVal = 7;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		int structureId = -1;
+		createTable(enclave_id, (int*)&status, &dmlSchema, "dmlTable", strlen("dmlTable"), TYPE_LINEAR_SCAN, numberOfRows+1, &structureId);
+		for(int i = 0; i < numberOfRows; i++){
+			int key = i % 100;
+			memset(row, 0, BLOCK_DATA_SIZE);
+			row[0] = 'a';
+			memcpy(&row[dmlSchema.fieldOffsets[1]], &key, 4);
+			memcpy(&row[dmlSchema.fieldOffsets[2]], &i, 4);
+			insertLinRowFast(enclave_id, (int*)&status, "dmlTable", row);
+		}
+		blockTransitions = 0;
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		updateRows(enclave_id, (int*)&status, "dmlTable", cond, 2, (uint8_t*)&newVal, -1, -1);
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+		double updateTime = std::chrono::duration<double>(endTime - startTime).count();
+		long updateOcalls = blockTransitions;
+		blockTransitions = 0;
+		startTime = std::chrono::steady_clock::now();
+		deleteRows(enclave_id, (int*)&status, "dmlTable", cond, -1, -1);
+		endTime = std::chrono::steady_clock::now();
+		double deleteTime = std::chrono::duration<double>(endTime - startTime).count();
+		long deleteOcalls = blockTransitions;
+		blockTransitions = 0;
+		startTime = std::chrono::steady_clock::now();
+		insertRow(enclave_id, (int*)&status, "dmlTable", row, -1);
+		endTime = std::chrono::steady_clock::now();
+		double insertTime = std::chrono::duration<double>(endTime - startTime).count();
+		printf("DML swap| rows: %d, update: %.3f s (%ld ocalls), delete: %.3f s (%ld ocalls), insert: %.3f s (%ld ocalls)\n", numberOfRows, updateTime, updateOcalls, deleteTime, deleteOcalls, insertTime, blockTransitions.load());
+		deleteTable(enclave_id, (int*)&status, "dmlTable");
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void appendInsertTests(sgx_enclave_id_t enclave_id, int status){
+	//single row inserts into a linear table with half its rows deleted: appends plus the occasional compaction
+	int testSizes[] = {10000, 100000, 1000000};
+	int numTests = 3;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema insSchema;
+	insSchema.numFields = 2;
+	insSchema.fieldOffsets[0] = 0;
+	insSchema.fieldSizes[0] = 1;
+	insSchema.fieldTypes[0] = CHAR;
+	insSchema.fieldOffsets[1] = 1;
+	insSchema.fieldSizes[1] = 4;
+	insSchema.fieldTypes[1] = INTEGER;
+	Condition cond;
+	int val = 2;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &val, 4);
+	cond.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		int numInserts = numberOfRows/2;
+		int structureId = -1;
+		createTable(enclave_id, (int*)&status, &insSchema, "insTable", strlen("insTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId);
+		for(int i = 0; i < numberOfRows; i++){
+			int key = i % 4;
+			memset(row, 0, BLOCK_DATA_SIZE);
+			row[0] = 'a';
+			memcpy(&row[insSchema.fieldOffsets[1]], &key, 4);
+			insertLinRowFast(enclave_id, (int*)&status, "insTable", row);
+		}
+		deleteRows(enclave_id, (int*)&status, "insTable", cond, -1, -1);
+		blockTransitions = 0;
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		for(int i = 0; i < numInserts; i++){
+			insertRow(enclave_id, (int*)&status, "insTable", row, -1);
+		}
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+		double insertTime = std::chrono::duration<double>(endTime - startTime).count();
+		printf("Append insert| rows: %d, inserts: %d, time/insert: %.6f s, block ocalls/insert: %.2f\n", numberOfRows, numInserts, insertTime/numInserts, (double)blockTransitions/numInserts);
+		deleteTable(enclave_id, (int*)&status, "insTable");
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
+void vacuumTests(sgx_enclave_id_t enclave_id, int status){
+	//full table select after deleting most of a linear table, before and after compactTable gives the space back
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema vacSchema;
+	vacSchema.numFields = 3;
+	vacSchema.fieldOffsets[0] = 0;
+	vacSchema.fieldSizes[0] = 1;
+	vacSchema.fieldTypes[0] = CHAR;
+	vacSchema.fieldOffsets[1] = 1;
+	vacSchema.fieldSizes[1] = 4;
+	vacSchema.fieldTypes[1] = INTEGER;
+	vacSchema.fieldOffsets[2] = 5;
+	vacSchema.fieldSizes[2] = 4;
+	vacSchema.fieldTypes[2] = INTEGER;
+	Condition cond;
+	int val = 9;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &val, 4);
+	cond.nextCondition = NULL;
+	Condition none;
+	none.numClauses = 0;
+	none.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		int structureId = -1;
+		createTable(enclave_id, (int*)&status, &vacSchema, "vacTable", strlen("vacTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId);
+		for(int i = 0; i < numberOfRows; i++){
+			int key = i % 10;
+			memset(row, 0, BLOCK_DATA_SIZE);
+			row[0] = 'a';
+			memcpy(&row[vacSchema.fieldOffsets[1]], &key, 4);
+			memcpy(&row[vacSchema.fieldOffsets[2]], &i, 4);
+			insertLinRowFast(enclave_id, (int*)&status, "vacTable", row);
+		}
+		//leaves a tenth of the rows
+		deleteRows(enclave_id, (int*)&status, "vacTable", cond, -1, -1);
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		selectRows(enclave_id, (int*)&status, "vacTable", -1, none, -1, -1, -1, 0);
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+		double beforeTime = std::chrono::duration<double>(endTime - startTime).count();
+		deleteTable(enclave_id, (int*)&status, "ReturnTable");
+		startTime = std::chrono::steady_clock::now();
+		compactTable(enclave_id, (int*)&status, "vacTable");
+		endTime = std::chrono::steady_clock::now();
+		double compactTime = std::chrono::duration<double>(endTime - startTime).count();
+		startTime = std::chrono::steady_clock::now();
+		selectRows(enclave_id, (int*)&status, "vacTable", -1, none, -1, -1, -1, 0);
+		endTime = std::chrono::steady_clock::now();
+		double afterTime = std::chrono::duration<double>(endTime - startTime).count();
+		int kept = 0;
+		getNumRows(enclave_id, &kept, structureId);
+		deleteTable(enclave_id, (int*)&status, "ReturnTable");
+		printf("Vacuum| rows: %d, kept: %d (expected %d), scan before: %.3f s, compact: %.3f s, scan after: %.3f s\n", numberOfRows, kept, numberOfRows/10, beforeTime, compactTime, afterTime);
+		deleteTable(enclave_id, (int*)&status, "vacTable");
+	}
+
+	//unencrypted tables can't be compacted and should be refused untouched
+	int structureId = -1;
+	createTable(enclave_id, (int*)&status, &vacSchema, "vacTable", strlen("vacTable"), TYPE_LINEAR_UNENCRYPTED, 100, &structureId);
+	int refused = 0;
+	compactTable(enclave_id, &refused, "vacTable");
+	printf("Vacuum| unencrypted table refused: %s\n", refused ? "yes" : "NO");
+	deleteTable(enclave_id, (int*)&status, "vacTable");
+	free(cond.values[0]);
+	free(row);
+}
+
+void ringOramTests(sgx_enclave_id_t enclave_id, int status){
+	//path oram vs ring oram, first single accesses like oramPathTests, then index point queries on a table of each
+	int testSizes[] = {1023, 16383, 131071};
+	int numTests = 3;
+	int numQueries = 1000;
+	Obliv_Type types[] = {TYPE_ORAM, TYPE_RING_ORAM};
+	const char* typeNames[] = {"path", "ring"};
+	Oram_Block* b = (Oram_Block*)malloc(sizeof(Oram_Block));
+
+	for(int t = 0; t < numTests; t++){
+		for(int k = 0; k < 2; k++){
+			int numBlocks = testSizes[t];
+			setupPerformanceTest(enclave_id, (sgx_status_t*)&status, 0, numBlocks, types[k]);
+			if(status != SGX_SUCCESS){
+				printf("setting up oram failed.\n");
+				break;
+			}
+			for(int i = 0; i < numBlocks; i++){
+				testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, i, b, sizeof(Oram_Block));
+			}
+			refillJunkPools(enclave_id, (sgx_status_t*)&status);
+
+			blockTransitions = 0;
+			oramBytesMoved = 0;
+			time_t startTime = clock();
+			for(int i = 0; i < numQueries; i++){
+				testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, rand() % numBlocks, b, sizeof(Oram_Block));
+			}
+			time_t endTime = clock();
+			double elapsedTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+			printf("ORAM engine| %s, numBlocks: %d, numQueries: %d, transitions/access: %.2f, KB/access: %.2f, accesses/sec: %.1f\n", typeNames[k], numBlocks, numQueries, (double)(blockTransitions+numQueries)/numQueries, (double)oramBytesMoved/1024/numQueries, numQueries/elapsedTime);
+
+			free_oram(enclave_id, (sgx_status_t*)&status, 0);
+			free(oblivStructures[0]);
+			oblivStructures[0] = NULL;
+		}
+	}
+	free(b);
+
+	//narrow indexSelect ranges, the workload ring oram's cheaper online reads are meant for
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema ringSchema;
+	ringSchema.numFields = 3;
+	ringSchema.fieldOffsets[0] = 0;
+	ringSchema.fieldSizes[0] = 1;
+	ringSchema.fieldTypes[0] = CHAR;
+	ringSchema.fieldOffsets[1] = 1;
+	ringSchema.fieldSizes[1] = 4;
+	ringSchema.fieldTypes[1] = INTEGER;
+	ringSchema.fieldOffsets[2] = 5;
+	ringSchema.fieldSizes[2] = 4;
+	ringSchema.fieldTypes[2] = INTEGER;
+	Condition none;
+	none.numClauses = 0;
+	none.nextCondition = NULL;
+	Obliv_Type tableTypes[] = {TYPE_TREE_ORAM, TYPE_RING_ORAM};
+	int tableSizes[] = {10000, 100000};
+
+	for(int t = 0; t < 2; t++){
+		for(int k = 0; k < 2; k++){
+			int numberOfRows = tableSizes[t];
+			int structureId = -1;
+			createTable(enclave_id, (int*)&status, &ringSchema, "ringTable", strlen("ringTable"), tableTypes[k], numberOfRows, &structureId);
+			for(int i = 0; i < numberOfRows; i++){
+				memset(row, 0, BLOCK_DATA_SIZE);
+				row[0] = 'a';
+				memcpy(&row[ringSchema.fieldOffsets[1]], &i, 4);
+				memcpy(&row[ringSchema.fieldOffsets[2]], &i, 4);
+				insertIndexRowFast(enclave_id, (int*)&status, "ringTable", row, i);
+			}
+			blockTransitions = 0;
+			oramBytesMoved = 0;
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			for(int q = 0; q < 100; q++){
+				int key = rand() % numberOfRows;
+				indexSelect(enclave_id, (int*)&status, "ringTable", -1, none, -1, -1, -1, key, key+1, 0);
+				deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			}
+			std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+			double queryTime = std::chrono::duration<double>(endTime - startTime).count();
+			printf("Index point query| %s, rows: %d, ms/query: %.3f, oram KB/query: %.1f\n", typeNames[k], numberOfRows, queryTime*10, (double)oramBytesMoved/1024/100);
+			deleteTable(enclave_id, (int*)&status, "ringTable");
+		}
+	}
+	free(row);
+}
+
+void circuitOramTests(sgx_enclave_id_t enclave_id, int status){
+	//path oram vs circuit oram: stash memory and the spread of single access times, then b+ tree inserts on a table of each
+	int testSizes[] = {1023, 16383, 131071};
+	int numTests = 3;
+	int numQueries = 1000;
+	Obliv_Type types[] = {TYPE_ORAM, TYPE_CIRCUIT_ORAM};
+	const char* typeNames[] = {"path", "circuit"};
+	Oram_Block* b = (Oram_Block*)malloc(sizeof(Oram_Block));
+	std::vector<double> latencies(numQueries);
+
+	for(int t = 0; t < numTests; t++){
+		for(int k = 0; k < 2; k++){
+			int numBlocks = testSizes[t];
+			int levels = (int)log2(numBlocks+1.1);
+			int stashBlocks = (types[k] == TYPE_CIRCUIT_ORAM) ? CIRCUIT_STASH_SIZE : EXTRA_STASH_SPACE + BUCKET_SIZE*levels + 1;
+			setupPerformanceTest(enclave_id, (sgx_status_t*)&status, 0, numBlocks, types[k]);
+			if(status != SGX_SUCCESS){
+				printf("setting up oram failed.\n");
+				break;
+			}
+			for(int i = 0; i < numBlocks; i++){
+				testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, i, b, sizeof(Oram_Block));
+			}
+			refillJunkPools(enclave_id, (sgx_status_t*)&status);
+
+			blockTransitions = 0;
+			oramBytesMoved = 0;
+			for(int i = 0; i < numQueries; i++){
+				std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+				testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, rand() % numBlocks, b, sizeof(Oram_Block));
+				std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+				latencies[i] = std::chrono::duration<double, std::micro>(endTime - startTime).count();
+			}
+			std::sort(latencies.begin(), latencies.end());
+			printf("ORAM engine| %s, numBlocks: %d, stash: %d blocks (%ld KB), KB/access: %.2f, median: %.1f us, p99: %.1f us, max: %.1f us\n", typeNames[k], numBlocks, stashBlocks, (long)stashBlocks*sizeof(Oram_Block)/1024, (double)oramBytesMoved/1024/numQueries, latencies[numQueries/2], latencies[numQueries*99/100], latencies[numQueries-1]);
+
+			free_oram(enclave_id, (sgx_status_t*)&status, 0);
+			free(oblivStructures[0]);
+			oblivStructures[0] = NULL;
+		}
+	}
+	free(b);
+
+	//b+ tree inserts go through followNodePointer/writeNode, so they see the same engines
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema circuitSchema;
+	circuitSchema.numFields = 3;
+	circuitSchema.fieldOffsets[0] = 0;
+	circuitSchema.fieldSizes[0] = 1;
+	circuitSchema.fieldTypes[0] = CHAR;
+	circuitSchema.fieldOffsets[1] = 1;
+	circuitSchema.fieldSizes[1] = 4;
+	circuitSchema.fieldTypes[1] = INTEGER;
+	circuitSchema.fieldOffsets[2] = 5;
+	circuitSchema.fieldSizes[2] = 4;
+	circuitSchema.fieldTypes[2] = INTEGER;
+	Obliv_Type tableTypes[] = {TYPE_TREE_ORAM, TYPE_CIRCUIT_ORAM};
+	int numberOfRows = 10000;
+	std::vector<double> insertTimes(numberOfRows);
+
+	for(int k = 0; k < 2; k++){
+		int structureId = -1;
+		createTable(enclave_id, (int*)&status, &circuitSchema, "circuitTable", strlen("circuitTable"), tableTypes[k], numberOfRows, &structureId);
+		for(int i = 0; i < numberOfRows; i++){
+			int key = (i*7919) % numberOfRows;
+			memset(row, 0, BLOCK_DATA_SIZE);
+			row[0] = 'a';
+			memcpy(&row[circuitSchema.fieldOffsets[1]], &key, 4);
+			memcpy(&row[circuitSchema.fieldOffsets[2]], &i, 4);
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			insertRow(enclave_id, (int*)&status, "circuitTable", row, key);
+			std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+			insertTimes[i] = std::chrono::duration<double, std::micro>(endTime - startTime).count();
+		}
+		std::sort(insertTimes.begin(), insertTimes.end());
+		printf("Index insert| %s, rows: %d, median: %.1f us, p99: %.1f us, max: %.1f us\n", typeNames[k], numberOfRows, insertTimes[numberOfRows/2], insertTimes[numberOfRows*99/100], insertTimes[numberOfRows-1]);
+		deleteTable(enclave_id, (int*)&status, "circuitTable");
+	}
+	free(row);
+}
+
+void treeTopTests(sgx_enclave_id_t enclave_id, int status){
+	//oram accesses with and without the tree-top cache, the budget decides how many levels stay in the enclave
+	int testSizes[] = {1023, 16383, 131071, 1048575};
+	int numTests = 4;
+	int numQueries = 1000;
+	Oram_Block* b = (Oram_Block*)malloc(sizeof(Oram_Block));
+
+	for(int t = 0; t < numTests; t++){
+		int numBlocks = testSizes[t];
+		int levels = (int)log2(numBlocks+1.1);
+		double rates[2];
+		for(int cached = 0; cached < 2; cached++){
+			int ret = 0;
+			setTreeTopBudget(enclave_id, &ret, cached ? TREETOP_BUDGET : 0);
+			setupPerformanceTest(enclave_id, (sgx_status_t*)&status, 0, numBlocks, TYPE_ORAM);
+			if(status != SGX_SUCCESS){
+				printf("setting up oram failed.\n");
+				break;
+			}
+			for(int i = 0; i < numBlocks; i++){
+				testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, i, b, sizeof(Oram_Block));
+			}
+			refillJunkPools(enclave_id, (sgx_status_t*)&status);
+			int hitLevels = 0;
+			getTreeTopLevels(enclave_id, &hitLevels, 0);
+
+			oramBytesMoved = 0;
+			time_t startTime = clock();
+			for(int i = 0; i < numQueries; i++){
+				testOramPerformance(enclave_id, (sgx_status_t*)&status, 0, rand() % numBlocks, b, sizeof(Oram_Block));
+			}
+			time_t endTime = clock();
+			double elapsedTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+			rates[cached] = numQueries/elapsedTime;
+			printf("Tree-top cache| numBlocks: %d, levels cached: %d of %d, cache: %ld KB, KB/access: %.2f, accesses/sec: %.1f", numBlocks, hitLevels, levels, (long)((1 << hitLevels) - 1)*sizeof(Oram_Bucket)/1024, (double)oramBytesMoved/1024/numQueries, rates[cached]);
+			if(cached) printf(", speedup: %.2fx", rates[1]/rates[0]);
+			printf("\n");
+
+			free_oram(enclave_id, (sgx_status_t*)&status, 0);
+			free(oblivStructures[0]);
+			oblivStructures[0] = NULL;
+		}
+	}
+	int ret = 0;
+	setTreeTopBudget(enclave_id, &ret, TREETOP_BUDGET);
+	free(b);
+}
+
+void posMapTests(sgx_enclave_id_t enclave_id, int status){
+	//flat vs recursive position maps on indexed tables: enclave bytes spent on the map, insert and lookup latency
+	int testSizes[] = {10000, 100000};
+	int numTests = 2;
+	int numQueries = 100;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema posMapSchema;
+	posMapSchema.numFields = 3;
+	posMapSchema.fieldOffsets[0] = 0;
+	posMapSchema.fieldSizes[0] = 1;
+	posMapSchema.fieldTypes[0] = CHAR;
+	posMapSchema.fieldOffsets[1] = 1;
+	posMapSchema.fieldSizes[1] = 4;
+	posMapSchema.fieldTypes[1] = INTEGER;
+	posMapSchema.fieldOffsets[2] = 5;
+	posMapSchema.fieldSizes[2] = 255;
+	posMapSchema.fieldTypes[2] = TINYTEXT;
+	Condition noCondition;
+	noCondition.numClauses = 0;
+	noCondition.nextCondition = NULL;
+	char* tableName = "posMapTable";
+
+	for(int t = 0; t < numTests; t++){
+		for(int recursive = 0; recursive < 2; recursive++){
+			int numberOfRows = testSizes[t];
+			int structureId = -1;
+			Table_Options options = {0};
+			options.recursivePosMap = recursive;
+			createTableWithOptions(enclave_id, (int*)&status, &posMapSchema, tableName, strlen(tableName), TYPE_TREE_ORAM, numberOfRows, &structureId, options);
+			if(status != 0){
+				printf("creating table failed.\n");
+				break;
+			}
+
+			//what createTable padded the oram to, and what is left of its map inside the enclave
+			int logicalSize = oblivStructureSizes[structureId];
+			int mapEntries = logicalSize;
+			int mapLevels = 1;
+			while(recursive && mapEntries > POSMAP_FLAT_LIMIT){
+				int childBlocks = (mapEntries+POSMAP_ENTRIES_PER_BLOCK-1)/POSMAP_ENTRIES_PER_BLOCK;
+				mapEntries = nextPowerOfTwo(childBlocks+1)-1;
+				mapLevels++;
+			}
+
+			time_t startTime = clock();
+			for(int i = 0; i < numberOfRows; i++){
+				memset(row, 'a', BLOCK_DATA_SIZE);
+				memcpy(&row[posMapSchema.fieldOffsets[1]], &i, 4);
+				insertIndexRowFast(enclave_id, (int*)&status, tableName, row, i);
+			}
+			time_t endTime = clock();
+			double insertTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+
+			refillJunkPools(enclave_id, (sgx_status_t*)&status);
+			startTime = clock();
+			for(int q = 0; q < numQueries; q++){
+				int key = rand() % numberOfRows;
+				indexSelect(enclave_id, (int*)&status, tableName, -1, noCondition, -1, -1, 2, key, key, 0);
+				deleteTable(enclave_id, (int*)&status, "ReturnTable");
+			}
+			endTime = clock();
+			double queryTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+			printf("Position map| rows: %d, recursive: %d, map levels: %d, map bytes in enclave: %d (flat %d), insert ms: %.3f, point query ms: %.3f\n",
+					numberOfRows, recursive, mapLevels, mapEntries*4, logicalSize*4, insertTime*1000/numberOfRows, queryTime*1000/numQueries);
+
+			deleteTable(enclave_id, (int*)&status, tableName);
+		}
+	}
+	free(row);
+}
+
+void bulkLoadTests(sgx_enclave_id_t enclave_id, int status){
+	//building an indexed table row by row vs sorting a linear table and bulk loading it
+	int testSizes[] = {10000, 100000};
+	int numTests = 2;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema bulkSchema;
+	bulkSchema.numFields = 3;
+	bulkSchema.fieldOffsets[0] = 0;
+	bulkSchema.fieldSizes[0] = 1;
+	bulkSchema.fieldTypes[0] = CHAR;
+	bulkSchema.fieldOffsets[1] = 1;
+	bulkSchema.fieldSizes[1] = 4;
+	bulkSchema.fieldTypes[1] = INTEGER;
+	bulkSchema.fieldOffsets[2] = 5;
+	bulkSchema.fieldSizes[2] = 255;
+	bulkSchema.fieldTypes[2] = TINYTEXT;
+	Condition noCondition;
+	noCondition.numClauses = 0;
+	noCondition.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		int sourceId = -1, rowIndexId = -1, bulkIndexId = -1;
+		createTable(enclave_id, (int*)&status, &bulkSchema, "bulkSource", strlen("bulkSource"), TYPE_LINEAR_SCAN, numberOfRows, &sourceId);
+		createTable(enclave_id, (int*)&status, &bulkSchema, "rowIndex", strlen("rowIndex"), TYPE_TREE_ORAM, numberOfRows, &rowIndexId);
+		createTable(enclave_id, (int*)&status, &bulkSchema, "bulkIndex", strlen("bulkIndex"), TYPE_TREE_ORAM, numberOfRows, &bulkIndexId);
+		for(int i = 0; i < numberOfRows; i++){
+			int key = (int)(((long long)i*7919) % numberOfRows);
+			memset(row, 'a', BLOCK_DATA_SIZE);
+			memcpy(&row[bulkSchema.fieldOffsets[1]], &key, 4);
+			insertLinRowFast(enclave_id, (int*)&status, "bulkSource", row);
+		}
+
+		time_t startTime = clock();
+		for(int i = 0; i < numberOfRows; i++){
+			int key = (int)(((long long)i*7919) % numberOfRows);
+			memset(row, 'a', BLOCK_DATA_SIZE);
+			memcpy(&row[bulkSchema.fieldOffsets[1]], &key, 4);
+			insertIndexRowFast(enclave_id, (int*)&status, "rowIndex", row, key);
+		}
+		time_t endTime = clock();
+		double rowTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+
+		startTime = clock();
+		bulkLoadIndexTable(enclave_id, (int*)&status, "bulkIndex", "bulkSource", 1, 100, 0);
+		endTime = clock();
+		double bulkTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+		if(status != 0) printf("bulk load failed.\n");
+
+		refillJunkPools(enclave_id, (sgx_status_t*)&status);
+		startTime = clock();
+		indexSelect(enclave_id, (int*)&status, "rowIndex", -1, noCondition, -1, -1, 2, 0, numberOfRows/100, 0);
+		endTime = clock();
+		double rowSelectTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+		deleteTable(enclave_id, (int*)&status, "ReturnTable");
+		startTime = clock();
+		indexSelect(enclave_id, (int*)&status, "bulkIndex", -1, noCondition, -1, -1, 2, 0, numberOfRows/100, 0);
+		endTime = clock();
+		double bulkSelectTime = (double)(endTime - startTime)/(CLOCKS_PER_SEC);
+		deleteTable(enclave_id, (int*)&status, "ReturnTable");
+		printf("Bulk load| rows: %d, row by row: %.3f s, bulk load: %.3f s, 1%% range select: %.5f / %.5f s\n",
+				numberOfRows, rowTime, bulkTime, rowSelectTime, bulkSelectTime);
+
+		deleteTable(enclave_id, (int*)&status, "bulkSource");
+		deleteTable(enclave_id, (int*)&status, "rowIndex");
+		deleteTable(enclave_id, (int*)&status, "bulkIndex");
+	}
+	free(row);
+}
+
+//parks numThreads-1 app threads inside the enclave so linear scans can be split numThreads ways
+void startScanWorkers(sgx_enclave_id_t enclave_id, int numThreads, std::vector<std::thread>& workers){
+	for(int i = 1; i < numThreads; i++){
+		workers.push_back(std::thread([enclave_id](){
+			int ret = 0;
+			scanWorkerLoop(enclave_id, &ret);
+		}));
+	}
+	int ret = 0;
+	setScanThreads(enclave_id, &ret, numThreads);
+	if(ret != 0) printf("could not set up %d scan threads\n", numThreads);
+}
+
+void stopScanWorkers(sgx_enclave_id_t enclave_id, std::vector<std::thread>& workers){
+	int ret = 0;
+	setScanThreads(enclave_id, &ret, 1);
+	stopScanWorkers(enclave_id, &ret);
+	for(int i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+	workers.clear();
+}
+
+void scanThreadTests(sgx_enclave_id_t enclave_id, int status){
+	//linear scan select, aggregate, and delete split across 1 to MAX_SCAN_THREADS enclave threads
+	int testSizes[] = {100000, 1000000};
+	int numTests = 2;
+	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	Schema scanSchema;
+	scanSchema.numFields = 3;
+	scanSchema.fieldOffsets[0] = 0;
+	scanSchema.fieldSizes[0] = 1;
+	scanSchema.fieldTypes[0] = CHAR;
+	scanSchema.fieldOffsets[1] = 1;
+	scanSchema.fieldSizes[1] = 4;
+	scanSchema.fieldTypes[1] = INTEGER;
+	scanSchema.fieldOffsets[2] = 5;
+	scanSchema.fieldSizes[2] = 255;
+	scanSchema.fieldTypes[2] = TINYTEXT;
+	Condition cond;
+	int lowVal = 100;
+	cond.numClauses = 1;
+	cond.fieldNums[0] = 1;
+	cond.conditionType[0] = -1;
+	cond.values[0] = (uint8_t*)malloc(4);
+	memcpy(cond.values[0], &lowVal, 4);
+	cond.nextCondition = NULL;
+
+	for(int t = 0; t < numTests; t++){
+		int numberOfRows = testSizes[t];
+		for(int threads = 1; threads <= MAX_SCAN_THREADS; threads++){
+			int structureId = -1;
+			createTable(enclave_id, (int*)&status, &scanSchema, "scanTable", strlen("scanTable"), TYPE_LINEAR_SCAN, numberOfRows, &structureId);
+			for(int i = 0; i < numberOfRows; i++){
+				int key = i % 1000;
+				memset(row, 'a', BLOCK_DATA_SIZE);
+				memcpy(&row[scanSchema.fieldOffsets[1]], &key, 4);
+				insertLinRowFast(enclave_id, (int*)&status, "scanTable", row);
+			}
+			std::vector<std::thread> workers;
+			startScanWorkers(enclave_id, threads, workers);
+
+			//wall time, clock() would add up the cpu time of every thread
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			selectRows(enclave_id, (int*)&status, "scanTable", -1, cond, -1, -1, 2, 0);
+			std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+			double selectTime = std::chrono::duration<double>(endTime - startTime).count();
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+
+			startTime = std::chrono::steady_clock::now();
+			selectRows(enclave_id, (int*)&status, "scanTable", 1, cond, 1, -1, 0, 0);
+			endTime = std::chrono::steady_clock::now();
+			double aggTime = std::chrono::duration<double>(endTime - startTime).count();
+			deleteTable(enclave_id, (int*)&status, "ReturnTable");
+
+			startTime = std::chrono::steady_clock::now();
+			deleteRows(enclave_id, (int*)&status, "scanTable", cond, -1, -1);
+			endTime = std::chrono::steady_clock::now();
+			double deleteTime = std::chrono::duration<double>(endTime - startTime).count();
+
+			stopScanWorkers(enclave_id, workers);
+			printf("Scan threads| rows: %d, threads: %d, select: %.3f s, sum: %.3f s, delete: %.3f s\n",
+					numberOfRows, threads, selectTime, aggTime, deleteTime);
+			deleteTable(enclave_id, (int*)&status, "scanTable");
+		}
+	}
+	free(cond.values[0]);
+	free(row);
+}
+
 void fabTests(sgx_enclave_id_t enclave_id, int status){
     //Tests for database functionalities here
 
@@ -3576,6 +5123,25 @@ int main(int argc, char* argv[])
         //BDB3(enclave_id, status, 1);//2048 (baseline)	
         //basicTests(enclave_id, status);//512		
 	//fabTests(enclave_id, status);//512		
+        //oramPathTests(enclave_id, status);//512
+        //posMapTests(enclave_id, status);//512
+        //bulkLoadTests(enclave_id, status);//512	
+        //scanThreadTests(enclave_id, status);//512
+        //cryptoThroughputTests(enclave_id, status);//512
+        //mmapStorageTests(enclave_id, status);//512
+        //prefetchTests(enclave_id, status);//512
+        //saveLoadTests(enclave_id, status);//512
+        //growthTests(enclave_id, status);//512
+        //lazyInitTests(enclave_id, status);//512
+        //blockSizeTests(enclave_id, status);//512
+        //packedRowsTests(enclave_id, status);//512
+        //columnGroupTests(enclave_id, status);//512
+        //dmlSwapTests(enclave_id, status);//512
+        //appendInsertTests(enclave_id, status);//512
+        //vacuumTests(enclave_id, status);//512
+        //ringOramTests(enclave_id, status);//512
+        //circuitOramTests(enclave_id, status);//512
+        //treeTopTests(enclave_id, status);//512
         joinTests(enclave_id, status);//512		
         //workloadTests(enclave_id, status);//512	
         //insdelScaling(enclave_id, status);//512	
@@ -290,6 +290,10 @@ record * make_record(int structureId, uint8_t* row) {
 	}
 	else {
 		new_record->actualAddr = newBlock(structureId);
+		if(new_record->actualAddr == -1){//table is full
+			free(new_record);
+			return NULL;
+		}
 		memcpy(&new_record->data[0], &row[0], BLOCK_DATA_SIZE);
 		//new_record->value = value;
 		writeRecord(structureId, new_record);
@@ -308,6 +312,10 @@ node * make_node(int structureId, int isLeaf) {
 
 	//new_node->pointers = (void**)malloc( order * sizeof(void *) );
 	new_node->actualAddr = newBlock(structureId);
+	if(new_node->actualAddr == -1){//table is full, indexHasRoom keeps this from happening partway through a split
+		free(new_node);
+		return NULL;
+	}
 
 	new_node->is_leaf = isLeaf;
 	new_node->num_keys = 0;
@@ -612,6 +620,7 @@ node * insert_into_new_root(int structureId, node * left, int key, node * right)
 node * start_new_tree(int structureId, int key, record * pointer) {
 
 	node * root = make_node(structureId, 1);
+	if(root == NULL) return NULL;
 	root->keys[0] = key;
 	root->pointers[0] = pointer->actualAddr;
 	root->pointers[order - 1] = -1;
@@ -624,6 +633,20 @@ node * start_new_tree(int structureId, int key, record * pointer) {
 
 
 
+/* Whether an insert is sure to find every block it
+ * needs: one for the record and, at worst, one for each
+ * level that splits and one for a new root. Tables that
+ * grow always have room, ring oram tables have a fixed size.
+ */
+int indexHasRoom(int structureId) {
+	if(oblivStructureTypes[structureId] != TYPE_RING_ORAM) return 1;
+	int needed = 3;
+	for(long reach = order/2; reach <= numRows[structureId]; reach *= order/2) needed++;
+	//the free list can hold stale entries, so count again from usedBlocks when it is close
+	if(freeListSizes[structureId] < 2*needed) rebuildFreeList(structureId);
+	return freeListSizes[structureId] >= needed;
+}
+
 /* Master insertion function.
  * Inserts a key and an associated value into
  * the B+ tree, causing the tree to be adjusted
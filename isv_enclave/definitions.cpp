@@ -11,6 +11,8 @@ int getEncBlockSize(Obliv_Type type){
 		encBlockSize = sizeof(Encrypted_Oram_Block);
 		break;
 	case TYPE_ORAM:
+	case TYPE_RING_ORAM:
+	case TYPE_CIRCUIT_ORAM:
 		encBlockSize = sizeof(Encrypted_Oram_Block);
 		break;
 	case TYPE_LINEAR_UNENCRYPTED:
@@ -34,6 +36,8 @@ int getBlockSize(Obliv_Type type){
 		encBlockSize = sizeof(Oram_Block);
 		break;
 	case TYPE_ORAM:
+	case TYPE_RING_ORAM:
+	case TYPE_CIRCUIT_ORAM:
 		encBlockSize = sizeof(Oram_Block);
 		break;
 	}
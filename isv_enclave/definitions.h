@@ -21,8 +21,15 @@
 //ORAM parameters
 #define BUCKET_SIZE 4
 #define EXTRA_STASH_SPACE 90 
+#define RING_Z BUCKET_SIZE //real blocks a ring oram bucket holds
+#define RING_S 6 //dummy slots per ring oram bucket, it is reshuffled once this many of its slots have been read
+#define RING_A 3 //ring oram accesses between evictions
+#define RING_SLOTS (RING_Z+RING_S) //at most 16, unread slots are a uint16_t bitmap
+#define CIRCUIT_STASH_SIZE 10 //blocks in a circuit oram's stash, however tall the tree
+#define CIRCUIT_EVICTIONS 2 //paths a circuit oram evicts per access
+#define TREETOP_BUDGET (256*1024) //bytes of decrypted top-level buckets each oram may keep in the enclave, see initTreeTop
 //database parameters
-#define NUM_STRUCTURES 10 //number of tables supported
+#define NUM_STRUCTURES 20 //number of tables supported, recursive position maps take one each
 #define MAX_COLS 15
 #define MAX_CONDITIONS 3 //number of ORs allowed in one clause of a condition
 #define ROWS_IN_ENCLAVE 7000
@@ -33,6 +40,19 @@
 //#define JOINMAX 350000 //how big are we expecting joins to get
 #define MAX_GROUPS 350000
 #define MIXED_USE_MODE 0 //linear scans of indexes
+#define SCAN_BATCH_SIZE 64 //number of blocks moved per ocall by batched linear scans
+#define JUNK_POOL_SIZE 64 //empty oram buckets kept encrypted ahead of time per structure
+#define PREFETCH_RING_BATCHES 8 //batches an app prefetch thread may read ahead of a scan
+#define MAX_PREFETCH_RINGS 16 //scans that can be prefetched at once, others read directly
+#define IV_BATCH 64 //ivs made per aes-ctr call by makeIvs
+#define GCM_LANES 8 //blocks the batch gcm kernel encrypts side by side, at most 8
+#define MAX_SCAN_THREADS 4 //enclave threads a linear scan can be split across, TCSNum has to be at least this
+#define POSMAP_ENTRIES_PER_BLOCK (BLOCK_DATA_SIZE/4) //leaves packed into one block of a recursive position map
+#define POSMAP_FLAT_LIMIT 1024 //orams this small always keep their position map in the enclave
+#define ORAM_POSMAP_SWAP 2 //opOramBlock write mode: data holds {slot, new leaf+1}, the old entry comes back in data
+
+#define SAVED_TABLE_MAGIC 0x4f424c54 //first field of every sealed table header
+#define SAVE_CHUNK_INTS 65536 //version array entries moved per file ocall by saveTable/loadTable
 
 #define MAX_ORDER 62 //biggest value such that a 512-byte block is always big enough to hold a node
 
@@ -41,12 +61,14 @@ typedef enum _Obliv_Type{
 	TYPE_TREE_ORAM,
 	TYPE_ORAM,
 	TYPE_LINEAR_UNENCRYPTED,
+	TYPE_RING_ORAM, //b+ tree table like TYPE_TREE_ORAM, stored in a ring oram, see opRingOramBlock
+	TYPE_CIRCUIT_ORAM, //b+ tree table like TYPE_TREE_ORAM, stored in a circuit oram, see opCircuitOramBlock
 } Obliv_Type;
 
-typedef struct{
+typedef struct{ //revNum goes before data so a narrow table only has to encrypt the front of this
 	int actualAddr;
-	uint8_t data[BLOCK_DATA_SIZE];
 	int revNum;
+	uint8_t data[BLOCK_DATA_SIZE];
 } Real_Linear_Scan_Block;
 
 typedef struct{
@@ -91,6 +113,7 @@ typedef struct node { //size 8*MAX_ORDER + 16 = currently 176, which wastes a lo
 
 typedef struct{
 	Oram_Block blocks[BUCKET_SIZE];
+	unsigned int leaves[BUCKET_SIZE]; //leaf each block is mapped to, so eviction never consults the position map
 } Oram_Bucket;
 
 typedef struct{
@@ -117,6 +140,70 @@ typedef struct{
 	uint8_t iv[12]; //12 bytes
 } Encrypted_Oram_Block;
 
+typedef struct{ //buffers preallocated per structure so block operations never touch the heap
+	uint8_t* base; //the single allocation everything below points into
+	Real_Linear_Scan_Block* real; //SCAN_BATCH_SIZE of them for linear structures, one otherwise
+	Real_Linear_Scan_Block* dummy;
+	Encrypted_Linear_Scan_Block* encBlocks; //SCAN_BATCH_SIZE of them, linear structures only
+	Oram_Block* block; //oram structures only from here down
+	Oram_Bucket* bucket;
+	Oram_Bucket* junk; //empty bucket, every actualAddr set to -1
+	Encrypted_Oram_Bucket* encBucket;
+	Encrypted_Oram_Bucket* encPath; //one root-to-leaf path, leaf bucket first
+	Encrypted_Oram_Bucket* junkPool; //ring of JUNK_POOL_SIZE encryptions of junk, each under its own iv
+	int junkNext; //next ring slot to hand out
+	int junkReady; //encryptions from junkNext on that have not been handed out yet
+	Oram_Block* ringBucket; //ring orams only: RING_SLOTS plaintext blocks of the bucket being sealed
+	Encrypted_Oram_Block* encSlots; //slots moved by one ring oram ocall, up to RING_SLOTS per level
+	int* slotIndices; //where each of encSlots goes in the app's copy
+	Oram_Bucket* path; //circuit orams only: the decrypted path being accessed or evicted, root first
+} Scratch_Arena;
+
+typedef struct{ //sequential read of blocks [next, end) of a linear structure, a batch at a time, see openScan
+	int structureId;
+	int next; //first block of the next batch
+	int end;
+	int ringId; //app prefetch ring feeding this scan, -1 if batches are read straight from storage
+} Scan_Iterator;
+
+typedef struct{ //iv state of one structure, ivs are AES(iv_key, prefix || counter) so they never repeat
+	uint8_t prefix[8]; //random, drawn when the structure is created
+	uint64_t next; //next counter value, scan threads reserve ranges of it atomically
+} Iv_Counter;
+
+typedef struct{ //fixed-capacity path oram stash, slots are reused instead of allocated per block
+	Oram_Block* blocks;
+	uint8_t* occupied; //bitmap, one bit per slot
+	int* depths; //eviction scratch: deepest level each slot may go to on the current path
+	int* order; //eviction scratch: occupied slots sorted deepest first
+	unsigned int* leaves; //leaf each stashed block is mapped to
+	int capacity;
+} Oram_Stash;
+
+typedef enum _Storage_Type{
+	STORAGE_MEMORY, //malloc'd by the app, gone when it exits
+	STORAGE_MMAP, //one sparse file per structure mapped into the app, can be bigger than ram and outlives the app
+} Storage_Type;
+
+typedef struct{
+	int recursivePosMap; //store the position map of an oram table in smaller orams instead of the enclave
+	Storage_Type storage; //where the app keeps the encrypted blocks
+	int blockSize; //bytes of row data per block of a linear table, up to BLOCK_DATA_SIZE, 0 for BLOCK_DATA_SIZE
+	int rowsPerBlock; //most rows to pack into each block of a linear table, 0 or 1 for one row per block
+	int columnGroups[MAX_COLS]; //group each field of a linear table is stored in, runs of fields numbered from 0, all 0 keeps rows whole
+} Table_Options;
+
+typedef struct{ //shape of a b+ tree built bottom-up by bulkLoadIndexTable
+	int numRecords;
+	int numLevels; //leaves are level 0, the root is the last level
+	int levelStart[32]; //block number of the first node on each level
+	int levelCount[32];
+	int* keys; //key of each record, in key order
+	int* rowIndex; //row of the source table each record is copied from
+	int sourceId;
+	int clearTail; //zero the sort key the staging table appended to each row
+} Bulk_Load_Layout;
+
 typedef enum _DB_TYPE{
 	INTEGER, //4 bytes
 	TINYTEXT, //255 bytes
@@ -131,6 +218,24 @@ typedef struct{
 	//int index;//this is structNum
 } Schema;
 
+typedef struct{ //sealed at the front of a file written by saveTable or saveIndexTable, everything a load trusts comes from here
+	int magic; //SAVED_TABLE_MAGIC
+	int size; //blocks, rows for linear tables
+	Obliv_Type type;
+	Schema schema;
+	int numRows;
+	int rowsPerBlock;
+	int lastInserted;
+	int logicalSize;
+	int freeListSize; //index tables only
+	int stashOcc; //index tables only, stashed blocks saved after the free list
+	int blockSize; //linear tables only, bytes of row data per block
+	Storage_Type storage; //STORAGE_MMAP blocks are saved as a file of their own that the load maps in place
+	uint8_t nonce[8]; //random per snapshot, authenticated with every encrypted section of an index snapshot
+	sgx_aes_gcm_128bit_key_t key; //the saved blocks are still under this key
+	sgx_sha256_hash_t revNumHash; //linear tables only, of the version array that follows the header in the file
+} Saved_Table_Header;
+
 //conditions will be in CNF form (product of sums)
 typedef struct Condition Condition;
 struct Condition{
@@ -141,6 +246,35 @@ struct Condition{
 	Condition *nextCondition;
 };
 
+typedef struct{ //one thread's share of a partitioned linear scan, and its scratch space
+	int start; //blocks [start, end) of the table
+	int end;
+	int ret;
+	int count; //rows matched (or deleted)
+	int firstMatch; //-1 if nothing matched
+	int lastMatch;
+	int stat; //running aggregate, same rules as selectRows
+	int statRow;
+	int statSet;
+	uint8_t* batch; //SCAN_BATCH_SIZE blocks of plaintext
+	Real_Linear_Scan_Block* real; //SCAN_BATCH_SIZE of them
+	Encrypted_Linear_Scan_Block* encBlocks; //SCAN_BATCH_SIZE of them
+} Scan_Partition;
+
+typedef struct Scan_Job Scan_Job;
+struct Scan_Job{ //what runScan hands every partition
+	void (*scan)(Scan_Job* job, Scan_Partition* part);
+	int structureId;
+	Condition* c;
+	int colOffset;
+	int aggregate;
+	uint8_t* blocks; //readScan output, block startIndex goes first
+	int startIndex;
+	void (*rewrite)(Scan_Job* job, Scan_Partition* part, uint8_t* rows, int firstRow, int numRows); //what a dml pass does to each batch, see rewriteBlocks
+	uint8_t* value; //the row insertRow puts in, or the value updateRows sets
+	int valueSize;
+};
+
 
 int getEncBlockSize(Obliv_Type type);
 int getBlockSize(Obliv_Type type);
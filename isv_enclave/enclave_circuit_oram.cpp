@@ -0,0 +1,232 @@
+#include "definitions.h"
+#include "isv_enclave.h"
+
+//circuit oram (Wang, Chan and Shi): the buckets and path ocalls of path oram, but an access takes its block off the
+//path and then CIRCUIT_EVICTIONS paths are evicted, each in one pass from the root that carries at most one block
+//down at a time. blocks only ever wait in the stash between evictions, so it stays at CIRCUIT_STASH_SIZE blocks
+//where path oram needs a whole path on top of EXTRA_STASH_SPACE
+int circuitEvictCounts[NUM_STRUCTURES] = {0};//evictions so far, picks the next eviction path
+
+//reads the path to leaf into the arena's path, buckets that were never written come back empty
+//and the levels in the tree-top cache are copied from there
+int circuitReadPath(int structureId, unsigned int leaf){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	int treeSize = logicalSizes[structureId];
+	int levels = (int)log2(treeSize+1.1);
+	int fetched = levels - treeTopLevels[structureId];
+	int pathWritten = 0;
+	for(int i = 0; i < fetched; i++) pathWritten += blockWritten(structureId, pathBucket(treeSize, leaf, i));
+	if(pathWritten) ocall_read_path(structureId, leaf, fetched, sizeof(Encrypted_Oram_Bucket), arena->encPath);
+	for(int i = 0; i < levels; i++){
+		Oram_Bucket* bucket = &arena->path[levels-1-i];
+		if(i >= fetched) memcpy(bucket, &treeTops[structureId][pathBucket(treeSize, leaf, i)], sizeof(Oram_Bucket));
+		else if(!blockWritten(structureId, pathBucket(treeSize, leaf, i))) memcpy(bucket, arena->junk, sizeof(Oram_Bucket));
+		else if(decryptBlock(&arena->encPath[i], bucket, oblivKeys[structureId], TYPE_ORAM) != 0){
+			printf("AUTHENTICITY FAILURE: circuit oram bucket did not decrypt\n");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//encrypts the arena's path back to leaf, less the cached levels. empty buckets go out as junk made ahead of time when there is some
+int circuitWritePath(int structureId, unsigned int leaf){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	int treeSize = logicalSizes[structureId];
+	int levels = (int)log2(treeSize+1.1);
+	int fetched = levels - treeTopLevels[structureId];
+	for(int i = 0; i < levels; i++){
+		Oram_Bucket* bucket = &arena->path[levels-1-i];
+		if(i >= fetched){
+			memcpy(&treeTops[structureId][pathBucket(treeSize, leaf, i)], bucket, sizeof(Oram_Bucket));
+			continue;
+		}
+		int used = 0;
+		for(int j = 0; j < BUCKET_SIZE; j++) used += (bucket->blocks[j].actualAddr != -1);
+		Encrypted_Oram_Bucket* freshJunk = used ? NULL : takeJunkBucket(structureId);
+		if(freshJunk) memcpy(&arena->encPath[i], freshJunk, sizeof(Encrypted_Oram_Bucket));
+		else if(encryptBlock(structureId, &arena->encPath[i], bucket, oblivKeys[structureId], TYPE_ORAM) != 0) return 1;
+	}
+	if(fetched > 0) ocall_write_path(structureId, leaf, fetched, sizeof(Encrypted_Oram_Bucket), arena->encPath);
+	for(int i = 0; i < fetched; i++) markWritten(structureId, pathBucket(treeSize, leaf, i), 1);
+	return 0;
+}
+
+//one eviction along the path to leaf. positions are the stash (0) and then the path's buckets root first (1 to levels);
+//two metadata passes work out which block each position hands down and where it lands, then a single pass
+//from the root moves them, holding one block at a time
+int circuitEvictPath(int structureId, unsigned int leaf){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Oram_Stash* stash = &stashes[structureId];
+	int treeSize = logicalSizes[structureId];
+	int levels = (int)log2(treeSize+1.1);
+	if(circuitReadPath(structureId, leaf)) return 1;
+
+	//the block at each position that can go deepest on this path, and how deep
+	int deepestSlot[33], reach[33], deepest[33], target[33];//levels never exceeds 32 for an int-sized tree
+	for(int p = 0; p <= levels; p++){
+		deepestSlot[p] = -1;
+		reach[p] = -1;
+		deepest[p] = -1;
+		target[p] = -1;
+	}
+	for(int s = 0; s < stash->capacity; s++){
+		if(!stashSlotUsed(structureId, s)) continue;
+		int d = stashDeepestLevel(treeSize, leaf, stash->leaves[s], levels)+1;
+		if(d > reach[0]){
+			reach[0] = d;
+			deepestSlot[0] = s;
+		}
+	}
+	for(int p = 1; p <= levels; p++){
+		Oram_Bucket* bucket = &arena->path[p-1];
+		for(int j = 0; j < BUCKET_SIZE; j++){
+			if(bucket->blocks[j].actualAddr == -1) continue;
+			int d = stashDeepestLevel(treeSize, leaf, bucket->leaves[j], levels)+1;
+			if(d > reach[p]){
+				reach[p] = d;
+				deepestSlot[p] = j;
+			}
+		}
+	}
+
+	//deepest[p]: the position above p whose block can go furthest, if that is at least as far as p
+	int src = -1, goal = -1;
+	for(int p = 0; p <= levels; p++){
+		if(goal >= p) deepest[p] = src;
+		if(reach[p] > goal){
+			goal = reach[p];
+			src = p;
+		}
+	}
+	//target[p]: where the block picked up at p gets dropped, worked out from the leaf up so every drop has room
+	int dest = -1;
+	src = -1;
+	for(int p = levels; p >= 0; p--){
+		if(p == src){
+			target[p] = dest;
+			dest = -1;
+			src = -1;
+		}
+		int hasRoom = 0;
+		for(int j = 0; j < BUCKET_SIZE && p > 0; j++) hasRoom |= (arena->path[p-1].blocks[j].actualAddr == -1);
+		if(((dest == -1 && hasRoom) || target[p] != -1) && deepest[p] != -1){
+			src = deepest[p];
+			dest = p;
+		}
+	}
+
+	//carry blocks down, picking up before dropping off so a bucket always has the room target promised
+	Oram_Block* held = &arena->bucket->blocks[0];
+	Oram_Block* dropped = &arena->bucket->blocks[1];
+	unsigned int heldLeaf = 0, droppedLeaf = 0;
+	int holding = 0;
+	dest = -1;
+	for(int p = 0; p <= levels; p++){
+		int dropping = 0;
+		if(holding && p == dest){
+			memcpy(dropped, held, sizeof(Oram_Block));
+			droppedLeaf = heldLeaf;
+			holding = 0;
+			dropping = 1;
+			dest = -1;
+		}
+		if(target[p] != -1){
+			if(p == 0){
+				memcpy(held, &stash->blocks[deepestSlot[0]], sizeof(Oram_Block));
+				heldLeaf = stash->leaves[deepestSlot[0]];
+				stashRemove(structureId, deepestSlot[0]);
+			}
+			else{
+				Oram_Bucket* bucket = &arena->path[p-1];
+				memcpy(held, &bucket->blocks[deepestSlot[p]], sizeof(Oram_Block));
+				heldLeaf = bucket->leaves[deepestSlot[p]];
+				bucket->blocks[deepestSlot[p]].actualAddr = -1;
+			}
+			holding = 1;
+			dest = target[p];
+		}
+		if(dropping){
+			Oram_Bucket* bucket = &arena->path[p-1];
+			int j = 0;
+			while(j < BUCKET_SIZE && bucket->blocks[j].actualAddr != -1) j++;
+			if(j == BUCKET_SIZE){
+				printf("circuit oram eviction found no room at level %d\n", p-1);
+				return 1;
+			}
+			memcpy(&bucket->blocks[j], dropped, sizeof(Oram_Block));
+			bucket->leaves[j] = droppedLeaf;
+		}
+	}
+	return circuitWritePath(structureId, leaf);
+}
+
+//opOramBlock for TYPE_CIRCUIT_ORAM structures, same arguments and results
+int opCircuitOramBlock(int structureId, int index, Oram_Block* retBlock, int write){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Oram_Stash* stash = &stashes[structureId];
+	Oram_Block* block = arena->block;
+	int treeSize = logicalSizes[structureId];
+	int levels = (int)log2(treeSize+1.1);
+	unsigned int newLeaf = 0;
+	if(sgx_read_rand((uint8_t*)&newLeaf, sizeof(unsigned int)) != SGX_SUCCESS) return 1;
+	newLeaf = newLeaf % (treeSize/2+1);
+	unsigned int oldLeaf = 0;
+	if(posMapSwap(structureId, index, newLeaf, &oldLeaf, 0)) return 1;
+
+	//take the block off its path, or out of the stash
+	if(circuitReadPath(structureId, oldLeaf)) return 1;
+	int found = 0;
+	for(int d = 0; d < levels; d++){
+		for(int j = 0; j < BUCKET_SIZE; j++){
+			if(arena->path[d].blocks[j].actualAddr == index && !found){
+				memcpy(block, &arena->path[d].blocks[j], sizeof(Oram_Block));
+				arena->path[d].blocks[j].actualAddr = -1;
+				found = 1;
+			}
+		}
+	}
+	for(int s = 0; s < stash->capacity; s++){
+		if(stashSlotUsed(structureId, s) && stash->blocks[s].actualAddr == index && !found){
+			memcpy(block, &stash->blocks[s], sizeof(Oram_Block));
+			stashRemove(structureId, s);
+			found = 1;
+		}
+	}
+	if(!found){//the desired block has not been initialized
+		if(revNum[structureId][index] != 0){
+			printf("AUTHENTICITY FAILURE: block %d is missing from its circuit oram path\n", index);
+			return 1;
+		}
+		memset(block, 0, sizeof(Oram_Block));
+		block->actualAddr = index;
+	}
+
+	if(write != 1 && block->revNum != revNum[structureId][index]){
+		printf("AUTHENTICITY FAILURE: block version not as expected! Expected %d, got %d\n", revNum[structureId][index], block->revNum);
+		return 1;
+	}
+	if(write == ORAM_POSMAP_SWAP){
+		applyPosMapSwap(block, retBlock);
+		revNum[structureId][index]++;
+		block->revNum = revNum[structureId][index];
+	}
+	else if(write){
+		retBlock->actualAddr = index;
+		revNum[structureId][index]++;
+		retBlock->revNum = revNum[structureId][index];
+		memcpy(block, retBlock, sizeof(Oram_Block));
+	}
+	else{
+		memcpy(retBlock, block, sizeof(Oram_Block));
+	}
+	if(stashInsert(structureId, block, newLeaf) == -1) return 1;
+	if(circuitWritePath(structureId, oldLeaf)) return 1;
+
+	for(int e = 0; e < CIRCUIT_EVICTIONS; e++){
+		if(circuitEvictPath(structureId, evictionLeaf(treeSize, circuitEvictCounts[structureId]++))) return 1;
+	}
+
+	//put back one fresh junk bucket per path written, the app tops up the rest between queries
+	return refillJunkPool(structureId, 1+CIRCUIT_EVICTIONS);
+}
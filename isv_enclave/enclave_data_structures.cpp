@@ -3,62 +3,409 @@
 
 //key for reading/writing to oblivious data structures
 sgx_aes_gcm_128bit_key_t *obliv_key;
+//key each structure's blocks are under, obliv_key unless the structure was loaded by loadTable
+sgx_aes_gcm_128bit_key_t* oblivKeys[NUM_STRUCTURES] = {0};
+//key that turns iv counters into ivs
+sgx_aes_ctr_128bit_key_t *iv_key;
+Iv_Counter ivCounters[NUM_STRUCTURES];
 //for keeping track of structures, should reflect the structures held by the untrusted app;
 int oblivStructureSizes[NUM_STRUCTURES] = {0}; //actual size, not logical size for orams
 Obliv_Type oblivStructureTypes[NUM_STRUCTURES];
 //specific to oram structures
 unsigned int* positionMaps[NUM_STRUCTURES] = {0};
+int posMapIds[NUM_STRUCTURES] = {0};//structure holding the position map of a recursive oram, -1 if positionMaps is used
 uint8_t* usedBlocks[NUM_STRUCTURES] = {0};
+int* freeLists[NUM_STRUCTURES] = {0};//stack of block numbers that may be free, the top is handed out first
+int freeListSizes[NUM_STRUCTURES] = {0};
 int* revNum[NUM_STRUCTURES] = {0};
-std::list<Oram_Block>* stashes[NUM_STRUCTURES];
+Oram_Stash stashes[NUM_STRUCTURES];
 int stashOccs[NUM_STRUCTURES] = {0};//stash occupancy, number of elements in stash
 int logicalSizes[NUM_STRUCTURES] = {0};
+uint8_t* writtenBlocks[NUM_STRUCTURES] = {0};//bit per block, set once the block has been written to the app, NULL if every block has
+int blockDataSizes[NUM_STRUCTURES] = {0};//bytes of row data per block, less than BLOCK_DATA_SIZE only for narrow linear tables
+Storage_Type storageTypes[NUM_STRUCTURES];//where the app keeps each structure's blocks, saved with the table so a load puts them back there
+int lazyInit = 1;//new structures leave blocks unwritten until they are first used
+int numColumnGroups[NUM_STRUCTURES] = {0};//0 unless the table's rows are split across the structures in columnGroupIds
+int columnGroupIds[NUM_STRUCTURES][MAX_COLS];
+int columnGroupStarts[NUM_STRUCTURES][MAX_COLS+1];//byte of the row each group starts at, the last entry is where the row ends
+int scanGroupMasks[NUM_STRUCTURES];//groups reads of a split table fill in, -1 for all of them
 node *bPlusRoots[NUM_STRUCTURES] = { NULL };
 Oram_Bucket linOramCache = {0};
+Scratch_Arena scratchArenas[NUM_STRUCTURES];
+Oram_Bucket* treeTops[NUM_STRUCTURES] = {0};//decrypted top levels of each oram, buckets 0 to 2^treeTopLevels-2, see initTreeTop
+int treeTopLevels[NUM_STRUCTURES] = {0};
+int treeTopBudget = TREETOP_BUDGET;
+
+int initFreeList(int structureId){
+	freeLists[structureId] = (int*)malloc(logicalSizes[structureId]*sizeof(int));
+	if(freeLists[structureId] == NULL) return 1;
+	rebuildFreeList(structureId);
+	return 0;
+}
 
-int newBlock(int structureId){
-	int blockNum = -1;
+//refill the stack from usedBlocks, highest block number on top
+void rebuildFreeList(int structureId){
+	freeListSizes[structureId] = 0;
 	for(int i = 0; i < logicalSizes[structureId]; i++){
-		if(usedBlocks[structureId][i] == 0){
-			blockNum = i;
+		if(usedBlocks[structureId][i] == 0) freeLists[structureId][freeListSizes[structureId]++] = i;
+	}
+}
+
+int newBlock(int structureId){
+	//some callers mark usedBlocks directly, so entries already in use are skipped here
+	while(freeListSizes[structureId] > 0){
+		int blockNum = freeLists[structureId][--freeListSizes[structureId]];
+		if(usedBlocks[structureId][blockNum] == 0){
+			usedBlocks[structureId][blockNum] = 1;
+			//printf("allocating block #%d\n", blockNum);
+			return blockNum;
 		}
 	}
-	usedBlocks[structureId][blockNum] = 1;
-	//printf("allocating block #%d\n", blockNum);
-	return blockNum;
+	//every block is in use, add a level to the tree and take one of the new ones
+	if(growStructure(structureId) == 0 && freeListSizes[structureId] > 0){
+		int blockNum = freeLists[structureId][--freeListSizes[structureId]];
+		usedBlocks[structureId][blockNum] = 1;
+		return blockNum;
+	}
+	printf("no free blocks left in structure %d\n", structureId);
+	return -1;
 }
 
 int freeBlock(int structureId, int blockNum){
-	uint8_t* dummyBlock = (uint8_t*)malloc(sizeof(Oram_Block));
-	//printf("hey");
-	memset(&dummyBlock[0], '\0', sizeof(Oram_Block));//printf("hey2");
-	memset(&dummyBlock[0], 0xff, 4);
-	opOramBlock(structureId, blockNum, (Oram_Block*)dummyBlock, 1);
+	Oram_Block dummyBlock;
+	memset(&dummyBlock, '\0', sizeof(Oram_Block));
+	dummyBlock.actualAddr = -1;
+	opOramBlock(structureId, blockNum, &dummyBlock, 1);
 	usedBlocks[structureId][blockNum] = 0;
-	free(dummyBlock);
+	//the stack can hold stale duplicates, when it fills up start over from usedBlocks (which includes this block)
+	if(freeListSizes[structureId] == logicalSizes[structureId]) rebuildFreeList(structureId);
+	else freeLists[structureId][freeListSizes[structureId]++] = blockNum;
+	return 0;
+}
+
+//structures start out with nothing in the app's storage, a block that has never been written reads as empty here
+//instead of being fetched. which blocks have been written follows from the access pattern, so skipping them leaks nothing
+int initWrittenBlocks(int structureId, int size){
+	writtenBlocks[structureId] = (uint8_t*)malloc((size+7)/8);
+	if(writtenBlocks[structureId] == NULL) return 1;
+	memset(writtenBlocks[structureId], 0, (size+7)/8);
+	return 0;
+}
+
+//the new blocks of a grown structure have not been written yet
+int growWrittenBlocks(int structureId, int oldSize, int newSize){
+	uint8_t* grown = (uint8_t*)realloc(writtenBlocks[structureId], (newSize+7)/8);
+	if(grown == NULL) return 1;
+	writtenBlocks[structureId] = grown;
+	memset(&grown[(oldSize+7)/8], 0, (newSize+7)/8 - (oldSize+7)/8);
+	return 0;
+}
+
+int blockWritten(int structureId, int index){
+	uint8_t* written = writtenBlocks[structureId];
+	return written == NULL || ((written[index/8] >> (index%8)) & 1);
+}
+
+//scan threads mark disjoint batches, but those of a packed table can end partway through a byte
+void markWritten(int structureId, int start, int count){
+	uint8_t* written = writtenBlocks[structureId];
+	if(written == NULL) return;
+	for(int i = start; i < start+count; i++) __sync_fetch_and_or(&written[i/8], (uint8_t)(1 << (i%8)));
+}
+
+int countWritten(int structureId, int start, int count){
+	if(writtenBlocks[structureId] == NULL) return count;
+	int n = 0;
+	for(int i = start; i < start+count; i++) n += blockWritten(structureId, i);
+	return n;
+}
+
+//0 makes new structures write an empty block everywhere up front again, for comparison
+int setLazyInit(int on){
+	lazyInit = on;
 	return 0;
 }
 
+//writes empty blocks over every block that was never written, for when the app's copy has to be complete on its own
+int writeUnwrittenBlocks(int structureId){
+	int size = storedBlocks(structureId);
+	for(int i = 0; i < size && writtenBlocks[structureId] != NULL; i++){
+		if(blockWritten(structureId, i)) continue;
+		int end = i;
+		while(end < size && !blockWritten(structureId, end)) end++;
+		if(oblivStructureTypes[structureId] == TYPE_RING_ORAM){
+			if(writeEmptyRingBuckets(structureId, i, end)) return 1;
+		}
+		else if(writeEmptyBlocks(structureId, i, end)) return 1;
+		i = end;
+	}
+	free(writtenBlocks[structureId]);
+	writtenBlocks[structureId] = NULL;
+	return 0;
+}
+
+//bucket level steps up from the leaf on the path to leaf, the order encPath is in
+int pathBucket(int treeSize, unsigned int leaf, int level){
+	int bucketNum = treeSize/2 + leaf;
+	for(int i = 0; i < level; i++) bucketNum = (bucketNum-1)/2;
+	return bucketNum;
+}
+
+//leaf of the count'th eviction path: leaves in reverse lexicographic order, which spreads evictions evenly over the tree
+unsigned int evictionLeaf(int treeSize, int count){
+	int levels = (int)log2(treeSize+1.1);
+	unsigned int g = count % (treeSize/2+1);
+	unsigned int leaf = 0;
+	for(int i = 0; i < levels-1; i++){
+		leaf = (leaf << 1) | ((g >> i) & 1);
+	}
+	return leaf;
+}
+
+//carve a single allocation into the buffers that block operations on this structure need
+int initScratchArena(int structureId, Obliv_Type type){
+	int linear = (type == TYPE_LINEAR_SCAN || type == TYPE_LINEAR_UNENCRYPTED);
+	int oram = (type == TYPE_ORAM || type == TYPE_TREE_ORAM || type == TYPE_CIRCUIT_ORAM);
+	int levels = (int)log2(logicalSizes[structureId]+1.1);
+	int numReal = linear ? SCAN_BATCH_SIZE : 1;
+	int size = (numReal+1)*sizeof(Real_Linear_Scan_Block);
+	if(linear) size += SCAN_BATCH_SIZE*sizeof(Encrypted_Linear_Scan_Block);
+	if(oram) size += sizeof(Oram_Block) + 2*sizeof(Oram_Bucket) + (1+levels+JUNK_POOL_SIZE)*sizeof(Encrypted_Oram_Bucket);
+	if(type == TYPE_CIRCUIT_ORAM) size += levels*sizeof(Oram_Bucket);
+	if(type == TYPE_RING_ORAM) size += (1+RING_SLOTS)*sizeof(Oram_Block) + levels*RING_SLOTS*(sizeof(Encrypted_Oram_Block)+sizeof(int));
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	memset(arena, 0, sizeof(Scratch_Arena));
+	arena->base = (uint8_t*)malloc(size);
+	if(arena->base == NULL) return 1;
+	uint8_t* next = arena->base;
+	arena->real = (Real_Linear_Scan_Block*)next; next += numReal*sizeof(Real_Linear_Scan_Block);
+	arena->dummy = (Real_Linear_Scan_Block*)next; next += sizeof(Real_Linear_Scan_Block);
+	if(linear){
+		arena->encBlocks = (Encrypted_Linear_Scan_Block*)next; next += SCAN_BATCH_SIZE*sizeof(Encrypted_Linear_Scan_Block);
+	}
+	if(oram){
+		arena->block = (Oram_Block*)next; next += sizeof(Oram_Block);
+		arena->bucket = (Oram_Bucket*)next; next += sizeof(Oram_Bucket);
+		arena->junk = (Oram_Bucket*)next; next += sizeof(Oram_Bucket);
+		arena->encBucket = (Encrypted_Oram_Bucket*)next; next += sizeof(Encrypted_Oram_Bucket);
+		arena->encPath = (Encrypted_Oram_Bucket*)next; next += levels*sizeof(Encrypted_Oram_Bucket);
+		arena->junkPool = (Encrypted_Oram_Bucket*)next; next += JUNK_POOL_SIZE*sizeof(Encrypted_Oram_Bucket);
+		memset(arena->junk, '\0', sizeof(Oram_Bucket));
+		for(int j = 0; j < BUCKET_SIZE; j++){
+			arena->junk->blocks[j].actualAddr = -1;
+		}
+	}
+	if(type == TYPE_CIRCUIT_ORAM){
+		arena->path = (Oram_Bucket*)next; next += levels*sizeof(Oram_Bucket);
+	}
+	if(type == TYPE_RING_ORAM){
+		arena->block = (Oram_Block*)next; next += sizeof(Oram_Block);
+		arena->ringBucket = (Oram_Block*)next; next += RING_SLOTS*sizeof(Oram_Block);
+		arena->encSlots = (Encrypted_Oram_Block*)next; next += levels*RING_SLOTS*sizeof(Encrypted_Oram_Block);
+		arena->slotIndices = (int*)next; next += levels*RING_SLOTS*sizeof(int);
+	}
+	return 0;
+}
+
+void freeScratchArena(int structureId){
+	free(scratchArenas[structureId].base);
+	memset(&scratchArenas[structureId], 0, sizeof(Scratch_Arena));
+}
+
+//encrypt up to maxBuckets fresh junk buckets into the free part of the ring
+int refillJunkPool(int structureId, int maxBuckets){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	if(arena->junkPool == NULL) return 0;
+	for(int i = 0; i < maxBuckets && arena->junkReady < JUNK_POOL_SIZE; i++){
+		int slot = (arena->junkNext + arena->junkReady) % JUNK_POOL_SIZE;
+		if(encryptBlock(structureId, &arena->junkPool[slot], arena->junk, oblivKeys[structureId], TYPE_ORAM)) return 1;
+		arena->junkReady++;
+	}
+	return 0;
+}
+
+//next unused encryption of an empty bucket, or NULL if the ring has run dry and the caller has to encrypt its own
+Encrypted_Oram_Bucket* takeJunkBucket(int structureId){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	if(arena->junkReady == 0) return NULL;
+	Encrypted_Oram_Bucket* out = &arena->junkPool[arena->junkNext];
+	arena->junkNext = (arena->junkNext+1) % JUNK_POOL_SIZE;
+	arena->junkReady--;
+	return out;
+}
+
+//top up every oram's junk ring, meant to be called by the app between queries
+sgx_status_t refillJunkPools(){
+	for(int i = 0; i < NUM_STRUCTURES; i++){
+		if(oblivStructureSizes[i] == 0) continue;
+		if(refillJunkPool(i, JUNK_POOL_SIZE)) return SGX_ERROR_UNEXPECTED;
+	}
+	return SGX_SUCCESS;
+}
+
+//0 turns the cache off for structures made from now on, and so does anything negative
+int setTreeTopBudget(int bytes){
+	treeTopBudget = (bytes < 0) ? 0 : bytes;
+	return 0;
+}
+
+int getTreeTopLevels(int structureId){
+	return treeTopLevels[structureId];
+}
+
+//keeps as many top levels of an oram decrypted in the enclave as fit in treeTopBudget, starting from the app's copy.
+//every path goes through them, so accesses leave them out of the path ocalls and the crypto. the app's copy of
+//those buckets is stale from then on, flushTreeTop writes them back when it has to be complete
+int initTreeTop(int structureId){
+	int levels = (int)log2(logicalSizes[structureId]+1.1);
+	int k = 0;
+	while(k < levels && (long)((2 << k) - 1)*(long)sizeof(Oram_Bucket) <= treeTopBudget) k++;
+	treeTopLevels[structureId] = 0;
+	//mixed use reads oram buckets straight from the app's copy
+	if(k == 0 || MIXED_USE_MODE) return 0;
+	int n = (1 << k) - 1;
+	treeTops[structureId] = (Oram_Bucket*)malloc(n*sizeof(Oram_Bucket));
+	if(treeTops[structureId] == NULL) return 1;
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	for(int b = 0; b < n; b++){
+		if(!blockWritten(structureId, b)){
+			memcpy(&treeTops[structureId][b], arena->junk, sizeof(Oram_Bucket));
+			continue;
+		}
+		ocall_read_block(structureId, b, sizeof(Encrypted_Oram_Bucket), arena->encBucket);
+		if(decryptBlock(arena->encBucket, &treeTops[structureId][b], oblivKeys[structureId], TYPE_ORAM) != 0){
+			printf("AUTHENTICITY FAILURE: oram bucket %d did not decrypt into the tree-top cache\n", b);
+			freeTreeTop(structureId);
+			return 1;
+		}
+	}
+	treeTopLevels[structureId] = k;
+	return 0;
+}
+
+//writes the cached top buckets back to the app's copy
+int flushTreeTop(int structureId){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	int n = (1 << treeTopLevels[structureId]) - 1;
+	for(int b = 0; b < n; b++){
+		if(encryptBlock(structureId, arena->encBucket, &treeTops[structureId][b], oblivKeys[structureId], TYPE_ORAM) != 0) return 1;
+		ocall_write_block(structureId, b, sizeof(Encrypted_Oram_Bucket), arena->encBucket);
+		markWritten(structureId, b, 1);
+	}
+	return 0;
+}
+
+void freeTreeTop(int structureId){
+	free(treeTops[structureId]);
+	treeTops[structureId] = NULL;
+	treeTopLevels[structureId] = 0;
+}
+
+int initStash(int structureId){
+	Oram_Stash* stash = &stashes[structureId];
+	int levels = (int)log2(logicalSizes[structureId]+1.1);
+	//overflow limit plus one full path plus the block being accessed
+	stash->capacity = EXTRA_STASH_SPACE + BUCKET_SIZE*levels + 1;
+	//circuit oram never pulls a path into the stash
+	if(oblivStructureTypes[structureId] == TYPE_CIRCUIT_ORAM) stash->capacity = CIRCUIT_STASH_SIZE;
+	stash->blocks = (Oram_Block*)malloc(stash->capacity*sizeof(Oram_Block));
+	stash->occupied = (uint8_t*)malloc((stash->capacity+7)/8);
+	stash->depths = (int*)malloc(stash->capacity*sizeof(int));
+	stash->order = (int*)malloc(stash->capacity*sizeof(int));
+	stash->leaves = (unsigned int*)malloc(stash->capacity*sizeof(unsigned int));
+	stashOccs[structureId] = 0;
+	if(!stash->blocks || !stash->occupied || !stash->depths || !stash->order || !stash->leaves){
+		freeStash(structureId);
+		return 1;
+	}
+	memset(stash->occupied, 0, (stash->capacity+7)/8);
+	return 0;
+}
+
+void freeStash(int structureId){
+	free(stashes[structureId].blocks);
+	free(stashes[structureId].occupied);
+	free(stashes[structureId].depths);
+	free(stashes[structureId].order);
+	free(stashes[structureId].leaves);
+	memset(&stashes[structureId], 0, sizeof(Oram_Stash));
+	stashOccs[structureId] = 0;
+}
+
+int stashSlotUsed(int structureId, int slot){
+	return (stashes[structureId].occupied[slot/8] >> (slot%8)) & 1;
+}
+
+//copies block into the first free slot, returns the slot or -1 if the stash is full
+int stashInsert(int structureId, Oram_Block* block, unsigned int leaf){
+	Oram_Stash* stash = &stashes[structureId];
+	for(int i = 0; i < (stash->capacity+7)/8; i++){
+		if(stash->occupied[i] == 0xff) continue;
+		int slot = i*8;
+		while((stash->occupied[i] >> (slot%8)) & 1) slot++;
+		if(slot >= stash->capacity) break;
+		memcpy(&stash->blocks[slot], block, sizeof(Oram_Block));
+		stash->leaves[slot] = leaf;
+		stash->occupied[i] |= 1 << (slot%8);
+		stashOccs[structureId]++;
+		return slot;
+	}
+	printf("stash full! %d\n", stashOccs[structureId]);
+	return -1;
+}
+
+void stashRemove(int structureId, int slot){
+	stashes[structureId].occupied[slot/8] &= ~(1 << (slot%8));
+	stashOccs[structureId]--;
+}
+
+//deepest level (root is 0) shared by the paths to pathLeaf and destLeaf
+int stashDeepestLevel(int treeSize, int pathLeaf, int destLeaf, int levels){
+	//numbering nodes from 1, the ancestor k levels up is the node number shifted right by k
+	unsigned int diff = (unsigned int)(treeSize/2+pathLeaf+1) ^ (unsigned int)(treeSize/2+destLeaf+1);
+	int k = 0;
+	while(diff){
+		diff >>= 1;
+		k++;
+	}
+	return levels-1-k;
+}
+
+//counting sort of the occupied slots by depths[], deepest first, returns how many were ordered
+//slots with a negative depth have no legal place on the path and are left out
+int stashOrderByDepth(int structureId, int levels){
+	Oram_Stash* stash = &stashes[structureId];
+	int starts[33] = {0};//levels never exceeds 32 for an int-sized tree
+	for(int i = 0; i < stash->capacity; i++){
+		if(stashSlotUsed(structureId, i) && stash->depths[i] >= 0) starts[levels-stash->depths[i]]++;
+	}
+	for(int d = 1; d <= levels; d++){
+		starts[d] += starts[d-1];
+	}
+	for(int i = 0; i < stash->capacity; i++){
+		if(stashSlotUsed(structureId, i) && stash->depths[i] >= 0) stash->order[starts[levels-1-stash->depths[i]]++] = i;
+	}
+	return starts[levels-1];
+}
+
 
 int opOneLinearScanBlock(int structureId, int index, Linear_Scan_Block* block, int write){
+	Scratch_Arena* arena = &scratchArenas[structureId];
 
 	if(MIXED_USE_MODE && !write){//need to do this fast without breaking other stuff or interfaces
 		//praise be to God that the formats have the same size for one block
 		//that will let me treat an oram block as a real linear scan block
-		int size = oblivStructureSizes[structureId];
-		int blockSize = sizeof(Real_Linear_Scan_Block);
 		int encBlockSize = sizeof(Encrypted_Oram_Bucket);
 		int i = index;
-		Real_Linear_Scan_Block* real = (Real_Linear_Scan_Block*)malloc(blockSize);
-		int realSize = size*4;
+		Real_Linear_Scan_Block* real = arena->real;
 		if(i%4 == 0){//need to open a new block
-			Encrypted_Oram_Bucket* encBucket = (Encrypted_Oram_Bucket*)malloc(encBlockSize);
-			ocall_read_block(structureId, i/4, encBlockSize, encBucket);
-			if(decryptBlock(encBucket, &linOramCache, obliv_key, TYPE_ORAM) != 0) return 1;//printf("here 2\n");
-			free(encBucket);
+			ocall_read_block(structureId, i/4, encBlockSize, arena->encBucket);
+			if(decryptBlock(arena->encBucket, &linOramCache, oblivKeys[structureId], TYPE_ORAM) != 0) return 1;//printf("here 2\n");
 		}
 		i%=4;
-		memcpy(real, &(linOramCache.blocks[i]), blockSize);
+		real->actualAddr = linOramCache.blocks[i].actualAddr;
+		real->revNum = linOramCache.blocks[i].revNum;
+		memcpy(real->data, linOramCache.blocks[i].data, BLOCK_DATA_SIZE);
 		//we don't care about the order when they're in an oram
 		//if(real->actualAddr != index && real->actualAddr != -1){
 		//	printf("AUTHENTICITY FAILURE: block address not as expected! Expected %d, got %d\n", index, real->actualAddr);
@@ -70,33 +417,31 @@ int opOneLinearScanBlock(int structureId, int index, Linear_Scan_Block* block, i
 		}
 		//linear ops in this mode will always be reads for now, but it could also be used
 		memcpy(block, real->data, BLOCK_DATA_SIZE); //keep the value we extracted from real if we're reading
-
-		free(real);
 		return 0;
 	}
 
 	//if(oblivStructureTypes[structureId] != TYPE_LINEAR_SCAN) return 1; //if the designated data structure is not a linear scan structure
-	int size = oblivStructureSizes[structureId];
-	int blockSize = sizeof(Real_Linear_Scan_Block);
-	int encBlockSize = sizeof(Encrypted_Linear_Scan_Block);
+	if(rowsPerBlock[structureId] > 1) return opPackedRows(structureId, index, 1, block, write, arena->real, arena->encBlocks);
+	if(numColumnGroups[structureId] > 0) return opColumnGroupRows(structureId, index, 1, block, write, arena->real, arena->encBlocks);
+	int encBlockSize = linearEncBlockSize(structureId);
 	int i = index;
-	//allocate dummy storage and real storage
-	Real_Linear_Scan_Block* dummy = (Real_Linear_Scan_Block*)malloc(blockSize);
-	Real_Linear_Scan_Block* real = (Real_Linear_Scan_Block*)malloc(blockSize);
-	Encrypted_Linear_Scan_Block* dummyEnc = (Encrypted_Linear_Scan_Block*)malloc(encBlockSize);
-	Encrypted_Linear_Scan_Block* realEnc = (Encrypted_Linear_Scan_Block*)malloc(encBlockSize);
-	memcpy(real->data, block, BLOCK_DATA_SIZE);
+	Real_Linear_Scan_Block* real = arena->real;
+	Encrypted_Linear_Scan_Block* realEnc = &arena->encBlocks[0];
 
 	if(write){//we leak whether an op is a read or a write; we could hide it, but it may not be necessary?
+		memcpy(real->data, block, BLOCK_DATA_SIZE);
 		real->actualAddr = i;
 		real->revNum = revNum[structureId][i]+1;
 		revNum[structureId][i]++;
-		if(encryptBlock(realEnc, real, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1; //replace encryption of real with encryption of block
+		if(encryptLinearBlocks(structureId, realEnc, real, 1)!=0) return 1; //replace encryption of real with encryption of block
 		ocall_write_block(structureId, i, encBlockSize, realEnc);//printf("here 3\n");
+		markWritten(structureId, i, 1);
+	}else if(!blockWritten(structureId, i)){
+		memset(block, 0, BLOCK_DATA_SIZE);
 	}else{//printf("here0");
 		ocall_read_block(structureId, i, encBlockSize, realEnc);//printf("here\n");
 		//printf("beginning of mac(op)? %d\n", realEnc->macTag[0]);
-		if(decryptBlock(realEnc, real, obliv_key, TYPE_LINEAR_SCAN) != 0) return 1;//printf("here 2\n");
+		if(decryptLinearBlocks(structureId, realEnc, real, 1) != 0) return 1;//printf("here 2\n");
 		if(!MIXED_USE_MODE && real->actualAddr != i && real->actualAddr != -1){
 			printf("AUTHENTICITY FAILURE: block address not as expected! Expected %d, got %d\n", i, real->actualAddr);
 			return 1;
@@ -105,65 +450,341 @@ int opOneLinearScanBlock(int structureId, int index, Linear_Scan_Block* block, i
 			printf("AUTHENTICITY FAILURE: block version not as expected! Expected %d, got %d\n", revNum[structureId][i], real->revNum);
 			return 1;
 		}
+		memcpy(block, real->data, BLOCK_DATA_SIZE); //keep the value we extracted from real if we're reading
 	}
 
-	//clean up
-	if(!write) memcpy(block, real->data, BLOCK_DATA_SIZE); //keep the value we extracted from real if we're reading
+	return 0;
+}
 
-	free(real);
-	free(dummy);
-	free(dummyEnc);
-	free(realEnc);
+//reads or writes numBlocks consecutive blocks starting at startIndex using one ocall per batch
+//blocks is an array of numBlocks Linear_Scan_Blocks; numBlocks is clamped to the end of the structure
+int opLinearScanBlocks(int structureId, int startIndex, int numBlocks, Linear_Scan_Block* blocks, int write){
+	return opLinearScanBlocksWith(structureId, startIndex, numBlocks, blocks, write, scratchArenas[structureId].real, scratchArenas[structureId].encBlocks);
+}
 
+//same as opLinearScanBlocks but with the caller's scratch space, so scan threads can share a structure
+//disjoint block ranges are safe to run concurrently
+int opLinearScanBlocksWith(int structureId, int startIndex, int numBlocks, Linear_Scan_Block* blocks, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	int size = oblivStructureSizes[structureId];
+	if(MIXED_USE_MODE && !write){//orams read as linear scans go through the bucket cache one block at a time
+		if(startIndex + numBlocks > size*BUCKET_SIZE) numBlocks = size*BUCKET_SIZE - startIndex;
+		for(int j = 0; j < numBlocks; j++){
+			if(opOneLinearScanBlock(structureId, startIndex+j, &blocks[j], 0)) return 1;
+		}
+		return 0;
+	}
+	if(rowsPerBlock[structureId] > 1) return opPackedRows(structureId, startIndex, numBlocks, blocks, write, real, encBlocks);
+	if(numColumnGroups[structureId] > 0) return opColumnGroupRows(structureId, startIndex, numBlocks, blocks, write, real, encBlocks);
+	if(startIndex + numBlocks > size) numBlocks = size - startIndex;
+	if(numBlocks <= 0) return 0;
+	int encBlockSize = linearEncBlockSize(structureId);
+	int ret = 0;
+
+	for(int start = startIndex; start < startIndex+numBlocks && ret == 0; start += SCAN_BATCH_SIZE){
+		int count = startIndex+numBlocks-start;
+		if(count > SCAN_BATCH_SIZE) count = SCAN_BATCH_SIZE;
+		//the whole batch goes through the cipher in one call each way
+		if(write){
+			for(int j = 0; j < count; j++){
+				int i = start+j;
+				real[j].actualAddr = i;
+				revNum[structureId][i]++;
+				real[j].revNum = revNum[structureId][i];
+				memcpy(real[j].data, blocks[i-startIndex].data, BLOCK_DATA_SIZE);
+			}
+			if(encryptLinearBlocks(structureId, encBlocks, real, count)!=0) ret = 1;
+			if(ret == 0) ocall_write_blocks(structureId, start, count, encBlockSize, encBlocks);
+			markWritten(structureId, start, count);
+		}
+		else if(countWritten(structureId, start, count) == 0){
+			for(int j = 0; j < count; j++) memset(blocks[start-startIndex+j].data, 0, BLOCK_DATA_SIZE);
+		}
+		else{
+			ocall_read_blocks(structureId, start, count, encBlockSize, encBlocks);
+			ret = decryptScanBatch(structureId, start, count, &blocks[start-startIndex], real, encBlocks);
+		}
+	}
+
+	return ret;
+}
+
+//rows of a packed table sit rowsPerBlock to a block, row r in slot r%rowsPerBlock of block r/rowsPerBlock
+//every block a range of rows touches is read and written whole, so a row op looks like an op on its block
+//rows come back with the end of data past the slot zeroed, like rows of a narrow table
+int opPackedRows(int structureId, int startRow, int numRows, Linear_Scan_Block* rows, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	if(opRowSlots(structureId, startRow, numRows, rows, 0, write, real, encBlocks)) return 1;
+	int slotSize = blockDataSizes[structureId]/rowsPerBlock[structureId];
+	if(startRow + numRows > oblivStructureSizes[structureId]) numRows = oblivStructureSizes[structureId] - startRow;
+	for(int j = 0; j < numRows && !write; j++) memset(&rows[j].data[slotSize], 0, BLOCK_DATA_SIZE-slotSize);
 	return 0;
 }
 
+//moves the slots of rows [startRow, startRow+numRows) to or from bytes [rowOffset, rowOffset+slot size) of rows
+int opRowSlots(int structureId, int startRow, int numRows, Linear_Scan_Block* rows, int rowOffset, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	int rpb = rowsPerBlock[structureId];
+	int slotSize = blockDataSizes[structureId]/rpb;
+	int size = oblivStructureSizes[structureId];
+	if(startRow + numRows > size) numRows = size - startRow;
+	if(numRows <= 0) return 0;
+	int encBlockSize = linearEncBlockSize(structureId);
+	int firstBlock = startRow/rpb;
+	int endBlock = (startRow+numRows-1)/rpb + 1;
+	int ret = 0;
+
+	for(int start = firstBlock; start < endBlock && ret == 0; start += SCAN_BATCH_SIZE){
+		int count = endBlock-start;
+		if(count > SCAN_BATCH_SIZE) count = SCAN_BATCH_SIZE;
+		int lo = start*rpb;
+		int hi = (start+count)*rpb;
+		//a write that fills every slot of the batch has nothing to keep from what was there
+		int covered = write && lo >= startRow && hi <= startRow+numRows;
+		if(lo < startRow) lo = startRow;
+		if(hi > startRow+numRows) hi = startRow+numRows;
+		if(covered || countWritten(structureId, start, count) == 0){
+			memset(real, 0, count*sizeof(Real_Linear_Scan_Block));
+		}
+		else{
+			ocall_read_blocks(structureId, start, count, encBlockSize, encBlocks);
+			if(decryptLinearBatch(structureId, start, count, real, encBlocks)) return 1;
+		}
+		for(int r = lo; r < hi; r++){
+			uint8_t* slot = &real[r/rpb-start].data[(r%rpb)*slotSize];
+			if(write) memcpy(slot, &rows[r-startRow].data[rowOffset], slotSize);
+			else memcpy(&rows[r-startRow].data[rowOffset], slot, slotSize);
+		}
+		if(write){
+			for(int j = 0; j < count; j++){
+				int i = start+j;
+				real[j].actualAddr = i;
+				revNum[structureId][i]++;
+				real[j].revNum = revNum[structureId][i];
+			}
+			if(encryptLinearBlocks(structureId, encBlocks, real, count)!=0) ret = 1;
+			if(ret == 0) ocall_write_blocks(structureId, start, count, encBlockSize, encBlocks);
+			markWritten(structureId, start, count);
+		}
+	}
+
+	return ret;
+}
+
+//a table stored as column groups keeps bytes [columnGroupStarts[g], columnGroupStarts[g+1]) of each row in group g,
+//a packed table of its own, so a row's pieces all sit at the same row index. reads only go to the groups in
+//scanGroupMasks and leave the rest of the row zeroed, writes always go to every group
+int opColumnGroupRows(int structureId, int startRow, int numRows, Linear_Scan_Block* rows, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	int size = oblivStructureSizes[structureId];
+	if(startRow + numRows > size) numRows = size - startRow;
+	if(numRows <= 0) return 0;
+	if(!write) memset(rows, 0, numRows*sizeof(Linear_Scan_Block));
+	for(int g = 0; g < numColumnGroups[structureId]; g++){
+		if(!write && !((scanGroupMasks[structureId] >> g) & 1)) continue;
+		if(opRowSlots(columnGroupIds[structureId][g], startRow, numRows, rows, columnGroupStarts[structureId][g], write, real, encBlocks)) return 1;
+	}
+	return 0;
+}
+
+//decrypts count encrypted blocks that were read from startIndex on into blocks, checking every address and version
+int decryptScanBatch(int structureId, int startIndex, int count, Linear_Scan_Block* blocks, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	if(decryptLinearBatch(structureId, startIndex, count, real, encBlocks)) return 1;
+	for(int j = 0; j < count; j++) memcpy(blocks[j].data, real[j].data, BLOCK_DATA_SIZE);
+	return 0;
+}
+
+//decrypts count encrypted blocks that were read from startIndex on into real, checking every address and version
+int decryptLinearBatch(int structureId, int startIndex, int count, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	int encBlockSize = linearEncBlockSize(structureId);
+	if(countWritten(structureId, startIndex, count) == count){
+		if(decryptLinearBlocks(structureId, encBlocks, real, count) != 0) return 1;
+	}
+	else{
+		//blocks that were never written hold whatever the app had there, decrypt the runs of written ones around them
+		for(int j = 0; j < count; ){
+			int written = blockWritten(structureId, startIndex+j);
+			int end = j;
+			while(end < count && blockWritten(structureId, startIndex+end) == written) end++;
+			if(written){
+				if(decryptLinearBlocks(structureId, (uint8_t*)encBlocks + j*encBlockSize, &real[j], end-j) != 0) return 1;
+			}
+			else{
+				memset(&real[j], 0, (end-j)*sizeof(Real_Linear_Scan_Block));
+				for(int k = j; k < end; k++) real[k].actualAddr = -1;
+			}
+			j = end;
+		}
+	}
+	for(int j = 0; j < count; j++){
+		int i = startIndex+j;
+		if(real[j].actualAddr != i && real[j].actualAddr != -1){
+			printf("AUTHENTICITY FAILURE: block address not as expected! Expected %d, got %d\n", i, real[j].actualAddr);
+			return 1;
+		}
+		if(real[j].revNum != revNum[structureId][i]){
+			printf("AUTHENTICITY FAILURE: block version not as expected! Expected %d, got %d\n", revNum[structureId][i], real[j].revNum);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//reads blocks [part->start, part->end) of job->structureId into part->batch a batch at a time, lets job->rewrite
+//change the rows and writes the batch back. writing a batch and reading the next share one ocall_swap_blocks,
+//so a pass over the table leaves the enclave once per batch instead of twice
+int rewriteBlocks(Scan_Job* job, Scan_Partition* part){
+	int structureId = job->structureId;
+	Linear_Scan_Block* batch = (Linear_Scan_Block*)part->batch;
+	Real_Linear_Scan_Block* real = part->real;
+	Encrypted_Linear_Scan_Block* encBlocks = part->encBlocks;
+	int end = part->end;
+	if(end > oblivStructureSizes[structureId]) end = oblivStructureSizes[structureId];
+	if(part->start >= end) return 0;
+	if(MIXED_USE_MODE || rowsPerBlock[structureId] > 1 || numColumnGroups[structureId] > 0){
+		//rows here aren't one to a block, they go through the row ops
+		for(int i = part->start; i < end; i += SCAN_BATCH_SIZE){
+			int n = (end-i < SCAN_BATCH_SIZE) ? end-i : SCAN_BATCH_SIZE;
+			if(opLinearScanBlocksWith(structureId, i, n, batch, 0, real, encBlocks)) return 1;
+			job->rewrite(job, part, part->batch, i, n);
+			if(opLinearScanBlocksWith(structureId, i, n, batch, 1, real, encBlocks)) return 1;
+		}
+		return 0;
+	}
+	int encBlockSize = linearEncBlockSize(structureId);
+	int n = (end-part->start < SCAN_BATCH_SIZE) ? end-part->start : SCAN_BATCH_SIZE;
+	//blocks that were never written come back as whatever the app has there, decryptScanBatch skips them
+	ocall_read_blocks(structureId, part->start, n, encBlockSize, encBlocks);
+	for(int i = part->start; i < end; i += n){
+		n = (end-i < SCAN_BATCH_SIZE) ? end-i : SCAN_BATCH_SIZE;
+		if(decryptScanBatch(structureId, i, n, batch, real, encBlocks)) return 1;
+		job->rewrite(job, part, part->batch, i, n);
+		for(int j = 0; j < n; j++){
+			real[j].actualAddr = i+j;
+			revNum[structureId][i+j]++;
+			real[j].revNum = revNum[structureId][i+j];
+			memcpy(real[j].data, batch[j].data, BLOCK_DATA_SIZE);
+		}
+		if(encryptLinearBlocks(structureId, encBlocks, real, n)!=0) return 1;
+		int nextCount = (end-i-n < SCAN_BATCH_SIZE) ? end-i-n : SCAN_BATCH_SIZE;
+		ocall_swap_blocks(structureId, i, n, i+n, nextCount, encBlockSize, encBlocks, encBlocks);
+		markWritten(structureId, i, n);
+	}
+	return 0;
+}
+
+//scan iterators read blocks [startIndex, endIndex) in order, one batch per scanNextBatch
+//if the app has a prefetch ring free, a thread on its side copies batches into it ahead of us,
+//so reading the next batch from storage overlaps with decrypting and using this one
+//the blocks touched are the same either way, only when the host fetches them changes
+int openScan(Scan_Iterator* it, int structureId, int startIndex, int endIndex){
+	it->structureId = structureId;
+	it->next = startIndex;
+	it->end = endIndex;
+	it->ringId = -1;
+	if(MIXED_USE_MODE || oblivStructureTypes[structureId] != TYPE_LINEAR_SCAN) return 0; //these go through opLinearScanBlocks
+	if(rowsPerBlock[structureId] > 1 || numColumnGroups[structureId] > 0) return 0; //so do packed and split tables, batches of rows don't line up with what the ring reads
+	if(it->end > oblivStructureSizes[structureId]) it->end = oblivStructureSizes[structureId];
+	if(it->next >= it->end) return 0;
+	if(ocall_open_prefetch(&it->ringId, structureId, it->next, it->end, linearEncBlockSize(structureId)) != SGX_SUCCESS) it->ringId = -1;
+	return 0;
+}
+
+//decrypts the next SCAN_BATCH_SIZE blocks (fewer at the end) into blocks
+//returns how many, 0 once the scan is done, -1 on failure
+int scanNextBatchWith(Scan_Iterator* it, Linear_Scan_Block* blocks, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks){
+	int count = it->end - it->next;
+	if(count > SCAN_BATCH_SIZE) count = SCAN_BATCH_SIZE;
+	if(count <= 0) return 0;
+	int ret = 0;
+	if(it->ringId == -1){
+		ret = opLinearScanBlocksWith(it->structureId, it->next, count, blocks, 0, real, encBlocks);
+	}
+	else{
+		//the ring hands out batches in the order they were asked for in openScan, so this is always block it->next
+		ocall_read_prefetched(it->ringId, count, linearEncBlockSize(it->structureId), encBlocks);
+		ret = decryptScanBatch(it->structureId, it->next, count, blocks, real, encBlocks);
+	}
+	it->next += count;
+	if(ret) return -1;
+	return count;
+}
+
+int scanNextBatch(Scan_Iterator* it, Linear_Scan_Block* blocks){
+	return scanNextBatchWith(it, blocks, scratchArenas[it->structureId].real, scratchArenas[it->structureId].encBlocks);
+}
+
+void closeScan(Scan_Iterator* it){
+	if(it->ringId != -1) ocall_close_prefetch(it->ringId);
+	it->ringId = -1;
+}
+
 //generic features I may want at some point
 int opLinearScanBlock(int structureId, int index, Linear_Scan_Block* block, int write) {
 	if(oblivStructureTypes[structureId] != TYPE_LINEAR_SCAN) return 1; //if the designated data structure is not a linear scan structure
 	int size = oblivStructureSizes[structureId];
-	int blockSize = sizeof(Linear_Scan_Block);
-	int encBlockSize = sizeof(Encrypted_Linear_Scan_Block);
-
-	//allocate dummy storage and real storage
-	Linear_Scan_Block* dummy = (Linear_Scan_Block*)malloc(blockSize);
-	Linear_Scan_Block* real = (Linear_Scan_Block*)malloc(blockSize);
-	Encrypted_Linear_Scan_Block* dummyEnc = (Encrypted_Linear_Scan_Block*)malloc(encBlockSize);
-	Encrypted_Linear_Scan_Block* realEnc = (Encrypted_Linear_Scan_Block*)malloc(encBlockSize);
+	if(rowsPerBlock[structureId] > 1 || numColumnGroups[structureId] > 0){
+		//rows here don't have blocks of their own, so every batch is read (and written back) whole instead
+		Linear_Scan_Block* batch = (Linear_Scan_Block*)malloc(SCAN_BATCH_SIZE*sizeof(Linear_Scan_Block));
+		if(batch == NULL) return 1;
+		int mask = scanGroupMasks[structureId];
+		scanGroupMasks[structureId] = -1;
+		int ret = 0;
+		for(int start = 0; start < size && ret == 0; start += SCAN_BATCH_SIZE){
+			int n = (size-start < SCAN_BATCH_SIZE) ? size-start : SCAN_BATCH_SIZE;
+			ret = opLinearScanBlocks(structureId, start, n, batch, 0);
+			if(index >= start && index < start+n){
+				if(write) memcpy(&batch[index-start], block, BLOCK_DATA_SIZE);
+				else memcpy(block, &batch[index-start], BLOCK_DATA_SIZE);
+			}
+			if(write && ret == 0) ret = opLinearScanBlocks(structureId, start, n, batch, 1);
+		}
+		scanGroupMasks[structureId] = mask;
+		free(batch);
+		return ret;
+	}
+	int encBlockSize = linearEncBlockSize(structureId);
+
+	//dummy storage and real storage come from the structure's scratch arena
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Real_Linear_Scan_Block* dummy = arena->dummy;
+	Real_Linear_Scan_Block* real = arena->real;
+	Encrypted_Linear_Scan_Block* dummyEnc = &arena->encBlocks[1];
+	Encrypted_Linear_Scan_Block* realEnc = &arena->encBlocks[0];
+	if(write){
+		memcpy(real->data, block, BLOCK_DATA_SIZE);
+		real->actualAddr = index;
+		real->revNum = revNum[structureId][index];
+	}
 
 	for(int i = 0; i < size; i++){
 		if(i == index){//printf("begin real\n");
 			if(write){//we leak whether an op is a read or a write; we could hide it, but it may not be necessary?
-				if(encryptBlock(realEnc, block, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1; //replace encryption of real with encryption of block
+				if(encryptLinearBlocks(structureId, realEnc, real, 1)!=0) return 1; //replace encryption of real with encryption of block
 				ocall_write_block(structureId, i, encBlockSize, realEnc);
+				markWritten(structureId, i, 1);
 			}//printf("end real\n");
+			else if(!blockWritten(structureId, i)){
+				memset(real->data, 0, BLOCK_DATA_SIZE);
+			}
 			else{
 				ocall_read_block(structureId, i, encBlockSize, realEnc);//printf("here\n");
 				//printf("beginning of mac(op)? %d\n", realEnc->macTag[0]);
-				if(decryptBlock(realEnc, real, obliv_key, TYPE_LINEAR_SCAN) != 0) return 1;
+				if(decryptLinearBlocks(structureId, realEnc, real, 1) != 0) return 1;
 			}
 
 		}
 		else{//printf("begin dummy\n");
 			if(write){
-				if(encryptBlock(dummyEnc, dummy, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1;
+				if(encryptLinearBlocks(structureId, dummyEnc, dummy, 1)!=0) return 1;
 				ocall_write_block(structureId, i, encBlockSize, dummyEnc);
+				markWritten(structureId, i, 1);
 			}//printf("end dummy\n");
-			else{
+			else if(blockWritten(structureId, i)){
 				ocall_read_block(structureId, i, encBlockSize, dummyEnc);
 				//printf("beginning of mac(op)? %d\n", dummyEnc->macTag[0]);
-				if(decryptBlock(dummyEnc, dummy, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1;
+				if(decryptLinearBlocks(structureId, dummyEnc, dummy, 1)!=0) return 1;
 			}
 		}
 	}
 
-	//clean up
-	if(!write) memcpy(block, real, blockSize); //keep the value we extracted from real if we're reading
-
-	free(real);
-	free(dummy);
-	free(dummyEnc);
-	free(realEnc);
+	if(!write) memcpy(block, real->data, BLOCK_DATA_SIZE); //keep the value we extracted from real if we're reading
 
 	return 0;
 }
@@ -172,145 +793,130 @@ int opLinearScanUnencryptedBlock(int structureId, int index, Linear_Scan_Block*
 	if(oblivStructureTypes[structureId] != TYPE_LINEAR_UNENCRYPTED) return 1; //if the designated data structure is not a linear scan structure
 	int size = oblivStructureSizes[structureId];
 	int blockSize = sizeof(Linear_Scan_Block);
-	//int encBlockSize = sizeof(Encrypted_Linear_Scan_Block);
-	//allocate dummy storage and real storage
-	Linear_Scan_Block* dummy = (Linear_Scan_Block*)malloc(blockSize);
-	Linear_Scan_Block* real = (Linear_Scan_Block*)malloc(blockSize);
-	//Encrypted_Linear_Scan_Block* dummyEnc = (Encrypted_Linear_Scan_Block*)malloc(encBlockSize);
-	//Encrypted_Linear_Scan_Block* realEnc = (Encrypted_Linear_Scan_Block*)malloc(encBlockSize);
+	//dummy storage and real storage come from the structure's scratch arena
+	Linear_Scan_Block* dummy = (Linear_Scan_Block*)scratchArenas[structureId].dummy->data;
+	Linear_Scan_Block* real = (Linear_Scan_Block*)scratchArenas[structureId].real->data;
 
 	for(int i = 0; i < size; i++){
 		if(i == index){
 			ocall_read_block(structureId, i, blockSize, real);
-			//printf("beginning of mac(op)? %d\n", realEnc->macTag[0]);
-			//if(decryptBlock(realEnc, real, obliv_key, TYPE_LINEAR_SCAN) != 0) return 1;
 			if(write){//we leak whether an op is a read or a write; we could hide it, but it may not be necessary?
-				//if(encryptBlock(realEnc, block, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1; //replace encryption of real with encryption of block
-				ocall_write_block(structureId, i, blockSize, real);
+				ocall_write_block(structureId, i, blockSize, block);
 			}
 
 		}
 		else{
 			ocall_read_block(structureId, i, blockSize, dummy);
-			//printf("beginning of mac(op)? %d\n", dummyEnc->macTag[0]);
-			//if(decryptBlock(dummyEnc, dummy, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1;
 			if(write){
-				//if(encryptBlock(dummyEnc, dummy, obliv_key, TYPE_LINEAR_SCAN)!=0) return 1;
 				ocall_write_block(structureId, i, blockSize, dummy);
 			}
 		}
 	}
 
-	//clean up
 	if(!write) memcpy(block, real, blockSize); //keep the value we extracted from real if we're reading
 
-	free(real);
-	free(dummy);
-	//free(dummyEnc);
-	//free(realEnc);
-
 	return 0;
 }
 
 int opOramBlock(int structureId, int index, Oram_Block* retBlock, int write){
+	if(oblivStructureTypes[structureId] == TYPE_RING_ORAM) return opRingOramBlock(structureId, index, retBlock, write);
+	if(oblivStructureTypes[structureId] == TYPE_CIRCUIT_ORAM) return opCircuitOramBlock(structureId, index, retBlock, write);
 	//not making a real effort to protect against timing differences for this part
-	//printf("check1 %d %d %d %d\n", structureId, stashOccs[structureId], stashes[structureId]->size(), stashes[structureId]->begin()->actualAddr);
+	//printf("check1 %d %d\n", structureId, stashOccs[structureId]);
 
 	int blockSize = sizeof(Oram_Block);
-	int bucketSize = sizeof(Oram_Bucket);
 	int encBucketSize = sizeof(Encrypted_Oram_Bucket);
-	Oram_Block* block = (Oram_Block*)malloc(sizeof(Oram_Block));
-	Oram_Bucket* bucket = (Oram_Bucket*)malloc(sizeof(Oram_Bucket));
-	Encrypted_Oram_Bucket* encBucket = (Encrypted_Oram_Bucket*)malloc(sizeof(Encrypted_Oram_Bucket));
-	int oldLeaf = positionMaps[structureId][index];//printf("old leaf: %d", oldLeaf);
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Oram_Block* block = arena->block;
+	Oram_Bucket* bucket = arena->bucket;
 	int treeSize = logicalSizes[structureId];
 	//pick a leaf between 0 and logicalSizes[structureId]/2
-	if(sgx_read_rand((uint8_t*)&positionMaps[structureId][index], sizeof(unsigned int)) != SGX_SUCCESS) return 1;//Error comes from here
-	positionMaps[structureId][index] = positionMaps[structureId][index] % (treeSize/2+1);
-	int newLeaf = positionMaps[structureId][index];
-	//if(newLeaf < 0) printf("bad!!!\n");
-
-	//empty bucket to write to structure to erase stale data from tree
-	uint8_t* junk = (uint8_t*)malloc(bucketSize);
-	uint8_t* encJunk = (uint8_t*)malloc(encBucketSize);
-	memset(junk, '\0', bucketSize);
-	memset(&junk[0], 0xff, 4);//set actualAddr to -1
-	memset(&junk[sizeof(Oram_Block)], 0xff, 4);//set actualAddr to -1
-	memset(&junk[2*sizeof(Oram_Block)], 0xff, 4);//set actualAddr to -1
-	memset(&junk[3*sizeof(Oram_Block)], 0xff, 4);//set actualAddr to -1
-	memset(encJunk, 0xff, encBucketSize);
+	unsigned int newLeaf = 0;
+	if(sgx_read_rand((uint8_t*)&newLeaf, sizeof(unsigned int)) != SGX_SUCCESS) return 1;//Error comes from here
+	newLeaf = newLeaf % (treeSize/2+1);
+	unsigned int oldLeaf = 0;
+	if(posMapSwap(structureId, index, newLeaf, &oldLeaf, 0)) return 1;
+	//printf("old leaf: %d", oldLeaf);
+
 	//printf("check1.5\n");
-	if(encryptBlock(encJunk, junk, obliv_key, TYPE_ORAM)) return 1;
 
 
-	//printf("old leaf: %d, new leaf: %d\n", oldLeaf, positionMaps[structureId][index]);
+	//printf("old leaf: %d, new leaf: %d\n", oldLeaf, newLeaf);
 
-	//printf("begin stash size: %d %d\n", stashOccs[structureId], stashes[structureId]->size());
+	//printf("begin stash size: %d\n", stashOccs[structureId]);
 
 	//printf("check2 %d %d\n", treeSize, oldLeaf);
 
-	//read in a path
-	int nodeNumber = treeSize/2+oldLeaf;
-	for(int i = (int)log2(treeSize+1.1)-1; i>=0; i--){
-		//read in bucket at depth i on path to oldLeaf
+	//read in the whole path to oldLeaf in one transition, the app works out the bucket indices
+	int levels = (int)log2(treeSize+1.1);
+	//the top levels come from the tree-top cache, only the ones below it are fetched
+	int fetched = levels - treeTopLevels[structureId];
+	//buckets that were never written are empty, a path with none written isn't fetched at all
+	int pathWritten = 0;
+	for(int i = 0; i < fetched; i++) pathWritten += blockWritten(structureId, pathBucket(treeSize, oldLeaf, i));
+	if(pathWritten) ocall_read_path(structureId, oldLeaf, fetched, encBucketSize, arena->encPath);
+	for(int i = 0; i < levels; i++){
+		Oram_Bucket* read = bucket;
+		if(i >= fetched) read = &treeTops[structureId][pathBucket(treeSize, oldLeaf, i)];
+		else if(!blockWritten(structureId, pathBucket(treeSize, oldLeaf, i))) continue;
 		//encrypt/decrypt buckets all at once instead of blocks
-		//let index be the node number in a levelorder traversal and size the encBucketSize
-		ocall_read_block(structureId, nodeNumber, encBucketSize, encBucket);//printf("here %d %d %d\n", nodeNumber, treeSize, oldLeaf);
-		if(decryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) return 1;
-		//write back dummy blocks to replace blocks we just took out
-		ocall_write_block(structureId, nodeNumber, encBucketSize, encJunk);
+		else if(decryptBlock(&arena->encPath[i], bucket, oblivKeys[structureId], TYPE_ORAM) != 0) return 1;
 		for(int j = 0; j < BUCKET_SIZE;j++){
-			//printf("saw block %d  ", bucket->blocks[j].actualAddr);
-			if(bucket->blocks[j].actualAddr != -1){
-				//printf("pushing actualAddr block %d\n", bucket->blocks[j].actualAddr);
-				stashes[structureId]->push_front(bucket->blocks[j]);
-				stashOccs[structureId]++;
+			//printf("saw block %d  ", read->blocks[j].actualAddr);
+			if(read->blocks[j].actualAddr != -1){
+				//printf("pushing actualAddr block %d\n", read->blocks[j].actualAddr);
+				if(stashInsert(structureId, &read->blocks[j], read->leaves[j]) == -1) return 1;
 			}
 		}
-		nodeNumber = (nodeNumber-1)/2;
 	}
 
 	//printf("check3\n");
 
-	//debug: print blocks in stash
-	//std::list<Oram_Block>::iterator stashScanDebug = stashes[structureId]->begin();
-	//while(stashScanDebug != stashes[structureId]->end()){
-			//printf("block %d is in stash\n", stashScanDebug->actualAddr);
-	//	stashScanDebug++;
-	//}
-	//printf("\n");
-
 	//read/write target block from stash
+	Oram_Stash* stash = &stashes[structureId];
 	int foundItFlag = 0;
-	std::list<Oram_Block>::iterator stashScan = stashes[structureId]->begin();
-	while(stashScan != stashes[structureId]->end()){
-		//printf("looking at %d\n", stashScan->actualAddr);
-		if(stashScan->actualAddr == index && foundItFlag == 0){//printf("hey! we're here!!\n");
+	for(int s = 0; s < stash->capacity; s++){
+		if(!stashSlotUsed(structureId, s)) continue;
+		//printf("looking at %d\n", stash->blocks[s].actualAddr);
+		if(stash->blocks[s].actualAddr == index && foundItFlag == 0){//printf("hey! we're here!!\n");
 			foundItFlag = 1;
-			if(write){
+			stash->leaves[s] = newLeaf;
+			if(write == ORAM_POSMAP_SWAP){
+				if(stash->blocks[s].revNum != revNum[structureId][index]){
+					printf("AUTHENTICITY FAILURE a: block version not as expected! Expected %d, got %d\n", revNum[structureId][index], stash->blocks[s].revNum);
+					return 1;
+				}
+				applyPosMapSwap(&stash->blocks[s], retBlock);
+				revNum[structureId][index]++;
+				stash->blocks[s].revNum = revNum[structureId][index];
+			}
+			else if(write){
 				retBlock->actualAddr = index;
 				revNum[structureId][retBlock->actualAddr]++;
 				retBlock->revNum = revNum[structureId][retBlock->actualAddr];
-				//memcpy(&stashes[structureId][i], retBlock, blockSize);
-				memcpy(&(*stashScan), retBlock, blockSize);
+				memcpy(&stash->blocks[s], retBlock, blockSize);
 			}
 			else{
-				//memcpy(retBlock, &stashes[structureId][i], blockSize);
-				memcpy(retBlock, &(*stashScan), blockSize);
+				memcpy(retBlock, &stash->blocks[s], blockSize);
 				if(retBlock->revNum != revNum[structureId][index]){
 					printf("AUTHENTICITY FAILURE a: block version not as expected! Expected %d, got %d\n", revNum[structureId][index], retBlock->revNum);
 					return 1;
 				}
 			}
 		}
-		stashScan++;
 	}
 
 	if(foundItFlag == 0){//the desired block has not been initialized
 		//printf("creating block %d\n", index);
 		//put the new block on the stash
 		block->actualAddr = index;
-		if(write){
+		if(write == ORAM_POSMAP_SWAP){
+			memset(block->data, 0, BLOCK_DATA_SIZE);
+			applyPosMapSwap(block, retBlock);
+			revNum[structureId][index]++;
+			block->revNum = revNum[structureId][index];
+		}
+		else if(write){
 			retBlock->actualAddr = index;
 			revNum[structureId][retBlock->actualAddr]++;
 			retBlock->revNum = revNum[structureId][retBlock->actualAddr];
@@ -324,91 +930,71 @@ int opOramBlock(int structureId, int index, Oram_Block* retBlock, int write){
 				return 1;
 			}
 		}
-		//memcpy(&stashes[structureId][stashOccs[structureId]], &newBlock, blockSize);
-		stashes[structureId]->push_back(*block);
-		stashOccs[structureId]++;
+		if(stashInsert(structureId, block, newLeaf) == -1) return 1;
 	}
 
 	//printf("check4\n");
-	//printf("mid stash size: %d %d\n", stashOccs[structureId], stashes[structureId]->size());
-
-	nodeNumber = treeSize/2+oldLeaf;
-	for(int i = (int)log2(treeSize+1.1)-1; i>=0; i--){
-		int div = pow((double)2, ((int)log2(treeSize+1.1)-1)-i);
-		//printf("nodeNumber: %d\n", nodeNumber);
-		//read contents of bucket
-		ocall_read_block(structureId, nodeNumber, encBucketSize, encBucket);
-		if(decryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) return 1;
-
-		//for each dummy entry in bucket, fill with candidates from stash
-		int stashCounter = stashOccs[structureId];
-		std::list<Oram_Block>::iterator p = stashes[structureId]->begin();
-		for(int j = 0; j < BUCKET_SIZE; j++){
-			//printf("bucket entry %d, actualAddr %d %d\n", j, bucket->blocks[j].actualAddr, stashCounter);
-			if(bucket->blocks[j].actualAddr == -1){//printf("herein %d\n", stashCounter);
-				while(stashCounter > 0){//printf("hereinner %d\n", p->actualAddr);
-					int destinationLeaf = positionMaps[structureId][p->actualAddr];
-					int conditionMet = 0;
-					//div is 2 raised to the number of levels from the leaf to the current depth
-					conditionMet = ((treeSize/2)+oldLeaf-(div-1))/div == ((treeSize/2)+destinationLeaf-(div-1))/div;
-					//printf("%d %d", ((treeSize/2)+oldLeaf-(div-1))/div, ((treeSize/2)+destinationLeaf-(div-1))/div);
-					if(conditionMet){//we can put this block in this bucket
-							//printf("condition met! leaves: %d %d, depth: %d, div: %d, block: %d\n", oldLeaf, destinationLeaf, i, div, p->actualAddr);
-						//printf("removing an item form the stash\n");
-						memcpy(&bucket->blocks[j], &(*p), blockSize);
-						//remove from stash
-						std::list<Oram_Block>::iterator prev = p++;
-						stashes[structureId]->erase(prev);
-						stashOccs[structureId]--;
-						stashCounter--;
-						break;
-					}
-					p++;
-					stashCounter--;
-				}//printf("here\n");
-			}
+	//printf("mid stash size: %d\n", stashOccs[structureId]);
 
+	//work out once how deep each stashed block can go on this path, then hand them out deepest first
+	for(int s = 0; s < stash->capacity; s++){
+		if(stashSlotUsed(structureId, s)) stash->depths[s] = stashDeepestLevel(treeSize, oldLeaf, stash->leaves[s], levels);
+	}
+	int numCandidates = stashOrderByDepth(structureId, levels);
+	int nextCandidate = 0;
+
+	//everything on the path is in the stash now, so each bucket is rebuilt from empty
+	for(int i = levels-1; i>=0; i--){
+		memcpy(bucket, arena->junk, sizeof(Oram_Bucket));
+		//candidates that fit this level are always a prefix of what is left
+		int placed = 0;
+		while(placed < BUCKET_SIZE && nextCandidate < numCandidates && stash->depths[stash->order[nextCandidate]] >= i){
+			memcpy(&bucket->blocks[placed], &stash->blocks[stash->order[nextCandidate]], blockSize);
+			bucket->leaves[placed] = stash->leaves[stash->order[nextCandidate]];
+			stashRemove(structureId, stash->order[nextCandidate]);
+			nextCandidate++;
+			placed++;
 		}
-		//printf("another check\n");
-		//write bucket back to tree
-		//printf("blocks we are inserting at this level: %d %d %d %d\n", currentBucket.blocks[0].actualAddr, currentBucket.blocks[1].actualAddr, currentBucket.blocks[2].actualAddr,currentBucket.blocks[3].actualAddr);
-		if(encryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) return 1;
-		ocall_write_block(structureId, nodeNumber, encBucketSize, encBucket);
-		nodeNumber = (nodeNumber-1)/2;
+		//printf("blocks we are inserting at this level: %d %d %d %d\n", bucket->blocks[0].actualAddr, bucket->blocks[1].actualAddr, bucket->blocks[2].actualAddr, bucket->blocks[3].actualAddr);
+		if(levels-1-i >= fetched){
+			memcpy(&treeTops[structureId][pathBucket(treeSize, oldLeaf, levels-1-i)], bucket, sizeof(Oram_Bucket));
+			continue;
+		}
+		//empty buckets can go out as one of the junk encryptions made ahead of time
+		Encrypted_Oram_Bucket* freshJunk = placed ? NULL : takeJunkBucket(structureId);
+		if(freshJunk) memcpy(&arena->encPath[levels-1-i], freshJunk, encBucketSize);
+		else if(encryptBlock(structureId, &arena->encPath[levels-1-i], bucket, oblivKeys[structureId], TYPE_ORAM) != 0) return 1;
 	}
+	if(fetched > 0) ocall_write_path(structureId, oldLeaf, fetched, encBucketSize, arena->encPath);
+	for(int i = 0; i < fetched; i++) markWritten(structureId, pathBucket(treeSize, oldLeaf, i), 1);
 
 	//printf("check5\n");
-	//printf("end stash size: %d %d\n", stashOccs[structureId], stashes[structureId]->size());
+	//printf("end stash size: %d\n", stashOccs[structureId]);
 	if(stashOccs[structureId] > EXTRA_STASH_SPACE){
 		printf("using too much stash! %d\n", stashOccs[structureId]);
 		return 1;
 	}
 
-	//free resources used
-	free(block);
-	free(bucket);
-	free(encBucket);
-	free(junk);
-	free(encJunk);
+	//put back one fresh junk bucket now that the path is done, the app tops up the rest between queries
+	if(refillJunkPool(structureId, 1)) return 1;
 
 	return 0;
 }
 
 sgx_status_t oramDistribution(int structureId) {
-	int blockSize = sizeof(Oram_Block);
-	int bucketSize = sizeof(Oram_Bucket);
 	int encBucketSize = sizeof(Encrypted_Oram_Bucket);
-	Oram_Block* block = (Oram_Block*)malloc(sizeof(Oram_Block));
-	Oram_Bucket* bucket = (Oram_Bucket*)malloc(sizeof(Oram_Bucket));
-	Encrypted_Oram_Bucket* encBucket = (Encrypted_Oram_Bucket*)malloc(sizeof(Encrypted_Oram_Bucket));
+	Oram_Bucket* bucket = scratchArenas[structureId].bucket;
+	Encrypted_Oram_Bucket* encBucket = scratchArenas[structureId].encBucket;
 	int treeSize = oblivStructureSizes[structureId];
+	if(flushTreeTop(structureId)) return SGX_ERROR_UNEXPECTED;
 
 	for(int i = (int)log2(treeSize+1.1)-1; i>=0; i--){
 		int depthCount = 0;
 		for (int k = 0; k < (int)pow((double)2, i)-.9; k++){
 			//printf("reading block %d\n", (int)(pow((double)2, i)-.9)+k);
+			if(!blockWritten(structureId, (int)(pow((double)2, i)-.9)+k)) continue;
 			ocall_read_block((double)structureId, (int)(pow((double)2, i)-.9)+k, encBucketSize, encBucket);//printf("here\n");
-			if(decryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) {
+			if(decryptBlock(encBucket, bucket, oblivKeys[structureId], TYPE_ORAM) != 0) {
 				printf("fail\n");
 				return SGX_ERROR_UNEXPECTED;
 			}
@@ -417,8 +1003,6 @@ sgx_status_t oramDistribution(int structureId) {
 				//printf("saw block %d  ", bucket->blocks[j].actualAddr);
 				if(bucket->blocks[j].actualAddr != -1){
 					depthCount++;
-					stashes[structureId]->push_front(bucket->blocks[j]);
-					stashOccs[structureId]++;
 				}
 			}
 		}
@@ -458,19 +1042,56 @@ int posMapAccess(int structureId, int index, unsigned int* value, int write){
 	return 0;
 }
 
+//looks up the leaf of block index and replaces it with newLeaf
+//recursive maps keep leaf+1 in a child oram so that 0 means the block was never placed
+int posMapSwap(int structureId, int index, unsigned int newLeaf, unsigned int* oldLeaf, int safe){
+	if(posMapIds[structureId] == -1){
+		if(safe){
+			posMapAccess(structureId, index, oldLeaf, 0);
+			posMapAccess(structureId, index, &newLeaf, 1);
+		}
+		else{
+			*oldLeaf = positionMaps[structureId][index];
+			positionMaps[structureId][index] = newLeaf;
+		}
+		return 0;
+	}
+	int childId = posMapIds[structureId];
+	Oram_Block* request = scratchArenas[structureId].block;
+	unsigned int* entries = (unsigned int*)request->data;
+	entries[0] = index%POSMAP_ENTRIES_PER_BLOCK;
+	entries[1] = newLeaf+1;
+	int ret = safe ? opOramBlockSafe(childId, index/POSMAP_ENTRIES_PER_BLOCK, request, ORAM_POSMAP_SWAP)
+			: opOramBlock(childId, index/POSMAP_ENTRIES_PER_BLOCK, request, ORAM_POSMAP_SWAP);
+	if(ret) return 1;
+	if(entries[0] == 0){//never placed, any leaf is as good as the one it would have been given
+		if(sgx_read_rand((uint8_t*)oldLeaf, sizeof(unsigned int)) != SGX_SUCCESS) return 1;
+		*oldLeaf = *oldLeaf % (logicalSizes[structureId]/2+1);
+	}
+	else *oldLeaf = entries[0]-1;
+	return 0;
+}
+
+//ORAM_POSMAP_SWAP on a block of a position map oram: stores request's new entry, returns the old one in request
+void applyPosMapSwap(Oram_Block* stored, Oram_Block* request){
+	unsigned int* entries = (unsigned int*)stored->data;
+	unsigned int* args = (unsigned int*)request->data;
+	unsigned int old = entries[args[0]];
+	entries[args[0]] = args[1];
+	args[0] = old;
+}
+
 int opOramBlockSafe(int structureId, int index, Oram_Block* retBlock, int write){
+	if(oblivStructureTypes[structureId] == TYPE_RING_ORAM) return opRingOramBlock(structureId, index, retBlock, write);
+	if(oblivStructureTypes[structureId] == TYPE_CIRCUIT_ORAM) return opCircuitOramBlock(structureId, index, retBlock, write);
 	//not making a real effort to protect against timing differences for this part
 	//printf("check1 %d\n", structureId);
 
 	int blockSize = sizeof(Oram_Block);
-	int bucketSize = sizeof(Oram_Bucket);
 	int encBucketSize = sizeof(Encrypted_Oram_Bucket);
-	Oram_Block* block = (Oram_Block*)malloc(sizeof(Oram_Block));
-	Oram_Bucket* bucket = (Oram_Bucket*)malloc(sizeof(Oram_Bucket));
-	Encrypted_Oram_Bucket* encBucket = (Encrypted_Oram_Bucket*)malloc(sizeof(Encrypted_Oram_Bucket));
-	unsigned int oldLeaf = -1;
-	posMapAccess(structureId, index, &oldLeaf, 0);
-	//printf("old leaf: %d\n", oldLeaf);
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Oram_Block* block = arena->block;
+	Oram_Bucket* bucket = arena->bucket;
 	int treeSize = logicalSizes[structureId];
 	//pick a leaf between 0 and logicalSizes[structureId]/2
 	unsigned int newLeaf = -1;
@@ -479,159 +1100,127 @@ int opOramBlockSafe(int structureId, int index, Oram_Block* retBlock, int write)
 		return 1;//Error comes from here
 	}
 	newLeaf = newLeaf % (treeSize/2+1);
-	posMapAccess(structureId, index, &newLeaf, 1);
-	//printf("new leaf: %d\n", newLeaf);
-
-
-	//empty bucket to write to structure to erase stale data from tree
-	uint8_t* junk = (uint8_t*)malloc(bucketSize);
-	uint8_t* encJunk = (uint8_t*)malloc(encBucketSize);
-	memset(junk, 0xff, bucketSize);
-	memset(encJunk, 0xff, encBucketSize);
-	if(encryptBlock(encJunk, junk, obliv_key, TYPE_ORAM)) {
+	unsigned int oldLeaf = -1;
+	if(posMapSwap(structureId, index, newLeaf, &oldLeaf, 1)) {
 		printf("fail position 1\n");
 		return 1;
 	}
+	//printf("old leaf: %d, new leaf: %d\n", oldLeaf, newLeaf);
+
+
 
 
 	//printf("old leaf: %d, new leaf: %d\n", oldLeaf, positionMaps[structureId][index]);
 
-	//printf("begin stash size: %d %d\n", stashOccs[structureId], stashes[structureId]->size());
+	//printf("begin stash size: %d\n", stashOccs[structureId]);
 
 	//printf("check2\n");
 
-	//read in a path
-	int nodeNumber = treeSize/2+oldLeaf;
-	for(int i = (int)log2(treeSize+1.1)-1; i>=0; i--){
-		//read in bucket at depth i on path to oldLeaf
-		//encrypt/decrypt buckets all at once instead of blocks
-		//let index be the node number in a levelorder traversal and size the encBucketSize
-		ocall_read_block(structureId, nodeNumber, encBucketSize, encBucket);//printf("here\n");
-		if(decryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) {
+	//read in the whole path to oldLeaf in one transition, less the levels in the tree-top cache
+	int levels = (int)log2(treeSize+1.1);
+	int fetched = levels - treeTopLevels[structureId];
+	int pathWritten = 0;
+	for(int i = 0; i < fetched; i++) pathWritten += blockWritten(structureId, pathBucket(treeSize, oldLeaf, i));
+	if(pathWritten) ocall_read_path(structureId, oldLeaf, fetched, encBucketSize, arena->encPath);
+	for(int i = 0; i < levels; i++){
+		Oram_Bucket* read = bucket;
+		if(i >= fetched) read = &treeTops[structureId][pathBucket(treeSize, oldLeaf, i)];
+		else if(!blockWritten(structureId, pathBucket(treeSize, oldLeaf, i))) continue;
+		else if(decryptBlock(&arena->encPath[i], bucket, oblivKeys[structureId], TYPE_ORAM) != 0) {
 			printf("fail position 2\n");
 			return 1;
 		}
-		//write back dummy blocks to replace blocks we just took out
-		ocall_write_block(structureId, nodeNumber, encBucketSize, encJunk);
 		for(int j = 0; j < BUCKET_SIZE;j++){
-			//printf("saw block %d  ", bucket->blocks[j].actualAddr);
-			if(bucket->blocks[j].actualAddr != -1){
-				stashes[structureId]->push_front(bucket->blocks[j]);
-				stashOccs[structureId]++;
+			//printf("saw block %d  ", read->blocks[j].actualAddr);
+			if(read->blocks[j].actualAddr != -1){
+				if(stashInsert(structureId, &read->blocks[j], read->leaves[j]) == -1) {
+					printf("fail position 5\n");
+					return 1;
+				}
 			}
 		}
-		nodeNumber = (nodeNumber-1)/2;
 	}
 
 	//printf("check3\n");
 
-	//debug: print blocks in stash
-	std::list<Oram_Block>::iterator stashScanDebug = stashes[structureId]->begin();
-	while(stashScanDebug != stashes[structureId]->end()){
-			//printf("block %d is in stash\n", stashScanDebug->actualAddr);
-		stashScanDebug++;
-	}
-	//printf("\n");
-
 	//read/write target block from stash
+	Oram_Stash* stash = &stashes[structureId];
 	int foundItFlag = 0;
-	std::list<Oram_Block>::iterator stashScan = stashes[structureId]->begin();
-	while(stashScan != stashes[structureId]->end()){
-		//printf("looking at %d\n", stashScan->actualAddr);
-		if(stashScan->actualAddr == index){
+	for(int s = 0; s < stash->capacity; s++){
+		if(!stashSlotUsed(structureId, s)) continue;
+		//printf("looking at %d\n", stash->blocks[s].actualAddr);
+		if(stash->blocks[s].actualAddr == index){
 			foundItFlag = 1;
-			if(write){
-				//memcpy(&stashes[structureId][i], retBlock, blockSize);
-				memcpy(&(*stashScan), retBlock, blockSize);
+			stash->leaves[s] = newLeaf;
+			if(write == ORAM_POSMAP_SWAP){
+				applyPosMapSwap(&stash->blocks[s], retBlock);
+			}
+			else if(write){
+				memcpy(&stash->blocks[s], retBlock, blockSize);
 			}
 			else{
-				//memcpy(retBlock, &stashes[structureId][i], blockSize);
-				memcpy(retBlock, &(*stashScan), blockSize);
-
+				memcpy(retBlock, &stash->blocks[s], blockSize);
 			}
 		}
-		stashScan++;
 	}
 
 	if(foundItFlag == 0){//the desired block has not been initialized
 		//printf("creating block %d\n", index);
 		//put the new block on the stash
 		block->actualAddr = index;
-		if(write){
+		if(write == ORAM_POSMAP_SWAP){
+			memset(block->data, 0, BLOCK_DATA_SIZE);
+			applyPosMapSwap(block, retBlock);
+		}
+		else if(write){
 			memcpy(block, retBlock, blockSize);
 		}
-		//memcpy(&stashes[structureId][stashOccs[structureId]], &newBlock, blockSize);
-		stashes[structureId]->push_back(*block);
-		stashOccs[structureId]++;
+		if(stashInsert(structureId, block, newLeaf) == -1) {
+			printf("fail position 6\n");
+			return 1;
+		}
 	}
 
 	//printf("check4\n");
-	//printf("mid stash size: %d %d\n", stashOccs[structureId], stashes[structureId]->size());
+	//printf("mid stash size: %d\n", stashOccs[structureId]);
 
-	nodeNumber = treeSize/2+oldLeaf;
-	for(int i = (int)log2(treeSize+1.1)-1; i>=0; i--){
-		//printf("nodeNumber: %d\n", nodeNumber);
-		int div = pow((double)2, ((int)log2(treeSize+1.1)-1)-i);
-		//read contents of bucket
-		ocall_read_block(structureId, nodeNumber, encBucketSize, encBucket);//printf("here\n");
-		if(decryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) {
-			printf("fail position 3\n");
-			return 1;
-		}
+	//leaves travel with the blocks, so eviction needs no position map lookups
+	for(int s = 0; s < stash->capacity; s++){
+		if(stashSlotUsed(structureId, s)) stash->depths[s] = stashDeepestLevel(treeSize, oldLeaf, stash->leaves[s], levels);
+	}
+	int numCandidates = stashOrderByDepth(structureId, levels);
+	int nextCandidate = 0;
 
-		//for each dummy entry in bucket, fill with candidates from stash
-		int stashCounter = stashOccs[structureId];
-		std::list<Oram_Block>::iterator p = stashes[structureId]->begin();
+	//everything on the path is in the stash now, so each bucket is rebuilt from empty
+	//every bucket is encrypted here, junk included, so the time taken does not depend on how full the path is
+	for(int i = levels-1; i>=0; i--){
+		memcpy(bucket, arena->junk, sizeof(Oram_Bucket));
 		for(int j = 0; j < BUCKET_SIZE; j++){
-			//printf("bucket entry %d\n", j);
-			if(bucket->blocks[j].actualAddr == -1){
-				while(stashCounter > 0){
-					unsigned int destinationLeaf = -1;
-					posMapAccess(structureId, p->actualAddr, &destinationLeaf, 0);
-					if(destinationLeaf < 0) printf("destLeaf %d\n", destinationLeaf);
-					int conditionMet = 0;
-					//div is 2 raised to the number of levels from the leaf to the current depth
-					conditionMet = ((treeSize/2)+oldLeaf-(div-1))/div == ((treeSize/2)+destinationLeaf-(div-1))/div;
-					if(conditionMet){//we can put this block in this bucket
-							//printf("condition met! leaves: %d %d, depth: %d, div: %d, block: %d\n", oldLeaf, destinationLeaf, i, div, p->actualAddr);
-						memcpy(&bucket->blocks[j], &(*p), blockSize);
-						//remove from stash
-						std::list<Oram_Block>::iterator prev = p++;
-						stashes[structureId]->erase(prev);
-						stashOccs[structureId]--;
-						stashCounter--;
-						break;
-					}
-					p++;
-					stashCounter--;
-				}
+			if(nextCandidate < numCandidates && stash->depths[stash->order[nextCandidate]] >= i){
+				memcpy(&bucket->blocks[j], &stash->blocks[stash->order[nextCandidate]], blockSize);
+				bucket->leaves[j] = stash->leaves[stash->order[nextCandidate]];
+				stashRemove(structureId, stash->order[nextCandidate]);
+				nextCandidate++;
 			}
-
 		}
-		//write bucket back to tree
-		//printf("blocks we are inserting at this level: %d %d %d %d\n", currentBucket.blocks[0].actualAddr, currentBucket.blocks[1].actualAddr, currentBucket.blocks[2].actualAddr,currentBucket.blocks[3].actualAddr);
-		if(encryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) {
+		if(levels-1-i >= fetched){
+			memcpy(&treeTops[structureId][pathBucket(treeSize, oldLeaf, levels-1-i)], bucket, sizeof(Oram_Bucket));
+		}
+		else if(encryptBlock(structureId, &arena->encPath[levels-1-i], bucket, oblivKeys[structureId], TYPE_ORAM) != 0) {
 			printf("fail position 4\n");
 			return 1;
 		}
-		ocall_write_block(structureId, nodeNumber, encBucketSize, encBucket);
-		nodeNumber = (nodeNumber-1)/2;
 	}
+	if(fetched > 0) ocall_write_path(structureId, oldLeaf, fetched, encBucketSize, arena->encPath);
+	for(int i = 0; i < fetched; i++) markWritten(structureId, pathBucket(treeSize, oldLeaf, i), 1);
 
 	//printf("check5\n");
-	//printf("end stash size: %d %d\n", stashOccs[structureId], stashes[structureId]->size());
+	//printf("end stash size: %d\n", stashOccs[structureId]);
 	if(stashOccs[structureId] > EXTRA_STASH_SPACE){
 		printf("using too much stash: %d\n", stashOccs[structureId]);
 		return 1;
 	}
 
-	//free resources used
-	free(block);
-	free(bucket);
-	free(encBucket);
-	free(junk);
-	free(encJunk);
-
 	return 0;
 }
 
@@ -643,59 +1232,79 @@ int opOramTreeBlock(int structureId, int index, Oram_Tree_Block* block, int writ
 
 
 
-int encryptBlock(void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type){
-	sgx_status_t ret = SGX_SUCCESS;
-	int retVal = 0;
+//ivs never come from the rng: each structure has a random prefix and a counter, and the iv is the
+//first 12 bytes of AES(iv_key, prefix || counter), so ivs never repeat but still look random from outside
+int initIvCounter(int structureId){
+	ivCounters[structureId].next = 0;
+	if(sgx_read_rand(ivCounters[structureId].prefix, 8) != SGX_SUCCESS) return 1;
+	return 0;
+}
+
+//writes count fresh ivs, stride bytes apart, starting at iv; one aes-ctr call makes up to IV_BATCH of them
+//safe to call from several scan threads at once
+int makeIvs(int structureId, uint8_t* iv, int count, int stride){
+	static const uint8_t zeros[16*IV_BATCH] = {0};
+	uint8_t stream[16*IV_BATCH];
+	uint8_t ctr[16];
+	uint64_t first = __sync_fetch_and_add(&ivCounters[structureId].next, (uint64_t)count);
+	for(int done = 0; done < count; done += IV_BATCH){
+		int n = (count-done < IV_BATCH) ? count-done : IV_BATCH;
+		uint64_t c = first + done;
+		memcpy(ctr, ivCounters[structureId].prefix, 8);
+		for(int b = 0; b < 8; b++){
+			ctr[15-b] = (uint8_t)(c >> (8*b)); //big endian, which is how aes-ctr counts
+		}
+		if(sgx_aes_ctr_encrypt(iv_key, zeros, 16*n, ctr, 64, stream) != SGX_SUCCESS) return 1;
+		for(int k = 0; k < n; k++){
+			memcpy(&iv[(done+k)*stride], &stream[16*k], 12);
+		}
+	}
+	return 0;
+}
+
+//encrypts numBlocks plaintext blocks stored back to back in pt into the encrypted blocks in ct
+//all their ivs are made up front in one go, then gcmEncryptBlocks runs the blocks through aes-gcm side by side
+int encryptBlocks(int structureId, void *ct, void *pt, int numBlocks, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type){
 	int encBlockSize = getEncBlockSize(type);
 	int blockSize = getBlockSize(type);
 	if(type == TYPE_ORAM){
 		blockSize = sizeof(Oram_Bucket);
 		encBlockSize = sizeof(Encrypted_Oram_Bucket);
 	}
+	uint8_t* ctBytes = (uint8_t*)ct;
 
+	//every encrypted type is ciphertext, macTag, iv in that order
 	switch(type){
-	case TYPE_LINEAR_SCAN://printf("here I am\n");
-		//get random IV
-		ret = sgx_read_rand(((Encrypted_Linear_Scan_Block*)ct)->iv, 12);
-		if(ret != SGX_SUCCESS) retVal = 1;
-		//encrypt
-		ret = sgx_rijndael128GCM_encrypt(key, (unsigned char*)pt, blockSize, ((Encrypted_Linear_Scan_Block*)ct)->ciphertext,
-				((Encrypted_Linear_Scan_Block*)ct)->iv, 12, NULL, 0, &((Encrypted_Linear_Scan_Block*)ct)->macTag);
-		if(ret != SGX_SUCCESS) retVal = 1;
+	case TYPE_LINEAR_SCAN:
+	case TYPE_RING_ORAM:
+	case TYPE_ORAM:
 		break;
 	case TYPE_TREE_ORAM:
-		//get random IV
-		ret = sgx_read_rand(((Encrypted_Oram_Tree_Block*)ct)->iv, 12);
-		if(ret != SGX_SUCCESS) retVal = 1;
-		//encrypt
-		ret = sgx_rijndael128GCM_encrypt(key, (unsigned char*)pt, blockSize, ((Encrypted_Oram_Tree_Block*)ct)->ciphertext,
-				((Encrypted_Oram_Tree_Block*)ct)->iv, 12, NULL, 0, &((Encrypted_Oram_Tree_Block*)ct)->macTag);
-		if(ret != SGX_SUCCESS) retVal = 1;
+		//its ciphertext field is bigger than the block, so it keeps one sdk call per block
+		encBlockSize = sizeof(Encrypted_Oram_Tree_Block);
+		if(makeIvs(structureId, ((Encrypted_Oram_Tree_Block*)ct)->iv, numBlocks, encBlockSize)) return 1;
+		for(int i = 0; i < numBlocks; i++){
+			Encrypted_Oram_Tree_Block* enc = (Encrypted_Oram_Tree_Block*)&ctBytes[i*encBlockSize];
+			if(sgx_rijndael128GCM_encrypt(key, &((uint8_t*)pt)[i*blockSize], blockSize, enc->ciphertext,
+					enc->iv, 12, NULL, 0, &enc->macTag) != SGX_SUCCESS) return 1;
+		}
 		printf("I'M ACTUALLY HERE ENC, LOOK AT ME LOOK AT ME LOOK AT ME\n");
-
-		break;
-	case TYPE_ORAM:
-		//get random IV
-		ret = sgx_read_rand(((Encrypted_Oram_Bucket*)ct)->iv, 12);
-		if(ret != SGX_SUCCESS) retVal = 1;
-		//encrypt
-		ret = sgx_rijndael128GCM_encrypt(key, (unsigned char*)pt, blockSize, ((Encrypted_Oram_Bucket*)ct)->ciphertext,
-				((Encrypted_Oram_Bucket*)ct)->iv, 12, NULL, 0, &((Encrypted_Oram_Bucket*)ct)->macTag);
-		//printf("hereenc: %d", ret);
-		if(ret != SGX_SUCCESS) retVal = 1;
-		break;
+		return 0;
 	default:
 		printf("error: trying to encrypt invalid data structure type\n"); return 1;
 		break;
 	}
 
-	//printf("completed an encryption with status %d and retVal %d\n", ret, retVal);
-	return retVal;
+	if(makeIvs(structureId, &ctBytes[blockSize+16], numBlocks, encBlockSize)) return 1;
+	return gcmEncryptBlocks(key, (uint8_t*)pt, blockSize, ctBytes, encBlockSize, blockSize, numBlocks);
 }
 
-int decryptBlock(void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type){
-	sgx_status_t ret = SGX_SUCCESS;
-	int retVal = 0;
+int encryptBlock(int structureId, void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type){
+	return encryptBlocks(structureId, ct, pt, 1, key, type);
+}
+
+//decrypts numBlocks encrypted blocks in ct into plaintext blocks stored back to back in pt
+int decryptBlocks(void *ct, void *pt, int numBlocks, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type){
 	int encBlockSize = getEncBlockSize(type);
 	int blockSize = getBlockSize(type);
 	if(type == TYPE_ORAM){
@@ -705,33 +1314,73 @@ int decryptBlock(void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type t
 
 	switch(type){
 	case TYPE_LINEAR_SCAN:
-		//decrypt
-		ret = sgx_rijndael128GCM_decrypt(key, ((Encrypted_Linear_Scan_Block*)ct)->ciphertext, blockSize, (unsigned char*)pt,
-				((Encrypted_Linear_Scan_Block*)ct)->iv, 12, NULL, 0, &((Encrypted_Linear_Scan_Block*)ct)->macTag);
-		//printf("beginning of mac(enclave)? %d\n", ((Encrypted_Linear_Scan_Block*)ct)->macTag[0]);//debug code
-		if(ret != SGX_SUCCESS) retVal = 1;
+	case TYPE_RING_ORAM:
+	case TYPE_ORAM:
 		break;
 	case TYPE_TREE_ORAM:
-		//decrypt
-		ret = sgx_rijndael128GCM_decrypt(key, ((Encrypted_Oram_Tree_Block*)ct)->ciphertext, blockSize, (unsigned char*)pt,
-				((Encrypted_Oram_Tree_Block*)ct)->iv, 12, NULL, 0, &((Encrypted_Oram_Tree_Block*)ct)->macTag);
-		if(ret != SGX_SUCCESS) retVal = 1;
+		encBlockSize = sizeof(Encrypted_Oram_Tree_Block);
+		for(int i = 0; i < numBlocks; i++){
+			Encrypted_Oram_Tree_Block* enc = (Encrypted_Oram_Tree_Block*)&((uint8_t*)ct)[i*encBlockSize];
+			if(sgx_rijndael128GCM_decrypt(key, enc->ciphertext, blockSize, &((uint8_t*)pt)[i*blockSize],
+					enc->iv, 12, NULL, 0, &enc->macTag) != SGX_SUCCESS) return 1;
+		}
 		printf("I'M ACTUALLY HERE, LOOK AT ME LOOK AT ME LOOK AT ME\n");
-		break;
-	case TYPE_ORAM:
-		//decrypt
-		ret = sgx_rijndael128GCM_decrypt(key, ((Encrypted_Oram_Bucket*)ct)->ciphertext, blockSize, (unsigned char*)pt,
-				((Encrypted_Oram_Bucket*)ct)->iv, 12, NULL, 0, &((Encrypted_Oram_Bucket*)ct)->macTag);
-		//printf("here: %d", ret);
-		if(ret != SGX_SUCCESS) retVal = 1;
-		break;
+		return 0;
 	default:
 		printf("error: trying to decrypt invalid data structure type\n"); return 1;
 		break;
 	}
 
-	//printf("completed a decryption with status %d and retVal %d\n", ret, retVal);
-	return retVal;
+	return gcmDecryptBlocks(key, (uint8_t*)ct, encBlockSize, (uint8_t*)pt, blockSize, blockSize, numBlocks);
+}
+
+int decryptBlock(void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type){
+	return decryptBlocks(ct, pt, 1, key, type);
+}
+
+//bytes the app stores per block of a linear table, laid out like Encrypted_Linear_Scan_Block with a shorter ciphertext
+int linearEncBlockSize(int structureId){
+	return sizeof(Encrypted_Linear_Scan_Block) - (BLOCK_DATA_SIZE - blockDataSizes[structureId]);
+}
+
+//bytes per block the app allocates for a structure
+int storedBlockSize(int structureId){
+	Obliv_Type type = oblivStructureTypes[structureId];
+	if(type == TYPE_ORAM || type == TYPE_TREE_ORAM || type == TYPE_CIRCUIT_ORAM) return sizeof(Encrypted_Oram_Bucket);
+	if(type == TYPE_RING_ORAM) return sizeof(Encrypted_Oram_Block);
+	if(type == TYPE_LINEAR_SCAN) return linearEncBlockSize(structureId);
+	return getEncBlockSize(type);
+}
+
+//blocks the app stores for a structure, a packed linear table has rowsPerBlock rows in each
+int storedBlocks(int structureId){
+	if(rowsPerBlock[structureId] > 1) return oblivStructureSizes[structureId]/rowsPerBlock[structureId];
+	return oblivStructureSizes[structureId];
+}
+
+//encrypts numBlocks blocks of a linear table into ct, linearEncBlockSize bytes apart
+//a narrow table encrypts only actualAddr, revNum and the part of data it uses
+int encryptLinearBlocks(int structureId, void *ct, Real_Linear_Scan_Block *pt, int numBlocks){
+	int dataSize = blockDataSizes[structureId];
+	if(dataSize == BLOCK_DATA_SIZE) return encryptBlocks(structureId, ct, pt, numBlocks, oblivKeys[structureId], TYPE_LINEAR_SCAN);
+	int plainSize = sizeof(Real_Linear_Scan_Block) - (BLOCK_DATA_SIZE - dataSize);
+	int encBlockSize = linearEncBlockSize(structureId);
+	uint8_t* ctBytes = (uint8_t*)ct;
+	if(makeIvs(structureId, &ctBytes[plainSize+16], numBlocks, encBlockSize)) return 1;
+	return gcmEncryptBlocks(oblivKeys[structureId], (uint8_t*)pt, sizeof(Real_Linear_Scan_Block), ctBytes, encBlockSize, plainSize, numBlocks);
+}
+
+//decrypts numBlocks blocks of a linear table, the unused end of a narrow block's data comes back zeroed
+int decryptLinearBlocks(int structureId, void *ct, Real_Linear_Scan_Block *pt, int numBlocks){
+	int dataSize = blockDataSizes[structureId];
+	if(dataSize == BLOCK_DATA_SIZE) return decryptBlocks(ct, pt, numBlocks, oblivKeys[structureId], TYPE_LINEAR_SCAN);
+	int plainSize = sizeof(Real_Linear_Scan_Block) - (BLOCK_DATA_SIZE - dataSize);
+	int encBlockSize = linearEncBlockSize(structureId);
+	if(gcmDecryptBlocks(oblivKeys[structureId], (uint8_t*)ct, encBlockSize, (uint8_t*)pt, sizeof(Real_Linear_Scan_Block), plainSize, numBlocks)) return 1;
+	for(int i = 0; i < numBlocks; i++){
+		memset(&pt[i].data[dataSize], 0, BLOCK_DATA_SIZE - dataSize);
+	}
+	return 0;
 }
 
 int getNextId(){
@@ -745,39 +1394,61 @@ int getNextId(){
 	return ret;
 }
 
-sgx_status_t total_init(){ //get key
+sgx_status_t total_init(){ //get keys
 	obliv_key = (sgx_aes_gcm_128bit_key_t*)malloc(sizeof(sgx_aes_gcm_128bit_key_t));
+	iv_key = (sgx_aes_ctr_128bit_key_t*)malloc(sizeof(sgx_aes_ctr_128bit_key_t));
+	if(sgx_read_rand((unsigned char*) iv_key, sizeof(sgx_aes_ctr_128bit_key_t)) != SGX_SUCCESS) return SGX_ERROR_UNEXPECTED;
 	return sgx_read_rand((unsigned char*) obliv_key, sizeof(sgx_aes_gcm_128bit_key_t));
 }
 
 sgx_status_t init_structure(int size, Obliv_Type type, int* structureId){//size in blocks
+	Table_Options options = {0};
+	return init_structure_with_options(size, type, structureId, options);
+}
+
+sgx_status_t init_structure_with_options(int size, Obliv_Type type, int* structureId, Table_Options options){
 	sgx_status_t ret = SGX_SUCCESS;
     int newId = getNextId();
     if(newId == -1) return SGX_ERROR_UNEXPECTED;
     if(*structureId != -1) newId = *structureId;
     int logicalSize = size;
     logicalSizes[newId] = logicalSize;
-	int encBlockSize = getEncBlockSize(type);
-	int blockSize = getBlockSize(type);
+    oblivStructureTypes[newId] = type;
+    posMapIds[newId] = -1;
+    oblivKeys[newId] = obliv_key;
+    if(initIvCounter(newId)) return SGX_ERROR_UNEXPECTED;
+    //a packed table is sized in rows, which fill whole blocks
+    rowsPerBlock[newId] = (type == TYPE_LINEAR_SCAN && options.rowsPerBlock > 1) ? options.rowsPerBlock : 1;
+    if(size%rowsPerBlock[newId] != 0) return SGX_ERROR_UNEXPECTED;
+    int blocks = size/rowsPerBlock[newId];
     //printf("initcheck1\n");
-	revNum[newId] = (int*)malloc(logicalSize*sizeof(int));
-	memset(&revNum[newId][0], 0, logicalSize*sizeof(int));
+	revNum[newId] = (int*)malloc(blocks*sizeof(int));
+	memset(&revNum[newId][0], 0, blocks*sizeof(int));
 
-    if(type == TYPE_ORAM || type == TYPE_TREE_ORAM) {
-    	blockSize = sizeof(Oram_Bucket);
-    	encBlockSize = sizeof(Encrypted_Oram_Bucket);
+    if(type == TYPE_ORAM || type == TYPE_TREE_ORAM || type == TYPE_RING_ORAM || type == TYPE_CIRCUIT_ORAM) {
     	//size = BUCKET_SIZE*size;
-    	positionMaps[newId] = (unsigned int*)malloc(logicalSize*sizeof(unsigned int));
     	usedBlocks[newId] = (uint8_t*)malloc(logicalSize*sizeof(uint8_t));
     	memset(&usedBlocks[newId][0], 0, logicalSize*sizeof(uint8_t));
-    	//stashes[*structureId] = (Oram_Block*)malloc(BLOCK_DATA_SIZE*(BUCKET_SIZE*((int)(log2(logicalSize+1.1))) + EXTRA_STASH_SPACE));//Zlog_2(N)B+90B
-    	stashes[newId] = new std::list<Oram_Block>();
-    	stashOccs[newId] = 0;
-    	for(int i = 0; i < logicalSize; i++){
-    		//pick a leaf between 0 and logicalSizes[structureId]/2
-    		if(sgx_read_rand((uint8_t*)(&positionMaps[newId][i]), sizeof(unsigned int)) != SGX_SUCCESS) return SGX_ERROR_UNEXPECTED;
-    		positionMaps[newId][i] = positionMaps[newId][i] % (logicalSize/2+1);
-    		//printf("%d %d\n", newId, positionMaps[newId][i]);
+    	if(initFreeList(newId)) return SGX_ERROR_UNEXPECTED;
+    	if(initStash(newId)) return SGX_ERROR_UNEXPECTED;
+    	if(options.recursivePosMap && logicalSize > POSMAP_FLAT_LIMIT && type != TYPE_RING_ORAM){
+    		//the map goes in a smaller oram of packed leaves, which recurses until it fits in the enclave
+    		//claim our id first so the child doesn't get it
+    		oblivStructureSizes[newId] = size;
+    		int childBlocks = (logicalSize+POSMAP_ENTRIES_PER_BLOCK-1)/POSMAP_ENTRIES_PER_BLOCK;
+    		int childId = -1;
+    		if(init_structure_with_options(nextPowerOfTwo(childBlocks+1)-1, TYPE_ORAM, &childId, options) != SGX_SUCCESS) return SGX_ERROR_UNEXPECTED;
+    		posMapIds[newId] = childId;
+    		positionMaps[newId] = NULL;
+    	}
+    	else {
+    		positionMaps[newId] = (unsigned int*)malloc(logicalSize*sizeof(unsigned int));
+    		for(int i = 0; i < logicalSize; i++){
+    			//pick a leaf between 0 and logicalSizes[structureId]/2
+    			if(sgx_read_rand((uint8_t*)(&positionMaps[newId][i]), sizeof(unsigned int)) != SGX_SUCCESS) return SGX_ERROR_UNEXPECTED;
+    			positionMaps[newId][i] = positionMaps[newId][i] % (logicalSize/2+1);
+    			//printf("%d %d\n", newId, positionMaps[newId][i]);
+    		}
     	}
     	//bPlusRoots[structureId] = NULL;
     }
@@ -786,61 +1457,317 @@ sgx_status_t init_structure(int size, Obliv_Type type, int* structureId){//size
 
 	oblivStructureSizes[newId] = size;
 	oblivStructureTypes[newId] = type;
-	int ret2 = 0;
-	ocall_newStructure(newId, type, size);
+	blockDataSizes[newId] = BLOCK_DATA_SIZE;
+	if(type == TYPE_LINEAR_SCAN && options.blockSize > 0 && options.blockSize < BLOCK_DATA_SIZE) blockDataSizes[newId] = options.blockSize;
+	storageTypes[newId] = options.storage;
+	//a ring oram bucket is RING_SLOTS blocks the app stores separately
+	ocall_newStructure(newId, type, (type == TYPE_RING_ORAM) ? blocks*RING_SLOTS : blocks, storedBlockSize(newId), options.storage);
 
 	//printf("initcheck3\n");
 
-	uint8_t* junk = (uint8_t*)malloc(blockSize);
-	uint8_t* encJunk = (uint8_t*)malloc(encBlockSize);
-	memset(junk, '\0', blockSize);
-	if(type == TYPE_LINEAR_SCAN){
-		((Real_Linear_Scan_Block*)junk)->actualAddr = -1;
-	}
-	//memset(junk, 0xff, blockSize);
-	memset(encJunk, 0xff, encBlockSize);
-	if(type != TYPE_LINEAR_UNENCRYPTED){
-		if(type == TYPE_TREE_ORAM) type = TYPE_ORAM;
-		if(type == TYPE_ORAM){
-			memset(&junk[0], 0xff, 4);//set actualAddr to -1
-			memset(&junk[sizeof(Oram_Block)], 0xff, 4);//set actualAddr to -1
-			memset(&junk[2*sizeof(Oram_Block)], 0xff, 4);//set actualAddr to -1
-			memset(&junk[3*sizeof(Oram_Block)], 0xff, 4);//set actualAddr to -1
-			//printf("%d thing %d %d %d %d %d \n", type, ((Oram_Bucket*)junk)->blocks[0].data[0], ((Oram_Bucket*)junk)->blocks[0].actualAddr, ((Oram_Bucket*)junk)->blocks[1].actualAddr, ((Oram_Bucket*)junk)->blocks[2].actualAddr, ((Oram_Bucket*)junk)->blocks[3].actualAddr);
-		}
-		ret2 = encryptBlock(encJunk, junk, obliv_key, type);
-		//debug
-		//ret2 = decryptBlock(encJunk, junk, obliv_key, type);
-		//printf("%d thing %d %d %d %d \n", type, ((Oram_Bucket*)junk)->blocks[0].actualAddr, ((Oram_Bucket*)junk)->blocks[1].actualAddr, ((Oram_Bucket*)junk)->blocks[2].actualAddr, ((Oram_Bucket*)junk)->blocks[3].actualAddr);
-		//end debug
-		if(ret2) return SGX_ERROR_UNEXPECTED;
-	}
+	if(initScratchArena(newId, type)) return SGX_ERROR_UNEXPECTED;
+	if(type == TYPE_RING_ORAM && initRingOram(newId)) return SGX_ERROR_UNEXPECTED;
 
 	//printf("initcheck4\n");
 	//printf("enclave: initializing %d blocks\n", size);
-	//write junk to every block of data structure
-	//printf("block size to write: %d\n", encBlockSize);
-	for(int i = 0; i < size; i++)
-	{
-			//printf("about to write to encrypted block %d of size %d... ", i, encBlockSize);
-			if(!encJunk) printf("buffer is null pointer!");
-			ocall_write_block(newId, i, encBlockSize, encJunk);
-			//printf("written\n");
+	//nothing is written until a block is first used, except where the app's copy gets read some other way
+	if(!lazyInit || type == TYPE_LINEAR_UNENCRYPTED || MIXED_USE_MODE){
+		if(type == TYPE_RING_ORAM){
+			if(writeEmptyRingBuckets(newId, 0, blocks)) return SGX_ERROR_UNEXPECTED;
+		}
+		else if(writeEmptyBlocks(newId, 0, blocks)) return SGX_ERROR_UNEXPECTED;
 	}
+	else{
+		if(initWrittenBlocks(newId, blocks)) return SGX_ERROR_UNEXPECTED;
+		if(refillJunkPool(newId, JUNK_POOL_SIZE)) return SGX_ERROR_UNEXPECTED;
+	}
+	if((type == TYPE_ORAM || type == TYPE_TREE_ORAM || type == TYPE_CIRCUIT_ORAM) && initTreeTop(newId)) return SGX_ERROR_UNEXPECTED;
 	//printf("enclave: done initializing structure\n");
 	*structureId = newId;
 	return ret;
+}
 
-	free(junk);
-	free(encJunk);
+//makes a linear table of size rows whose columns are stored in numGroups structures of their own, see opColumnGroupRows
+//group g is bytes [groupStarts[g], groupStarts[g+1]) of each row, packed as many rows to a block as fit
+sgx_status_t init_column_groups(int size, int* structureId, int numGroups, int* groupStarts, Table_Options options){
+	int newId = getNextId();
+	if(newId == -1 || numGroups <= 0 || numGroups > MAX_COLS) return SGX_ERROR_UNEXPECTED;
+	if(*structureId != -1) newId = *structureId;
+	int packing[MAX_COLS];
+	int maxPacking = 1;
+	for(int g = 0; g < numGroups; g++){
+		int width = groupStarts[g+1]-groupStarts[g];
+		if(width <= 0 || groupStarts[g+1] > BLOCK_DATA_SIZE) return SGX_ERROR_UNEXPECTED;
+		packing[g] = 1;
+		while(2*packing[g] <= SCAN_BATCH_SIZE && 2*packing[g]*width <= BLOCK_DATA_SIZE) packing[g] *= 2;
+		if(packing[g] > maxPacking) maxPacking = packing[g];
+	}
+	//every group's packing divides the size, so they all grow in step
+	size = (size+maxPacking-1)/maxPacking*maxPacking;
+	//claim our id first so the groups don't get it, the table itself has nothing in the app's storage
+	oblivStructureSizes[newId] = size;
+	oblivStructureTypes[newId] = TYPE_LINEAR_SCAN;
+	logicalSizes[newId] = size;
+	posMapIds[newId] = -1;
+	oblivKeys[newId] = obliv_key;
+	rowsPerBlock[newId] = 1;
+	blockDataSizes[newId] = BLOCK_DATA_SIZE;
+	numColumnGroups[newId] = numGroups;
+	scanGroupMasks[newId] = -1;
+	if(initScratchArena(newId, TYPE_LINEAR_SCAN)) return SGX_ERROR_UNEXPECTED;
+	for(int g = 0; g < numGroups; g++){
+		Table_Options groupOptions = {0};
+		groupOptions.storage = options.storage;
+		groupOptions.blockSize = packing[g]*(groupStarts[g+1]-groupStarts[g]);
+		groupOptions.rowsPerBlock = packing[g];
+		columnGroupIds[newId][g] = -1;
+		if(init_structure_with_options(size, TYPE_LINEAR_SCAN, &columnGroupIds[newId][g], groupOptions) != SGX_SUCCESS) return SGX_ERROR_UNEXPECTED;
+		columnGroupStarts[newId][g] = groupStarts[g];
+	}
+	columnGroupStarts[newId][numGroups] = groupStarts[numGroups];
+	*structureId = newId;
+	return SGX_SUCCESS;
+}
+
+//which groups reads of a split table fill in from now on, -1 for every group
+int setScanGroups(int structureId, int groupMask){
+	scanGroupMasks[structureId] = groupMask;
+	return 0;
+}
+
+//group of a split table holding byte offset of each row
+int columnGroupOf(int structureId, int offset){
+	for(int g = 0; g < numColumnGroups[structureId]; g++){
+		if(offset < columnGroupStarts[structureId][g+1]) return g;
+	}
+	return -1;
+}
+
+//writes empty blocks (empty buckets for orams) over blocks [start, end) of a new or grown structure
+int writeEmptyBlocks(int structureId, int start, int end){
+	Obliv_Type type = oblivStructureTypes[structureId];
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	int encBlockSize = storedBlockSize(structureId);
+	//a batch of junk blocks, each encrypted under its own iv, written out repeatedly
+	uint8_t* junkBatch = NULL;
+	int batchBlocks = 0;
+	if(type == TYPE_LINEAR_SCAN){
+		memset(arena->real, '\0', SCAN_BATCH_SIZE*sizeof(Real_Linear_Scan_Block));
+		for(int i = 0; i < SCAN_BATCH_SIZE; i++){
+			arena->real[i].actualAddr = -1;
+		}
+		if(encryptLinearBlocks(structureId, arena->encBlocks, arena->real, SCAN_BATCH_SIZE)) return 1;
+		junkBatch = (uint8_t*)arena->encBlocks;
+		batchBlocks = SCAN_BATCH_SIZE;
+	}
+	else if(type == TYPE_LINEAR_UNENCRYPTED){
+		memset(arena->encBlocks, 0xff, SCAN_BATCH_SIZE*encBlockSize);
+		junkBatch = (uint8_t*)arena->encBlocks;
+		batchBlocks = SCAN_BATCH_SIZE;
+	}
+	else {
+		if(refillJunkPool(structureId, JUNK_POOL_SIZE)) return 1;
+		junkBatch = (uint8_t*)arena->junkPool;
+		batchBlocks = JUNK_POOL_SIZE;
+	}
+	//printf("block size to write: %d\n", encBlockSize);
+	for(int i = start; i < end; i += batchBlocks)
+	{
+			int numBlocks = (end - i < batchBlocks) ? end - i : batchBlocks;
+			ocall_write_blocks(structureId, i, numBlocks, encBlockSize, junkBatch);
+			markWritten(structureId, i, numBlocks);
+	}
+	if(type == TYPE_ORAM || type == TYPE_TREE_ORAM || type == TYPE_CIRCUIT_ORAM){
+		//the ring was just spent on the tree, start accesses with fresh ones
+		arena->junkReady = 0;
+		if(refillJunkPool(structureId, JUNK_POOL_SIZE)) return 1;
+	}
+	return 0;
+}
+
+//doubles a linear structure, the new half starts out as empty blocks and nothing already stored moves
+int growLinear(int structureId){
+	if(numColumnGroups[structureId] > 0){
+		for(int g = 0; g < numColumnGroups[structureId]; g++){
+			if(growLinear(columnGroupIds[structureId][g])) return 1;
+		}
+		oblivStructureSizes[structureId] *= 2;
+		logicalSizes[structureId] *= 2;
+		return 0;
+	}
+	int oldSize = oblivStructureSizes[structureId];
+	int newSize = 2*oldSize;
+	int oldBlocks = storedBlocks(structureId);
+	int newBlocks = 2*oldBlocks;
+	int* newRevNum = (int*)realloc(revNum[structureId], newBlocks*sizeof(int));
+	if(newRevNum == NULL) return 1;
+	revNum[structureId] = newRevNum;
+	memset(&revNum[structureId][oldBlocks], 0, (newBlocks-oldBlocks)*sizeof(int));
+	int ret = 0;
+	ocall_resizeStructure(&ret, structureId, newBlocks);
+	if(ret) return 1;
+	oblivStructureSizes[structureId] = newSize;
+	logicalSizes[structureId] = newSize;
+	if(writtenBlocks[structureId] != NULL) return growWrittenBlocks(structureId, oldBlocks, newBlocks);
+	return writeEmptyBlocks(structureId, oldBlocks, newBlocks);
+}
+
+//gives back the blocks of a linear structure past its first newSize rows, rounded up to whole blocks
+//(to every group's blocks for a split table). only called once the rows past newSize are all empty
+int shrinkLinear(int structureId, int newSize){
+	if(numColumnGroups[structureId] > 0){
+		int packing = 1;
+		for(int g = 0; g < numColumnGroups[structureId]; g++){
+			if(rowsPerBlock[columnGroupIds[structureId][g]] > packing) packing = rowsPerBlock[columnGroupIds[structureId][g]];
+		}
+		newSize = (newSize+packing-1)/packing*packing;
+		if(newSize == 0) newSize = packing;
+		for(int g = 0; g < numColumnGroups[structureId]; g++){
+			if(shrinkLinear(columnGroupIds[structureId][g], newSize)) return 1;
+		}
+		oblivStructureSizes[structureId] = newSize;
+		logicalSizes[structureId] = newSize;
+		return 0;
+	}
+	int packing = rowsPerBlock[structureId];
+	newSize = (newSize+packing-1)/packing*packing;
+	if(newSize == 0) newSize = packing;
+	if(newSize >= oblivStructureSizes[structureId]) return 0;
+	int newBlocks = newSize/packing;
+	int ret = 0;
+	ocall_resizeStructure(&ret, structureId, newBlocks);
+	if(ret) return 1;
+	int* newRevNum = (int*)realloc(revNum[structureId], newBlocks*sizeof(int));
+	if(newRevNum != NULL) revNum[structureId] = newRevNum;
+	oblivStructureSizes[structureId] = newSize;
+	logicalSizes[structureId] = newSize;
+	if(writtenBlocks[structureId] != NULL){
+		//clear the bits past the end so a later growth finds those blocks unwritten
+		for(int i = newBlocks; i < (newBlocks+7)/8*8; i++) writtenBlocks[structureId][i/8] &= (uint8_t)~(1 << (i%8));
+		uint8_t* shrunk = (uint8_t*)realloc(writtenBlocks[structureId], (newBlocks+7)/8);
+		if(shrunk != NULL) writtenBlocks[structureId] = shrunk;
+	}
+	return 0;
+}
+
+//adds a level under the leaves of an oram. buckets keep their numbers (node n has children 2n+1 and 2n+2),
+//so old leaf x sits right above new leaves 2x and 2x+1 and a block mapped to x can stay where it is
+//once it is remapped to one of the two at random. every old bucket that has been written is rewritten
+//with the new leaves, the new level starts out as empty buckets
+int growOram(int structureId){
+	if(oblivStructureTypes[structureId] == TYPE_RING_ORAM){
+		printf("growing ring orams is not supported\n");
+		return 1;
+	}
+	if(posMapIds[structureId] != -1){
+		printf("growing orams with recursive position maps is not supported\n");
+		return 1;
+	}
+	Obliv_Type type = oblivStructureTypes[structureId];
+	int oldSize = oblivStructureSizes[structureId];
+	int newSize = 2*oldSize+1;
+	//the buckets are rewritten from the app's copy below, and the new tree gets a cache of its own
+	if(flushTreeTop(structureId)) return 1;
+	freeTreeTop(structureId);
+	unsigned int* newPositionMap = (unsigned int*)realloc(positionMaps[structureId], newSize*sizeof(unsigned int));
+	if(newPositionMap == NULL) return 1;
+	positionMaps[structureId] = newPositionMap;
+	uint8_t* newUsedBlocks = (uint8_t*)realloc(usedBlocks[structureId], newSize*sizeof(uint8_t));
+	if(newUsedBlocks == NULL) return 1;
+	usedBlocks[structureId] = newUsedBlocks;
+	int* newRevNum = (int*)realloc(revNum[structureId], newSize*sizeof(int));
+	if(newRevNum == NULL) return 1;
+	revNum[structureId] = newRevNum;
+	int* newFreeList = (int*)realloc(freeLists[structureId], newSize*sizeof(int));
+	if(newFreeList == NULL) return 1;
+	freeLists[structureId] = newFreeList;
+	memset(&usedBlocks[structureId][oldSize], 0, newSize-oldSize);
+	memset(&revNum[structureId][oldSize], 0, (newSize-oldSize)*sizeof(int));
+	if(writtenBlocks[structureId] != NULL && growWrittenBlocks(structureId, oldSize, newSize)) return 1;
+
+	//remap every block, new blocks get a leaf like init_structure gives them
+	uint8_t bits[SCAN_BATCH_SIZE];
+	for(int i = 0; i < oldSize; i++){
+		if(i % SCAN_BATCH_SIZE == 0 && sgx_read_rand(bits, SCAN_BATCH_SIZE) != SGX_SUCCESS) return 1;
+		positionMaps[structureId][i] = 2*positionMaps[structureId][i] + (bits[i%SCAN_BATCH_SIZE] & 1);
+	}
+	for(int i = oldSize; i < newSize; i++){
+		if(sgx_read_rand((uint8_t*)(&positionMaps[structureId][i]), sizeof(unsigned int)) != SGX_SUCCESS) return 1;
+		positionMaps[structureId][i] = positionMaps[structureId][i] % (newSize/2+1);
+	}
+
+	//the stash and scratch space are sized by the height of the tree, remake them and put the stash back
+	Oram_Stash* stash = &stashes[structureId];
+	int numStashed = 0;
+	Oram_Block* stashed = (Oram_Block*)malloc((stashOccs[structureId]+1)*sizeof(Oram_Block));
+	if(stashed == NULL) return 1;
+	for(int i = 0; i < stash->capacity; i++){
+		if(stashSlotUsed(structureId, i)) memcpy(&stashed[numStashed++], &stash->blocks[i], sizeof(Oram_Block));
+	}
+	freeStash(structureId);
+	freeScratchArena(structureId);
+	int ret = 0;
+	ocall_resizeStructure(&ret, structureId, newSize);
+	oblivStructureSizes[structureId] = newSize;
+	logicalSizes[structureId] = newSize;
+	if(ret == 0 && (initStash(structureId) || initScratchArena(structureId, type))) ret = 1;
+	for(int i = 0; i < numStashed && ret == 0; i++){
+		if(stashInsert(structureId, &stashed[i], positionMaps[structureId][stashed[i].actualAddr]) == -1) ret = 1;
+	}
+	free(stashed);
+	if(ret) return 1;
+
+	Oram_Bucket* buckets = (Oram_Bucket*)malloc(SCAN_BATCH_SIZE*sizeof(Oram_Bucket));
+	Encrypted_Oram_Bucket* encBuckets = (Encrypted_Oram_Bucket*)malloc(SCAN_BATCH_SIZE*sizeof(Encrypted_Oram_Bucket));
+	if(buckets == NULL || encBuckets == NULL) ret = 1;
+	for(int i = 0; i < oldSize && ret == 0; i += SCAN_BATCH_SIZE){
+		int n = (oldSize-i < SCAN_BATCH_SIZE) ? oldSize-i : SCAN_BATCH_SIZE;
+		int written = countWritten(structureId, i, n);
+		if(written == 0) continue;
+		ocall_read_blocks(structureId, i, n, sizeof(Encrypted_Oram_Bucket), encBuckets);
+		if(written == n) ret = decryptBlocks(encBuckets, buckets, n, oblivKeys[structureId], TYPE_ORAM);
+		for(int j = 0; j < n && written < n && ret == 0; j++){
+			if(blockWritten(structureId, i+j)) ret = decryptBlock(&encBuckets[j], &buckets[j], oblivKeys[structureId], TYPE_ORAM);
+			else memcpy(&buckets[j], scratchArenas[structureId].junk, sizeof(Oram_Bucket));
+		}
+		if(ret){
+			printf("AUTHENTICITY FAILURE: oram bucket did not decrypt while growing\n");
+			break;
+		}
+		for(int j = 0; j < n; j++){
+			for(int k = 0; k < BUCKET_SIZE; k++){
+				int addr = buckets[j].blocks[k].actualAddr;
+				if(addr != -1) buckets[j].leaves[k] = positionMaps[structureId][addr];
+			}
+		}
+		if(encryptBlocks(structureId, encBuckets, buckets, n, oblivKeys[structureId], TYPE_ORAM)) ret = 1;
+		else ocall_write_blocks(structureId, i, n, sizeof(Encrypted_Oram_Bucket), encBuckets);
+		markWritten(structureId, i, n);
+	}
+	free(buckets);
+	free(encBuckets);
+	if(ret == 0 && writtenBlocks[structureId] == NULL) ret = writeEmptyBlocks(structureId, oldSize, newSize);
+	if(ret == 0) ret = initTreeTop(structureId);
+	rebuildFreeList(structureId);
+	return ret;
 }
 
 sgx_status_t free_oram(int structureId){
 	sgx_status_t ret = SGX_SUCCESS;
 	free(positionMaps[structureId]);
+	positionMaps[structureId] = NULL;
+	if(posMapIds[structureId] != -1){
+		free_structure(posMapIds[structureId]);
+		posMapIds[structureId] = -1;
+	}
 	free(usedBlocks[structureId]);
-	//free(stashes[structureId]);
-	delete(stashes[structureId]);
+	free(freeLists[structureId]);
+	freeLists[structureId] = NULL;
+	freeListSizes[structureId] = 0;
+	freeStash(structureId);
+	freeTreeTop(structureId);
+	if(oblivStructureTypes[structureId] == TYPE_RING_ORAM) freeRingOram(structureId);
+	circuitEvictCounts[structureId] = 0;
 	if(bPlusRoots[structureId] != NULL){
 		free(bPlusRoots[structureId]);
 		bPlusRoots[structureId] = NULL;
@@ -851,10 +1778,22 @@ sgx_status_t free_oram(int structureId){
 //clean up a structure
 sgx_status_t free_structure(int structureId) {
 	sgx_status_t ret = SGX_SUCCESS;
-	if(oblivStructureTypes[structureId] == TYPE_ORAM || oblivStructureTypes[structureId] == TYPE_TREE_ORAM) {
+	if(oblivStructureTypes[structureId] == TYPE_ORAM || oblivStructureTypes[structureId] == TYPE_TREE_ORAM || oblivStructureTypes[structureId] == TYPE_RING_ORAM || oblivStructureTypes[structureId] == TYPE_CIRCUIT_ORAM) {
 		free_oram(structureId);
 	}
+	for(int g = 0; g < numColumnGroups[structureId]; g++){
+		free_structure(columnGroupIds[structureId][g]);
+	}
+	numColumnGroups[structureId] = 0;
 	free(revNum[structureId]);
+	revNum[structureId] = NULL;
+	free(writtenBlocks[structureId]);
+	writtenBlocks[structureId] = NULL;
+	if(oblivKeys[structureId] != obliv_key) free(oblivKeys[structureId]);
+	oblivKeys[structureId] = NULL;
+	freeScratchArena(structureId);
+	rowsPerBlock[structureId] = 0;
+	storageTypes[structureId] = STORAGE_MEMORY;
 	stashOccs[structureId] = 0;
 	logicalSizes[structureId] = 0;
 	oblivStructureSizes[structureId] = 0; //most important since this is what we use to check if a slot is open
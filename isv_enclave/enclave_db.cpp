@@ -8,7 +8,7 @@
 //specific to database application, hidden from app
 Schema schemas[NUM_STRUCTURES] = {0};
 char* tableNames[NUM_STRUCTURES] = {0};
-int rowsPerBlock[NUM_STRUCTURES] = {0}; //let's make this always 1; helpful for security and convenience; set block size appropriately for testing
+int rowsPerBlock[NUM_STRUCTURES] = {0}; //1 unless a linear table was created with Table_Options.rowsPerBlock, set in init_structure
 int numRows[NUM_STRUCTURES] = {0};
 int lastInserted[NUM_STRUCTURES] = {0};
 
@@ -89,7 +89,117 @@ int rowMatchesCondition(Condition c, uint8_t* row, Schema s){
 }
 
 
+//scan kernels for runScan, each one covers blocks [part->start, part->end) of job->structureId
+//every block in the range is read (and written, for deletes) no matter what it holds
+
+//first pass of a linear select: how many rows match and where the first and last of them are
+void selectCountScan(Scan_Job* job, Scan_Partition* part){
+	int structureId = job->structureId;
+	Scan_Iterator scan;
+	openScan(&scan, structureId, part->start, part->end);
+	for(int i = part->start; i < part->end; i += SCAN_BATCH_SIZE){
+		int n = scanNextBatchWith(&scan, (Linear_Scan_Block*)part->batch, part->real, part->encBlocks);
+		if(n == -1) {part->ret = 1; break;}
+		for(int j = 0; j < n; j++){
+			uint8_t* row = &part->batch[j*BLOCK_DATA_SIZE];
+			if(rowMatchesCondition(*job->c, row, schemas[structureId]) && row[0] != '\0'){
+				if(part->firstMatch == -1) part->firstMatch = i+j;
+				part->lastMatch = i+j;
+				part->count++;
+			}
+		}
+	}
+	closeScan(&scan);
+}
+
+//aggregate with no group by, partitions are combined in order by selectRows
+void aggregateScan(Scan_Job* job, Scan_Partition* part){
+	int structureId = job->structureId;
+	Scan_Iterator scan;
+	openScan(&scan, structureId, part->start, part->end);
+	for(int i = part->start; i < part->end; i += SCAN_BATCH_SIZE){
+		int n = scanNextBatchWith(&scan, (Linear_Scan_Block*)part->batch, part->real, part->encBlocks);
+		if(n == -1) {part->ret = 1; break;}
+		for(int j = 0; j < n; j++){
+			uint8_t* row = &part->batch[j*BLOCK_DATA_SIZE];
+			int match = rowMatchesCondition(*job->c, row, schemas[structureId]) && row[0] != '\0';
+			int val = (int)row[job->colOffset];
+			part->count += match;
+			switch(job->aggregate){
+			case 1:
+			case 4:
+				if(match) part->stat += val;
+				break;
+			case 2:
+				if(match && (val < part->stat || part->statSet == 0)){
+					part->stat = val;
+					part->statRow = i+j;
+				}
+				break;
+			case 3:
+				if(match && (val > part->stat || part->statSet == 0)){
+					part->stat = val;
+					part->statRow = i+j;
+				}
+				break;
+			}
+			part->statSet |= match;
+		}
+	}
+	closeScan(&scan);
+}
+
+//the linear dml passes: every block is read, changed by job->rewrite and written back, see rewriteBlocks
+void rewriteScan(Scan_Job* job, Scan_Partition* part){
+	if(rewriteBlocks(job, part)) part->ret = 1;
+}
+
+//clears matching rows
+void deleteRewrite(Scan_Job* job, Scan_Partition* part, uint8_t* rows, int firstRow, int numRows){
+	for(int j = 0; j < numRows; j++){
+		uint8_t* slot = &rows[j*BLOCK_DATA_SIZE];
+		int match = rowMatchesCondition(*job->c, slot, schemas[job->structureId]) && slot[0] != '\0';
+		if(match){
+			memset(slot, '\0', BLOCK_DATA_SIZE);
+		}
+		part->count += match;
+	}
+}
+
+//sets the chosen column of matching rows
+void updateRewrite(Scan_Job* job, Scan_Partition* part, uint8_t* rows, int firstRow, int numRows){
+	uint8_t dummyRow[BLOCK_DATA_SIZE];
+	for(int j = 0; j < numRows; j++){
+		uint8_t* slot = &rows[j*BLOCK_DATA_SIZE];
+		//update if it matches the condition, write back otherwise
+		if(rowMatchesCondition(*job->c, slot, schemas[job->structureId]) && slot[0] != '\0'){
+			//make changes
+			memcpy(&slot[job->colOffset], job->value, job->valueSize);
+		}
+		else{
+			//make dummy changes
+			memcpy(&dummyRow[job->colOffset], job->value, job->valueSize);
+		}
+	}
+}
+
+//decrypts the range into job->blocks so one thread can go through it in order afterwards
+void readScan(Scan_Job* job, Scan_Partition* part){
+	Scan_Iterator scan;
+	openScan(&scan, job->structureId, part->start, part->end);
+	for(int i = part->start; i < part->end; i += SCAN_BATCH_SIZE){
+		Linear_Scan_Block* dest = (Linear_Scan_Block*)&job->blocks[(i-job->startIndex)*BLOCK_DATA_SIZE];
+		if(scanNextBatchWith(&scan, dest, part->real, part->encBlocks) == -1) {part->ret = 1; break;}
+	}
+	closeScan(&scan);
+}
+
 int createTable(Schema *schema, char* tableName, int nameLen, Obliv_Type type, int numberOfRows, int* structureId){
+	Table_Options options = {0};
+	return createTableWithOptions(schema, tableName, nameLen, type, numberOfRows, structureId, options);
+}
+
+int createTableWithOptions(Schema *schema, char* tableName, int nameLen, Obliv_Type type, int numberOfRows, int* structureId, Table_Options options){
 	//structureId should be -1 unless we want to force a particular structure for testing
 	sgx_status_t retVal = SGX_SUCCESS;
 
@@ -98,22 +208,40 @@ int createTable(Schema *schema, char* tableName, int nameLen, Obliv_Type type, i
 	int rowSize = getRowSize(schema);
 	//printf("row size: %d\n", rowSize);
 	if(rowSize <= 0) return rowSize;
-	if(BLOCK_DATA_SIZE/rowSize == 0) {//can't fit a row in a block of the data structure!
+	int blockSize = (options.blockSize > 0 && type == TYPE_LINEAR_SCAN) ? options.blockSize : BLOCK_DATA_SIZE;
+	if(blockSize > BLOCK_DATA_SIZE || blockSize/rowSize == 0) {//can't fit a row in a block of the data structure!
 		return 4;
 	}
+	//column groups are runs of consecutive fields numbered up from 0, so any split shows in the last field's group
+	int numGroups = 0;
+	int groupStarts[MAX_COLS+1];
+	if(type == TYPE_LINEAR_SCAN && schema->numFields > 0 && options.columnGroups[schema->numFields-1] > 0){
+		for(int i = 0; i < schema->numFields; i++){
+			int g = options.columnGroups[i];
+			if(g != numGroups-1 && g != numGroups) return 1;
+			if(g == numGroups) groupStarts[numGroups++] = schema->fieldOffsets[i];
+		}
+		groupStarts[numGroups] = rowSize;
+	}
+	//packing is a power of two no bigger than a batch, so scan threads split tables on block boundaries
+	int packing = 1;
+	while(type == TYPE_LINEAR_SCAN && 2*packing <= options.rowsPerBlock && 2*packing <= SCAN_BATCH_SIZE && 2*packing*rowSize <= blockSize) packing *= 2;
+	options.rowsPerBlock = packing;
 	if(PADDING > 0){
 		numberOfRows = PADDING;
 	}
 
-	if(type == TYPE_TREE_ORAM){
+	if(type == TYPE_TREE_ORAM || type == TYPE_RING_ORAM || type == TYPE_CIRCUIT_ORAM){
 		//this should be good assuming MAX_ORDER is big enough
 		//if max order gets too small, replace 1.1 with something bigger
 		numberOfRows = numberOfRows *1.1 -1; //need a larger memory, to store all the tree
 	}
-	if(type == TYPE_TREE_ORAM || type == TYPE_ORAM) numberOfRows = nextPowerOfTwo(numberOfRows+1) - 1; //get rid of the if statement to pad all tables to next power of 2 size
+	if(type == TYPE_TREE_ORAM || type == TYPE_ORAM || type == TYPE_RING_ORAM || type == TYPE_CIRCUIT_ORAM) numberOfRows = nextPowerOfTwo(numberOfRows+1) - 1; //get rid of the if statement to pad all tables to next power of 2 size
 	numberOfRows += (numberOfRows == 0);
+	numberOfRows = (numberOfRows+packing-1)/packing*packing;
 	int initialSize = numberOfRows;
-	retVal = init_structure(initialSize, type, structureId);
+	if(numGroups > 0) retVal = init_column_groups(initialSize, structureId, numGroups, groupStarts, options);
+	else retVal = init_structure_with_options(initialSize, type, structureId, options);
 	if(retVal != SGX_SUCCESS) return 5;
 
 	//size & type are set in init_structure, but we need to initiate the rest
@@ -121,9 +249,8 @@ int createTable(Schema *schema, char* tableName, int nameLen, Obliv_Type type, i
 	strncpy(tableNames[*structureId], tableName, nameLen+1);
 	memcpy(&schemas[*structureId], schema, sizeof(Schema));
 
-	//rowsPerBlock[*structureId] = BLOCK_DATA_SIZE/rowSize;
-	rowsPerBlock[*structureId] = 1; //fixed at 1 for now, see declaration
 	numRows[*structureId] = 0;
+	lastInserted[*structureId] = 0;
 
 	return 0;
 }
@@ -133,11 +260,63 @@ int deleteTable(char *tableName) {
 	free_structure(structureId);
 	free(tableNames[structureId]);
 	numRows[structureId] = 0;
+	lastInserted[structureId] = 0;
 	schemas[structureId] = {0};
 }
 
-int growStructure(int structureId){//TODO: make table double in size if the allocated space is full
-	return 1; //likely to remain unimplemented
+//doubles a linear table or adds a level to an oram once it is full, so tables can be created small
+//each growth writes every block of the new size once, which works out to a constant number of block writes per insert
+int growStructure(int structureId){
+	int oldSize = oblivStructureSizes[structureId];
+	//blocks written out: the new ones unless they are left for lazy initialization, and every written oram bucket
+	Obliv_Type type = oblivStructureTypes[structureId];
+	int oram = (type == TYPE_TREE_ORAM || type == TYPE_ORAM || type == TYPE_CIRCUIT_ORAM);
+	int blocksWritten = (writtenBlocks[structureId] == NULL) ? storedBlocks(structureId) + oram : 0;
+	if(oram) blocksWritten += countWritten(structureId, 0, oldSize);
+	int ret = 1;
+	switch(oblivStructureTypes[structureId]){
+	case TYPE_LINEAR_SCAN:
+	case TYPE_LINEAR_UNENCRYPTED:
+		ret = growLinear(structureId);
+		break;
+	case TYPE_ORAM:
+	case TYPE_TREE_ORAM:
+	case TYPE_CIRCUIT_ORAM:
+		ret = growOram(structureId);
+		break;
+	case TYPE_RING_ORAM:
+		printf("ring oram tables have a fixed size and can't grow\n");
+		break;
+	}
+	if(ret){
+		printf("could not grow structure %d\n", structureId);
+		return 1;
+	}
+	printf("grew structure %d from %d to %d blocks, %d blocks written\n", structureId, oldSize, oblivStructureSizes[structureId], blocksWritten);
+	return 0;
+}
+
+//vacuum for a linear table after deletes: moves its rows to the front with compactLinearRows and hands the
+//space past them back to the app, keeping a quarter more slots than rows for appends.
+//the compaction passes encrypt what they write, so unencrypted tables are left alone
+int compactTable(char* tableName){
+	int structureId = getTableId(tableName);
+	if(structureId == -1) return 1;
+	if(oblivStructureTypes[structureId] != TYPE_LINEAR_SCAN){
+		printf("only encrypted linear tables can be compacted\n");
+		return 1;
+	}
+	int oldSize = oblivStructureSizes[structureId];
+	int count = compactLinearRows(structureId);
+	if(count == -1) return 1;
+	lastInserted[structureId] = count;
+	numRows[structureId] = count;
+	if(shrinkLinear(structureId, count + count/4)){
+		printf("could not shrink structure %d\n", structureId);
+		return 1;
+	}
+	printf("compacted structure %d from %d to %d blocks, %d rows\n", structureId, oldSize, oblivStructureSizes[structureId], count);
+	return 0;
 }
 
 int getTableId(char *tableName) {
@@ -171,12 +350,15 @@ int insertIndexRowFast(char* tableName, uint8_t* row, int key) {//trust that the
 	int structureId = getTableId(tableName);
 	int done = 0;
 	int dummyDone = 0;
-	if(numRows[structureId] == oblivStructureSizes[structureId]){
-		growStructure(structureId);//not implemented
-	}
+	//newBlock grows the tree when it runs out of blocks
 	uint8_t* tempRow = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 
-	record *temp = make_record(structureId, row);
+	record *temp = indexHasRoom(structureId) ? make_record(structureId, row) : NULL;
+	if(temp == NULL){
+		printf("index table %d is full\n", structureId);
+		free(tempRow);
+		return 1;
+	}
 	//printf("before insert %d", key);
 	bPlusRoots[structureId] = insert(structureId, bPlusRoots[structureId], key, temp);
 	//printf("after insert\n");
@@ -188,18 +370,37 @@ int insertIndexRowFast(char* tableName, uint8_t* row, int key) {//trust that the
 
 	numRows[structureId]++;
 	free(tempRow);
+	return 0;
+}
+
+//linear inserts append at lastInserted, so the slot written only shows how many inserts came since the last compaction
+//when the end is reached the table is compacted, and grown if that leaves less than a quarter of it free
+int nextAppendSlot(int structureId){
+	int size = oblivStructureSizes[structureId];
+	//the compaction passes encrypt what they write, so unencrypted tables only append and grow
+	if(oblivStructureTypes[structureId] == TYPE_LINEAR_UNENCRYPTED){
+		if(lastInserted[structureId] >= size && growStructure(structureId)) return -1;
+		return lastInserted[structureId]++;
+	}
+	//a cursor below the row count was never kept for this table (loaded, or filled by a query)
+	if(lastInserted[structureId] >= size || lastInserted[structureId] < numRows[structureId]){
+		int count = compactLinearRows(structureId);
+		if(count == -1) return -1;
+		lastInserted[structureId] = count;
+		if(count >= size - size/4 && growStructure(structureId)) return -1;
+	}
+	return lastInserted[structureId]++;
 }
 
 int insertLinRowFast(char* tableName, uint8_t* row){
 	int structureId = getTableId(tableName);
-	int done = 0;
-	int dummyDone = 0;
-	if(numRows[structureId] == oblivStructureSizes[structureId]){
-		growStructure(structureId);//not implemented
+	int insertId = nextAppendSlot(structureId);
+	if(insertId == -1) return 1;
+	if(oblivStructureTypes[structureId] == TYPE_LINEAR_UNENCRYPTED){
+		if(opLinearScanUnencryptedBlock(structureId, insertId, (Linear_Scan_Block*)row, 1)) return 1;
 	}
-	int insertId = lastInserted[structureId];	
-	opOneLinearScanBlock(structureId, insertId, (Linear_Scan_Block*)row, 1);
-	lastInserted[structureId]++;
+	else if(opOneLinearScanBlock(structureId, insertId, (Linear_Scan_Block*)row, 1)) return 1;
+	return 0;
 }
 
 
@@ -207,27 +408,23 @@ int insertRow(char* tableName, uint8_t* row, int key) {//trust that the row is g
 	int structureId = getTableId(tableName);
 	int done = 0;
 	int dummyDone = 0;
-	if(numRows[structureId] == oblivStructureSizes[structureId]){
-		growStructure(structureId);//not implemented
-	}
 	uint8_t* tempRow = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 
 	switch(oblivStructureTypes[structureId]){
-	case TYPE_LINEAR_SCAN:
-		for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-			opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 0);
-			if(tempRow[0] == '\0' && done == 0){
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 1);
-				done++;
-			}
-			else{
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 1);
-				dummyDone++;
-			}
-		}
-		break;
+	case TYPE_LINEAR_SCAN:{
+		//freed slots are picked up by the compaction in nextAppendSlot rather than searched for on every insert
+		int insertId = nextAppendSlot(structureId);
+		if(insertId == -1 || opOneLinearScanBlock(structureId, insertId, (Linear_Scan_Block*)row, 1)) {free(tempRow); return 1;}
+		break;}
+	case TYPE_RING_ORAM:
+	case TYPE_CIRCUIT_ORAM:
 	case TYPE_TREE_ORAM:
-		record *temp = make_record(structureId, row);
+		record *temp = indexHasRoom(structureId) ? make_record(structureId, row) : NULL;
+		if(temp == NULL){
+			printf("index table %d is full\n", structureId);
+			free(tempRow);
+			return 1;
+		}
 		//printf("before insert %d", key);
 		currentPad = 0;
 		bPlusRoots[structureId] = insert(structureId, bPlusRoots[structureId], key, temp);
@@ -245,6 +442,7 @@ int insertRow(char* tableName, uint8_t* row, int key) {//trust that the row is g
 	}
 	numRows[structureId]++;
 	free(tempRow);
+	return 0;
 }
 
 int deleteRow(char* tableName, int key) {
@@ -279,21 +477,25 @@ int deleteRows(char* tableName, Condition c, int startKey, int endKey) {
 	memset(dummyRow, '\0', BLOCK_DATA_SIZE);
 
 	switch(oblivStructureTypes[structureId]){
-	case TYPE_LINEAR_SCAN:
-		for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-			opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 0);
-			//delete if it matches the condition, write back otherwise
-			if(rowMatchesCondition(c, tempRow, schemas[structureId]) && tempRow[0] != '\0'){
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)dummyRow, 1);
-				numRows[structureId]--;
-			}
-			else{
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 1);
-				dummyVar--;
-			}
+	case TYPE_LINEAR_SCAN:{
+		//delete rows that match the condition, write back everything, split across the scan threads
+		Scan_Job job = {0};
+		job.scan = rewriteScan;
+		job.rewrite = deleteRewrite;
+		job.structureId = structureId;
+		job.c = &c;
+		int numParts = runScan(&job, 0, oblivStructureSizes[structureId]);
+		for(int p = 0; p < numParts; p++){
+			numRows[structureId] -= scanPartitions[p].count;
 		}
 		free(tempRow);
-		break;
+		if(numParts == -1){
+			free(dummyRow);
+			return 1;
+		}
+		break;}
+	case TYPE_RING_ORAM:
+	case TYPE_CIRCUIT_ORAM:
 	case TYPE_TREE_ORAM:
 		free(tempRow);
 		int imgivingupanddontcareflag = 0, markedFlag = -1;
@@ -367,23 +569,25 @@ int updateRows(char* tableName, Condition c, int colChoice, uint8_t* colVal, int
 	uint8_t* dummyRow = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 
 	switch(oblivStructureTypes[structureId]){
-	case TYPE_LINEAR_SCAN:
-		for(int i = 0; i < oblivStructureSizes[structureId]; i++){//printf("in loop\n");
-			opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 0);//printf("past\n");
-			//update if it matches the condition, write back otherwise
-			if(rowMatchesCondition(c, tempRow, schemas[structureId]) && tempRow[0] != '\0'){
-				//make changes
-				memcpy(&tempRow[schemas[structureId].fieldOffsets[colChoice]], colVal, schemas[structureId].fieldSizes[colChoice]);
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 1);
-			}
-			else{
-				//make dummy changes
-				memcpy(&dummyRow[schemas[structureId].fieldOffsets[colChoice]], colVal, schemas[structureId].fieldSizes[colChoice]);
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)tempRow, 1);
-			}
-		}
+	case TYPE_LINEAR_SCAN:{
+		//same pass as deleteRows, split across the scan threads
+		Scan_Job job = {0};
+		job.scan = rewriteScan;
+		job.rewrite = updateRewrite;
+		job.structureId = structureId;
+		job.c = &c;
+		job.colOffset = schemas[structureId].fieldOffsets[colChoice];
+		job.value = colVal;
+		job.valueSize = schemas[structureId].fieldSizes[colChoice];
+		int numParts = runScan(&job, 0, oblivStructureSizes[structureId]);
 		free(tempRow);
-		break;
+		if(numParts == -1){
+			free(dummyRow);
+			return 1;
+		}
+		break;}
+	case TYPE_RING_ORAM:
+	case TYPE_CIRCUIT_ORAM:
 	case TYPE_TREE_ORAM:
 		free(tempRow);
 		node *root = bPlusRoots[structureId];
@@ -437,16 +641,12 @@ void bitonicSort(int tableId, int startIndex, int size, int flipped, uint8_t* ro
 	} else if(size < ROWS_IN_ENCLAVE_JOIN) {
 		uint8_t* workingSpace = (uint8_t*)malloc(size*BLOCK_DATA_SIZE);		
 		//copy all the needed rows into the working memory
-		for(int i = 0; i < size; i++){
-			opOneLinearScanBlock(tableId, startIndex+i, (Linear_Scan_Block*)&workingSpace[i*BLOCK_DATA_SIZE], 0);
-		}
+		opLinearScanBlocks(tableId, startIndex, size, (Linear_Scan_Block*)workingSpace, 0);
 
 		smallBitonicSort(workingSpace, 0, size, flipped);
 
 		//write back to the table
-		for(int i = 0; i < size; i++){
-			opOneLinearScanBlock(tableId, startIndex+i, (Linear_Scan_Block*)&workingSpace[i*BLOCK_DATA_SIZE], 1);
-		}
+		opLinearScanBlocks(tableId, startIndex, size, (Linear_Scan_Block*)workingSpace, 1);
 
 		free(workingSpace);
 	} else {
@@ -464,16 +664,12 @@ void bitonicMerge(int tableId, int startIndex, int size, int flipped, uint8_t* r
 	} else if(size < ROWS_IN_ENCLAVE_JOIN) { 
 		uint8_t* workingSpace = (uint8_t*)malloc(size*BLOCK_DATA_SIZE);		
 		//copy all the needed rows into the working memory
-		for(int i = 0; i < size; i++){
-			opOneLinearScanBlock(tableId, startIndex+i, (Linear_Scan_Block*)&workingSpace[i*BLOCK_DATA_SIZE], 0);
-		}
+		opLinearScanBlocks(tableId, startIndex, size, (Linear_Scan_Block*)workingSpace, 0);
 
 		smallBitonicMerge(workingSpace, 0, size, flipped);
 
 		//write back to the table
-		for(int i = 0; i < size; i++){
-			opOneLinearScanBlock(tableId, startIndex+i, (Linear_Scan_Block*)&workingSpace[i*BLOCK_DATA_SIZE], 1);
-		}
+		opLinearScanBlocks(tableId, startIndex, size, (Linear_Scan_Block*)workingSpace, 1);
 
 		free(workingSpace);
 	} else {
@@ -551,6 +747,75 @@ void smallBitonicMerge(uint8_t* bothTables, int startIndex, int size, int flippe
 	}
 }
 
+//one pass of compactLinearRows: a row moves stride slots left when that bit of its distance is set
+//destinations are taken in increasing order, so the slot a row moves into has always been emptied already
+int compactPass(int structureId, int stride, int* dist, uint8_t* batch){
+	int size = oblivStructureSizes[structureId];
+	int split = stride >= SCAN_BATCH_SIZE;
+	for(int i = 0; i < size-stride; ){
+		int n = (size-stride-i < SCAN_BATCH_SIZE) ? size-stride-i : SCAN_BATCH_SIZE;
+		uint8_t* src = split ? &batch[SCAN_BATCH_SIZE*BLOCK_DATA_SIZE] : &batch[stride*BLOCK_DATA_SIZE];
+		//far strides read the two ends separately, near ones read the span between them
+		if(split){
+			if(opLinearScanBlocks(structureId, i, n, (Linear_Scan_Block*)batch, 0)) return 1;
+			if(opLinearScanBlocks(structureId, i+stride, n, (Linear_Scan_Block*)src, 0)) return 1;
+		}
+		else if(opLinearScanBlocks(structureId, i, n+stride, (Linear_Scan_Block*)batch, 0)) return 1;
+		for(int t = 0; t < n; t++){
+			uint8_t* row1 = &batch[t*BLOCK_DATA_SIZE];
+			uint8_t* row2 = &src[t*BLOCK_DATA_SIZE];
+			int swap = (row2[0] != '\0') & ((dist[i+stride+t] & stride) != 0);
+			for(int j = 0; j < BLOCK_DATA_SIZE; j++){
+				uint8_t v1 = row1[j];
+				uint8_t v2 = row2[j];
+				row1[j] = (!swap * v1) + (swap * v2);
+				row2[j] = (swap * v1) + (!swap * v2);
+			}
+			int d1 = dist[i+t];
+			int d2 = dist[i+stride+t];
+			dist[i+t] = (!swap * d1) + (swap * d2);
+			dist[i+stride+t] = (swap * d1) + (!swap * d2);
+		}
+		if(split){
+			if(opLinearScanBlocks(structureId, i, n, (Linear_Scan_Block*)batch, 1)) return 1;
+			if(opLinearScanBlocks(structureId, i+stride, n, (Linear_Scan_Block*)src, 1)) return 1;
+		}
+		else if(opLinearScanBlocks(structureId, i, n+stride, (Linear_Scan_Block*)batch, 1)) return 1;
+		i += n;
+	}
+	return 0;
+}
+
+//oblivious order-preserving compaction of a linear table: every row moves left by the number of free slots
+//before it, one power of two per pass, and each pass touches the same blocks whatever the table holds
+//returns the number of rows, which now fill the front of the table, or -1
+int compactLinearRows(int structureId){
+	int size = oblivStructureSizes[structureId];
+	int* dist = (int*)malloc(size*sizeof(int));
+	uint8_t* batch = (uint8_t*)malloc(2*SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
+	int count = 0;
+	int ret = 0;
+	for(int i = 0; i < size && !ret; i += SCAN_BATCH_SIZE){
+		int n = (size-i < SCAN_BATCH_SIZE) ? size-i : SCAN_BATCH_SIZE;
+		ret = opLinearScanBlocks(structureId, i, n, (Linear_Scan_Block*)batch, 0);
+		for(int t = 0; t < n; t++){
+			int real = batch[t*BLOCK_DATA_SIZE] != '\0';
+			dist[i+t] = real * (i+t-count);
+			count += real;
+		}
+	}
+	for(int stride = 1; stride < size && !ret; stride <<= 1){
+		ret = compactPass(structureId, stride, dist, batch);
+	}
+	free(batch);
+	free(dist);
+	if(ret){
+		printf("could not compact structure %d\n", structureId);
+		return -1;
+	}
+	return count;
+}
+
 int partition (uint8_t* table, int low, int high) 
 {
 	int pivotVal = 0;
@@ -734,16 +999,12 @@ void opaqueSort(int tableId, int size){
 	} else if(size < ROWS_IN_ENCLAVE_JOIN) {
 		uint8_t* workingSpace = (uint8_t*)malloc(size*BLOCK_DATA_SIZE);		
 		//copy all the needed rows into the working memory
-		for(int i = 0; i < size; i++){
-			opOneLinearScanBlock(tableId, i, (Linear_Scan_Block*)&workingSpace[i*BLOCK_DATA_SIZE], 0);
-		}
+		opLinearScanBlocks(tableId, 0, size, (Linear_Scan_Block*)workingSpace, 0);
 
 		quickSort(workingSpace, 0, size-1);
 
 		//write back to the table
-		for(int i = 0; i < size; i++){
-			opOneLinearScanBlock(tableId, i, (Linear_Scan_Block*)&workingSpace[i*BLOCK_DATA_SIZE], 1);
-		}
+		opLinearScanBlocks(tableId, 0, size, (Linear_Scan_Block*)workingSpace, 1);
 
 		free(workingSpace);
 	} else {
@@ -753,19 +1014,16 @@ void opaqueSort(int tableId, int size){
 		if(size % (ROWS_IN_ENCLAVE_JOIN/2) != 0) numChunks++;
 		int sortSize = 0;
 		for(int i = 0; i < numChunks; i++){
-			for(int j = 0; j < ROWS_IN_ENCLAVE_JOIN/2 && i*(ROWS_IN_ENCLAVE_JOIN/2)+j < size; j++){
-				opOneLinearScanBlock(tableId, i*(ROWS_IN_ENCLAVE_JOIN/2)+j, (Linear_Scan_Block*)&workSpace[j*BLOCK_DATA_SIZE], 0);
-				sortSize = j;
-			}
+			int chunkRows = size - i*(ROWS_IN_ENCLAVE_JOIN/2);
+			if(chunkRows > ROWS_IN_ENCLAVE_JOIN/2) chunkRows = ROWS_IN_ENCLAVE_JOIN/2;
+			opLinearScanBlocks(tableId, i*(ROWS_IN_ENCLAVE_JOIN/2), chunkRows, (Linear_Scan_Block*)workSpace, 0);
+			sortSize = chunkRows-1;
 			//quicksort each chunk separately
 			//printf("quicksorting\n");
 			quickSort(workSpace, 0, sortSize);
 			//printf("done quicksorting\n");
 			//write back to the table
-			for(int j = 0; j < ROWS_IN_ENCLAVE_JOIN/2 && i*(ROWS_IN_ENCLAVE_JOIN/2)+j < size; j++){
-				opOneLinearScanBlock(tableId, i*(ROWS_IN_ENCLAVE_JOIN/2)+j, (Linear_Scan_Block*)&workSpace[j*BLOCK_DATA_SIZE], 1);
-				sortSize = j;
-			}
+			opLinearScanBlocks(tableId, i*(ROWS_IN_ENCLAVE_JOIN/2), chunkRows, (Linear_Scan_Block*)workSpace, 1);
 		}
 		//printf("numChunks: %d\n", numChunks);
 		//printf("about to bitonic sort in opaque sort\n");
@@ -783,6 +1041,9 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 	int structureId2 = getTableId(tableName2);//printf("table ids %d %d\n", structureId1, structureId2);
 	Obliv_Type type1 = oblivStructureTypes[structureId1];
 	Obliv_Type type2 = oblivStructureTypes[structureId2];
+	//ring and circuit orams hold the same b+ trees, the join only cares that the tables are indexed
+	if(type1 == TYPE_RING_ORAM || type1 == TYPE_CIRCUIT_ORAM) type1 = TYPE_TREE_ORAM;
+	if(type2 == TYPE_RING_ORAM || type2 == TYPE_CIRCUIT_ORAM) type2 = TYPE_TREE_ORAM;
 	uint8_t* row; //= (uint8_t*)malloc(BLOCK_DATA_SIZE);
 	uint8_t* row1; //= (uint8_t*)malloc(BLOCK_DATA_SIZE);
 	uint8_t* row2; //= (uint8_t*)malloc(BLOCK_DATA_SIZE);
@@ -843,6 +1104,7 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 		memset(row1, 0, BLOCK_DATA_SIZE);
 		memset(row2, 0, BLOCK_DATA_SIZE);
 		uint8_t* block = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+		uint8_t* batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
 
 		int s1Size = oblivStructureSizes[structureId1];
 		int s2Size = oblivStructureSizes[structureId2];
@@ -855,17 +1117,25 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 	
 
 		//fill new 'table' with original contents of both tables
-		for(int i = 0; i < s1Size; i++){
-			opOneLinearScanBlock(structureId1, i, (Linear_Scan_Block*)row, 0);
-			memset(&row[BLOCK_DATA_SIZE-4], 1, 4);
-			memcpy(&row[BLOCK_DATA_SIZE-8], &row[fOffset1], 4);
-			opOneLinearScanBlock(realRetStructId, i, (Linear_Scan_Block*)row, 1);
+		for(int i = 0; i < s1Size; i+=SCAN_BATCH_SIZE){
+			int n = (s1Size-i < SCAN_BATCH_SIZE) ? s1Size-i : SCAN_BATCH_SIZE;
+			opLinearScanBlocks(structureId1, i, n, (Linear_Scan_Block*)batch, 0);
+			for(int j = 0; j < n; j++){
+				uint8_t* slot = &batch[j*BLOCK_DATA_SIZE];
+				memset(&slot[BLOCK_DATA_SIZE-4], 1, 4);
+				memcpy(&slot[BLOCK_DATA_SIZE-8], &slot[fOffset1], 4);
+			}
+			opLinearScanBlocks(realRetStructId, i, n, (Linear_Scan_Block*)batch, 1);
 		}
-		for(int i = 0; i < s2Size; i++){
-			opOneLinearScanBlock(structureId2, i, (Linear_Scan_Block*)row, 0);
-			memset(&row[BLOCK_DATA_SIZE-4], 2, 4);
-			memcpy(&row[BLOCK_DATA_SIZE-8], &row[fOffset2], 4);
-			opOneLinearScanBlock(realRetStructId, i+s1Size, (Linear_Scan_Block*)row, 1);
+		for(int i = 0; i < s2Size; i+=SCAN_BATCH_SIZE){
+			int n = (s2Size-i < SCAN_BATCH_SIZE) ? s2Size-i : SCAN_BATCH_SIZE;
+			opLinearScanBlocks(structureId2, i, n, (Linear_Scan_Block*)batch, 0);
+			for(int j = 0; j < n; j++){
+				uint8_t* slot = &batch[j*BLOCK_DATA_SIZE];
+				memset(&slot[BLOCK_DATA_SIZE-4], 2, 4);
+				memcpy(&slot[BLOCK_DATA_SIZE-8], &slot[fOffset2], 4);
+			}
+			opLinearScanBlocks(realRetStructId, i+s1Size, n, (Linear_Scan_Block*)batch, 1);
 		}
 
 		if(startKey == -249) { //do the opaque sort
@@ -893,7 +1163,8 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 		for(int i = 0; i < outSize; i++){
 			shift = getRowSize(&schemas[structureId1]);
 
-			opOneLinearScanBlock(realRetStructId, i, (Linear_Scan_Block*)row, 0);
+			if(i % SCAN_BATCH_SIZE == 0) opLinearScanBlocks(realRetStructId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 0);
+			memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 
 			int realFromTable1 = row[BLOCK_DATA_SIZE-4] == 1 && row[0];
 			int realFromTable2 = row[BLOCK_DATA_SIZE-4] == 2 && row[0];
@@ -916,7 +1187,8 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 			numRows[realRetStructId] += match;
 			row[0] = match*row[0]+!match*'\0';	
 
-			opOneLinearScanBlock(realRetStructId, i, (Linear_Scan_Block*)row, 1);
+			memcpy(&batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], row, BLOCK_DATA_SIZE);
+			if(i % SCAN_BATCH_SIZE == SCAN_BATCH_SIZE-1 || i == outSize-1) opLinearScanBlocks(realRetStructId, i-i%SCAN_BATCH_SIZE, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 1);
 
 		} //printf("number of rows: %d\n", numRows[realRetStructId]);
 
@@ -924,6 +1196,7 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 		free(row1);
 		free(row2);
 		free(block);
+		free(batch);
 	} 
 	else if(type1 == TYPE_LINEAR_SCAN && type2 == TYPE_LINEAR_SCAN){
 		//note: to match the functionality of the index join where we specify a range of keys,
@@ -933,6 +1206,8 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 		row1 = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 		row2 = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 		uint8_t* block = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+		uint8_t* batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
+		uint8_t* outBatch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
 		int insertionCounter = 0;
 
 		//allocate hash table
@@ -950,9 +1225,12 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 			//initialize hash table
 			memset(hashTable, '\0', ROWS_IN_ENCLAVE_JOIN*BLOCK_DATA_SIZE);
 
+			Scan_Iterator build;
+			openScan(&build, structureId1, i, i+ROWS_IN_ENCLAVE_JOIN/4);
 			for(int j = 0; j<(ROWS_IN_ENCLAVE_JOIN/4) && i+j < oblivStructureSizes[structureId1]; j++){
 				//get row
-				opOneLinearScanBlock(structureId1, i+j, (Linear_Scan_Block*)row, 0);
+				if(j % SCAN_BATCH_SIZE == 0) scanNextBatch(&build, (Linear_Scan_Block*)batch);
+				memcpy(row, &batch[(j%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 				if(row[0] == '\0') continue;
 				//insert into hash table
 				int insertCounter = 0;//increment on failure to insert, set to -1 on successful insertion
@@ -981,9 +1259,13 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 				}
 				while(insertCounter != -1);
 			}
+			closeScan(&build);
+			Scan_Iterator probe;
+			openScan(&probe, structureId2, 0, oblivStructureSizes[structureId2]);
 			for(int j = 0; j<oblivStructureSizes[structureId2]; j++){
 				//get row
-				opOneLinearScanBlock(structureId2, j, (Linear_Scan_Block*)row, 0);
+				if(j % SCAN_BATCH_SIZE == 0) scanNextBatch(&probe, (Linear_Scan_Block*)batch);
+				memcpy(row, &batch[(j%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 				if(row[0] == '\0') continue;
 				int checkCounter = 0, match = -1;
 				do{
@@ -1044,10 +1326,10 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 				}
 
 				//block->actualAddr = numRows[retStructId];
-				memcpy(block, &row1[0], BLOCK_DATA_SIZE);
-				//printf("before %d\n", insertionCounter);
-				opOneLinearScanBlock(realRetStructId, insertionCounter, (Linear_Scan_Block*)block, 1);
-				//printf("after %d\n", insertionCounter);
+				memcpy(&outBatch[(insertionCounter%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], &row1[0], BLOCK_DATA_SIZE);
+				//output rows are written sequentially, so flush them a batch at a time
+				if(insertionCounter % SCAN_BATCH_SIZE == SCAN_BATCH_SIZE-1)
+					opLinearScanBlocks(realRetStructId, insertionCounter-SCAN_BATCH_SIZE+1, SCAN_BATCH_SIZE, (Linear_Scan_Block*)outBatch, 1);
 				insertionCounter++;
 				if(match) {
 					//printf("here? %d\n", numRows[realRetStructId]);
@@ -1058,8 +1340,11 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 				}
 
 			}
+			closeScan(&probe);
 			//printf("insertionCounter: %d\n", insertionCounter);
 		} //printf("number of rows: %d\n", numRows[realRetStructId]);
+		if(insertionCounter % SCAN_BATCH_SIZE != 0)
+			opLinearScanBlocks(realRetStructId, insertionCounter-insertionCounter%SCAN_BATCH_SIZE, insertionCounter%SCAN_BATCH_SIZE, (Linear_Scan_Block*)outBatch, 1);
 
 		free(hashTable);
 		free(hashIn);
@@ -1069,6 +1354,8 @@ int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, i
 		free(row1);
 		free(row2);
 		free(block);
+		free(batch);
+		free(outBatch);
 	}
 	else if(type1 == TYPE_TREE_ORAM && type2 == TYPE_TREE_ORAM){
 		printf("LEFT JOIN\n");
@@ -1947,7 +2234,34 @@ extern int indexSelect(char* tableName, int colChoice, Condition c, int aggregat
 //groupCol = -1 means not to order or group by, aggregate = -1 means no aggregate, aggregate = 0 count, 1 sum, 2 min, 3 max, 4 mean
 //including algChoice in case I need to use it later to choose among algorithms
 //select column colNum; if colChoice = -1, select all columns
+//column groups of a split table a query reads: the deleted flag, the condition's fields and the columns it returns,
+//aggregates or groups on. returning whole rows needs all of them
+int queryColumnGroups(int structureId, Condition* c, int colChoice, int groupCol, int secondCol){
+	if(colChoice == -1) return -1;
+	Schema* s = &schemas[structureId];
+	int mask = 1 << columnGroupOf(structureId, 0);
+	mask |= 1 << columnGroupOf(structureId, s->fieldOffsets[colChoice]);
+	if(groupCol >= 0) mask |= 1 << columnGroupOf(structureId, s->fieldOffsets[groupCol]);
+	if(secondCol >= 0 && secondCol < s->numFields) mask |= 1 << columnGroupOf(structureId, s->fieldOffsets[secondCol]);
+	for(Condition* cond = c; cond != NULL; cond = cond->nextCondition){
+		for(int i = 0; i < cond->numClauses; i++){
+			mask |= 1 << columnGroupOf(structureId, s->fieldOffsets[cond->fieldNums[i]]);
+		}
+	}
+	return mask;
+}
+
 int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate) {
+	int structureId = getTableId(tableName);
+	if(structureId == -1 || numColumnGroups[structureId] == 0) return runSelectRows(tableName, colChoice, c, aggregate, groupCol, algChoice, intermediate);
+	//a group by reads algChoice as a second column to aggregate
+	setScanGroups(structureId, queryColumnGroups(structureId, &c, colChoice, groupCol, (groupCol == -1) ? -1 : algChoice));
+	int ret = runSelectRows(tableName, colChoice, c, aggregate, groupCol, algChoice, intermediate);
+	setScanGroups(structureId, -1);
+	return ret;
+}
+
+int runSelectRows(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate) {
 	int structureId = getTableId(tableName);
 	Obliv_Type type = oblivStructureTypes[structureId];
 	int colChoiceSize = BLOCK_DATA_SIZE;
@@ -1967,6 +2281,7 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 	int stat = 0;
 	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 	uint8_t* row2 = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	uint8_t* batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
 
 	char *retName = "ReturnTable";
 	int retNameLen = strlen(retName);
@@ -1985,26 +2300,26 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 				int dummyVar = 0;
 				int baseline = 0;
 				//first pass to determine 1) output size (count), 2) whether output is one continuous chunk (continuous)
-				for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-					opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
-					row = ((Linear_Scan_Block*)row)->data;
-					//printf("ready for a comparison? %d\n", c.numClauses);
-						if(rowMatchesCondition(c, row, schemas[structureId]) && row[0] != '\0'){
-							count++;
-							if(!continuous && !contTemp){//first hit
-								continuous = 1;
-							}
-							else if(continuous && contTemp){//a noncontinuous hit
-								continuous = 0;
-							}
-						}
-						else{
-							dummyVar++;
-							if(continuous && !contTemp){//end of continuous chunk
-								contTemp = 1;
-							}
-						}
+				Scan_Job countJob = {0};
+				countJob.scan = selectCountScan;
+				countJob.structureId = structureId;
+				countJob.c = &c;
+				int numParts = runScan(&countJob, 0, oblivStructureSizes[structureId]);
+				if(numParts == -1){
+					free(dummy);
+					free(row);
+					free(row2);
+					free(batch);
+					return 1;
+				}
+				int firstMatch = -1, lastMatch = -1;
+				for(int p = 0; p < numParts; p++){
+					count += scanPartitions[p].count;
+					if(firstMatch == -1) firstMatch = scanPartitions[p].firstMatch;
+					if(scanPartitions[p].lastMatch != -1) lastMatch = scanPartitions[p].lastMatch;
 				}
+				//continuous if no row between the first hit and the last one failed to match
+				continuous = (count > 0 && lastMatch-firstMatch+1 == count);
 
 				if(count > oblivStructureSizes[structureId]*.01*PERCENT_ALMOST_ALL && colChoice == -1){ //return almost all only if the whole row is selected (to make my life easier)
 					almostAll = 1;
@@ -2078,6 +2393,7 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 					free(dummy);
 					free(row);
 					free(row2);
+					free(batch);
 					return 0;
 				}
 				//printf("Made it to algorithm slection\n");
@@ -2092,8 +2408,11 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 					opOramBlock(oramTableId, 0, oBlock, 1);
 
 					int oramRows = 0;
+					Scan_Iterator scan;
+					openScan(&scan, structureId, 0, oblivStructureSizes[structureId]);
 					for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-						opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)oBlock->data, 0);
+						if(i % SCAN_BATCH_SIZE == 0) scanNextBatch(&scan, (Linear_Scan_Block*)batch);
+						memcpy(oBlock->data, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 						//oBlock->data = ((Linear_Scan_Block*)(oBlock->data))->data;
 						int match = rowMatchesCondition(c, oBlock->data, schemas[structureId]) && oBlock->data[0] != '\0';
 						if(colChoice != -1){
@@ -2112,6 +2431,7 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 							dummyVar++;
 						}
 					}
+					closeScan(&scan);
 					//copy back to linear structure
 					for(int i = 0; i < oramRows; i++){
 						opOramBlock(oramTableId, i, oBlock, 0);
@@ -2123,9 +2443,12 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 				else if(continuous){//use continuous chunk algorithm
 					printf("CONTINUOUS\n");
 					int rowi = -1, dummyVar = 0;//NOTE: rowi left in for historical reasons; it should be replaced by i
+					Scan_Iterator scan;
+					openScan(&scan, structureId, 0, oblivStructureSizes[structureId]);
 					for(int i = 0; i < oblivStructureSizes[structureId]; i++){
 						if(count == 0) break;
-						opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+						if(i % SCAN_BATCH_SIZE == 0) scanNextBatch(&scan, (Linear_Scan_Block*)batch);
+						memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 
 						row = ((Linear_Scan_Block*)row)->data;
 						rowi++;
@@ -2148,6 +2471,7 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 							dummyVar++;
 						}
 					}
+					closeScan(&scan);
 					//printTable("ReturnTable");
 				}
 				else{//pick one of other algorithms
@@ -2156,24 +2480,25 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 						//"almost all" solution, it's a field being returned that is not an integer so we can put in dummy entries
 						//have new table that is copy of old table and delete any rows that are not supposed to be in the output
 						memset(row2, '\0', BLOCK_DATA_SIZE);
-						for(int i = 0; i < oblivStructureSizes[structureId]; i++){ //copy table
-							opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
-							opOneLinearScanBlock(retStructId, i, (Linear_Scan_Block*)row, 1);
+						for(int i = 0; i < oblivStructureSizes[structureId]; i+=SCAN_BATCH_SIZE){ //copy table
+							opLinearScanBlocks(structureId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 0);
+							opLinearScanBlocks(retStructId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 1);
 						}
 						numRows[retStructId] = numRows[structureId];
 						int dummyVar = 0;
-						for(int i = 0; i < oblivStructureSizes[structureId]; i++){ //delete bad rows
-							opOneLinearScanBlock(retStructId, i, (Linear_Scan_Block*)row, 0);
-							if(rowMatchesCondition(c, row, schemas[structureId]) || row[0] == '\0'){
-								opOneLinearScanBlock(retStructId, i, (Linear_Scan_Block*)row, 1);
-								dummyVar--;
-							}
-							else{
-								opOneLinearScanBlock(retStructId, i, (Linear_Scan_Block*)row2, 1);//write dummy row over unselected rows
-								numRows[retStructId]--;
-								//printf("LOOLZ %d\n", numRows[retStructId]);
+						for(int i = 0; i < oblivStructureSizes[structureId]; i+=SCAN_BATCH_SIZE){ //delete bad rows
+							opLinearScanBlocks(retStructId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 0);
+							for(int j = 0; j < SCAN_BATCH_SIZE && i+j < oblivStructureSizes[structureId]; j++){
+								uint8_t* slot = &batch[j*BLOCK_DATA_SIZE];
+								if(rowMatchesCondition(c, slot, schemas[structureId]) || slot[0] == '\0'){
+									dummyVar--;
+								}
+								else{
+									memcpy(slot, row2, BLOCK_DATA_SIZE);//write dummy row over unselected rows
+									numRows[retStructId]--;
+								}
 							}
-
+							opLinearScanBlocks(retStructId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 1);
 						}
 					}
 					else if(small){ //option 1 ("small")
@@ -2187,8 +2512,11 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 						do{
 							if(count == 0) break;
 							int rowi = -1;
+							Scan_Iterator scan;
+							openScan(&scan, structureId, 0, oblivStructureSizes[structureId]);
 							for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-								opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+								if(i % SCAN_BATCH_SIZE == 0) scanNextBatch(&scan, (Linear_Scan_Block*)batch);
+								memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 								row = ((Linear_Scan_Block*)row)->data;
 
 								if(row[0] != '\0') rowi++;
@@ -2211,6 +2539,7 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 									dummyCounter++;
 								}
 							}
+							closeScan(&scan);
 							//copy to response
 							int twiddle = 0;
 							if(colChoice != -1){
@@ -2245,9 +2574,12 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 
 						numRows[retStructId] = count;
 
+						Scan_Iterator scan;
+						openScan(&scan, structureId, 0, oblivStructureSizes[structureId]);
 						for(int i = 0; i < oblivStructureSizes[structureId]; i++){
 							if(count == 0) break;
-							opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+							if(i % SCAN_BATCH_SIZE == 0) scanNextBatch(&scan, (Linear_Scan_Block*)batch);
+							memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 							row = ((Linear_Scan_Block*)row)->data;
 							//if(row[0] == '\0') continue;
 							//else rowi++;
@@ -2296,10 +2628,12 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 							}
 							if(!written) {
 								printf("ohhhh");
+								closeScan(&scan);
 								return 1; //panic
 							}
 
 						}
+						closeScan(&scan);
 					}
 				}
 
@@ -2340,63 +2674,54 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 				else{
 					createTable(&retSchema, retName, retNameLen, retType, retNumRows, &retStructId);
 				}
-				int first = 0, dummyCount = 0;
-				for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-					if(baseline){
+				int first = 0;
+				if(baseline){
+					for(int i = 0; i < oblivStructureSizes[structureId]; i++){
 						opOramBlock(baselineId, 0, oBlock, 0);
 					}
-					opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
-					row = ((Linear_Scan_Block*)row)->data;
-					if(rowMatchesCondition(c, row, schemas[structureId]) && row[0] != '\0'){
-						count++;
-						int val = (int)row[schemas[structureId].fieldOffsets[colChoice]];
-						switch(aggregate){
-						case 1:
-								stat+=val;
-							break;
-						case 2:
-							if(val < stat || first == 0){
-								stat = val;
-								winRow = i;
-							}
-							break;
-						case 3:
-							if(val > stat || first == 0){
-								stat = val;
-								winRow = i;
-							}
-							break;
-						case 4:
-								stat+=val;
-							break;
-						}
-						first = 1;
+				}
+				//each partition aggregates its own rows, then they are combined in table order
+				//so min and max keep the first winning row just like a single pass would
+				Scan_Job aggJob = {0};
+				aggJob.scan = aggregateScan;
+				aggJob.structureId = structureId;
+				aggJob.c = &c;
+				aggJob.colOffset = schemas[structureId].fieldOffsets[colChoice];
+				aggJob.aggregate = aggregate;
+				int numParts = runScan(&aggJob, 0, oblivStructureSizes[structureId]);
+				if(numParts == -1){
+					if(baseline){
+						free(oBlock);
+						deleteTable(tempName);
 					}
-					else{//dummy branch
-						dummyCount++;
-						int val = (int)row[schemas[structureId].fieldOffsets[colChoice]];
-						switch(aggregate){
-						case 1:
-								dummyCount+=val;
-							break;
-						case 2:
-							if(val < stat || first == 0){
-								dummyCount = val;
-								dummyCount = i;
-							}
-							break;
-						case 3:
-							if(val > stat || first == 0){
-								dummyCount = val;
-								dummyCount = i;
-							}
-							break;
-						case 4:
-							dummyCount+=val;
-							break;
+					free(dummy);
+					free(row);
+					free(row2);
+					free(batch);
+					return 1;
+				}
+				for(int p = 0; p < numParts; p++){
+					Scan_Partition* part = &scanPartitions[p];
+					count += part->count;
+					switch(aggregate){
+					case 1:
+					case 4:
+						stat += part->stat;
+						break;
+					case 2:
+						if(part->statSet && (part->stat < stat || first == 0)){
+							stat = part->stat;
+							winRow = part->statRow;
 						}
-						dummyCount = 1;
-					}//end dummy branch
+						break;
+					case 3:
+						if(part->statSet && (part->stat > stat || first == 0)){
+							stat = part->stat;
+							winRow = part->statRow;
+						}
+						break;
+					}
+					first |= part->statSet;
 				}
 				if(aggregate == 0) {
 					stat = count;
@@ -2482,10 +2807,13 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 			int groupStat2[MAX_GROUPS] = {0};
 			int groupCount[MAX_GROUPS] = {0};
 			//printf("oblivStructureSizes %d %d\n", structureId, oblivStructureSizes[structureId]);
+			Scan_Iterator scan;
+			openScan(&scan, structureId, 0, oblivStructureSizes[structureId]);
 			for(int i = 0; i < oblivStructureSizes[structureId]; i++){
 				//opOneLinearScanBlock(structureId, i+306000, (Linear_Scan_Block*)row, 0);
 				//printf(" op done\n");
-				opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+				if(i % SCAN_BATCH_SIZE == 0) scanNextBatch(&scan, (Linear_Scan_Block*)batch);
+				memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 				memcpy(groupVal, &row[schemas[structureId].fieldOffsets[groupCol]], schemas[structureId].fieldSizes[groupCol]);
 				memcpy(&aggrVal, &row[schemas[structureId].fieldOffsets[colChoice]], 4);
 				memcpy(&aggrVal2, &row[schemas[structureId].fieldOffsets[colChoice2]], 4);
@@ -2620,6 +2948,7 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 					}
 				}
 			}
+			closeScan(&scan);
 			for(int j = 0; j < numGroups; j++){
 				if(baseline){
 					opOramBlock(baselineId, 0, oBlock, 0);
@@ -2706,6 +3035,8 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 		}
 		break;
 	case TYPE_TREE_ORAM:
+	case TYPE_RING_ORAM:
+	case TYPE_CIRCUIT_ORAM:
 		//TODO
 		break;
 	}
@@ -2713,9 +3044,19 @@ int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int g
 	free(dummy);
 	free(row);
 	free(row2);
+	free(batch);
 }
 
 int highCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate) {
+	int structureId = getTableId(tableName);
+	if(structureId == -1 || numColumnGroups[structureId] == 0) return runHighCardLinGroupBy(tableName, colChoice, c, aggregate, groupCol, algChoice, intermediate);
+	setScanGroups(structureId, queryColumnGroups(structureId, &c, colChoice, groupCol, -1));
+	int ret = runHighCardLinGroupBy(tableName, colChoice, c, aggregate, groupCol, algChoice, intermediate);
+	setScanGroups(structureId, -1);
+	return ret;
+}
+
+int runHighCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate) {
 	int structureId = getTableId(tableName);
 	Obliv_Type type = oblivStructureTypes[structureId];
 	int colChoiceSize = BLOCK_DATA_SIZE;
@@ -2729,6 +3070,14 @@ int highCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregat
 	int count = 0;
 	int stat = 0;
 	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	//groups are numbered in the order they are first seen, so rows are grouped by one thread
+	//but each window of blocks is decrypted by all the scan threads first
+	int window = SCAN_BATCH_SIZE*MAX_SCAN_THREADS;
+	uint8_t* batch = (uint8_t*)malloc(window*BLOCK_DATA_SIZE);
+	Scan_Job readJob = {0};
+	readJob.scan = readScan;
+	readJob.structureId = structureId;
+	readJob.blocks = batch;
 
 	char *retName = "ReturnTable";
 	int retNameLen = strlen(retName);
@@ -2776,7 +3125,16 @@ int highCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregat
 	int forupto = oblivStructureSizes[structureId];
 	if(MIXED_USE_MODE) forupto*=4;
 	for(int i = 0; i < forupto; i++){
-		opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+		if(i % window == 0){
+			readJob.startIndex = i;
+			if(runScan(&readJob, i, (forupto-i < window) ? forupto : i+window) == -1){
+				for(int j = 0; j < numGroups; j++) free(groups[j]);
+				free(row);
+				free(batch);
+				return 1;
+			}
+		}
+		memcpy(row, &batch[(i%window)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 		memcpy(groupVal, &row[schemas[structureId].fieldOffsets[groupCol]], substrX);
 		memcpy(&aggrVal, &row[schemas[structureId].fieldOffsets[colChoice]], 4);
 		//printf("groupVal: %s", groupVal);
@@ -2934,14 +3292,17 @@ int highCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregat
 		}
 
 	free(row);
+	free(batch);
 }
 
 int printTableCheating(char* tableName){//non-oblivious version that's good for debugging
 	int structureId = getTableId(tableName);
 	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	uint8_t* batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
 	printf("\nTable %s, %d rows, capacity for %d rows, stored in structure %d\n", tableNames[structureId], numRows[structureId], oblivStructureSizes[structureId], structureId);
 	for(int i = 0; i < oblivStructureSizes[structureId]; i++){
-		opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+		if(i % SCAN_BATCH_SIZE == 0) opLinearScanBlocks(structureId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 0);
+		memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 		if(row[0] == '\0') {
 			continue;
 		}
@@ -2963,6 +3324,7 @@ int printTableCheating(char* tableName){//non-oblivious version that's good for
 		}
 		printf("\n");
 	}
+	free(batch);
 }
 
 int printTable(char* tableName){//only for linear scan tables
@@ -2970,6 +3332,7 @@ int printTable(char* tableName){//only for linear scan tables
 	int structureId = getTableId(tableName);
 	uint8_t* row = (uint8_t*)malloc(BLOCK_DATA_SIZE);
 	uint8_t* dummy = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+	uint8_t* batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
 	printf("\nTable %s, %d rows, capacity for %d rows, stored in structure %d\n", tableNames[structureId], numRows[structureId], oblivStructureSizes[structureId], structureId);
 
 	//unsigned int rand = 0;
@@ -2998,7 +3361,8 @@ int printTable(char* tableName){//only for linear scan tables
 				dummyCounter = 1;
 			}
 			*/
-			opOneLinearScanBlock(structureId, i, (Linear_Scan_Block*)row, 0);
+			if(i % SCAN_BATCH_SIZE == 0) opLinearScanBlocks(structureId, i, SCAN_BATCH_SIZE, (Linear_Scan_Block*)batch, 0);
+			memcpy(row, &batch[(i%SCAN_BATCH_SIZE)*BLOCK_DATA_SIZE], BLOCK_DATA_SIZE);
 			row = ((Linear_Scan_Block*)row)->data;
 
 			if(row[0] != '\0') rowi++;
@@ -3052,6 +3416,7 @@ int printTable(char* tableName){//only for linear scan tables
 	}
 	while(pauseCounter < numRows[structureId]);
 	free(storage);
+	free(batch);
 	printf("\nTable %s, %d rows, capacity for %d rows, stored in structure %d\n", tableNames[structureId], numRows[structureId], oblivStructureSizes[structureId], structureId);
 }
 
@@ -3192,75 +3557,552 @@ int createTestTableIndex(char* tableName, int numberOfRows){
 	free(row);
 }
 
+//header fields every saved table has, the key binding included
+int fillTableHeader(int structureId, Saved_Table_Header* header){
+	memset(header, 0, sizeof(Saved_Table_Header));
+	header->magic = SAVED_TABLE_MAGIC;
+	header->size = oblivStructureSizes[structureId];
+	header->type = oblivStructureTypes[structureId];
+	memcpy(&header->schema, &schemas[structureId], sizeof(Schema));
+	header->numRows = numRows[structureId];
+	header->rowsPerBlock = rowsPerBlock[structureId];
+	header->lastInserted = lastInserted[structureId];
+	header->logicalSize = logicalSizes[structureId];
+	header->blockSize = blockDataSizes[structureId];
+	header->storage = storageTypes[structureId];
+	memcpy(&header->key, oblivKeys[structureId], sizeof(sgx_aes_gcm_128bit_key_t));
+	if(sgx_read_rand(header->nonce, sizeof(header->nonce)) != SGX_SUCCESS) return 1;
+	return 0;
+}
+
+//seals the header to this enclave and writes it, prefixed by its sealed size
+int writeTableHeader(Saved_Table_Header* header, int fileId){
+	uint32_t sealedSize = sgx_calc_sealed_data_size(0, sizeof(Saved_Table_Header));
+	sgx_sealed_data_t* sealed = (sgx_sealed_data_t*)malloc(sealedSize);
+	if(sealed == NULL) return 1;
+	int ret = 0;
+	if(sgx_seal_data(0, NULL, sizeof(Saved_Table_Header), (uint8_t*)header, sealedSize, sealed) != SGX_SUCCESS) ret = 1;
+	if(ret == 0){
+		ocall_write_file(&sealedSize, 4, fileId);
+		ocall_write_file(sealed, sealedSize, fileId);
+	}
+	free(sealed);
+	return ret;
+}
+
+//reads and unseals the header of the file opened with ocall_open_read
+int readTableHeader(Saved_Table_Header* header, Obliv_Type type){
+	uint32_t sealedSize = 0;
+	ocall_read_file(&sealedSize, 4);
+	if(sealedSize != sgx_calc_sealed_data_size(0, sizeof(Saved_Table_Header))){
+		printf("AUTHENTICITY FAILURE: saved table header has the wrong size\n");
+		return 1;
+	}
+	sgx_sealed_data_t* sealed = (sgx_sealed_data_t*)malloc(sealedSize);
+	if(sealed == NULL) return 1;
+	ocall_read_file(sealed, sealedSize);
+	uint32_t headerSize = sizeof(Saved_Table_Header);
+	sgx_status_t unsealRet = sgx_unseal_data(sealed, NULL, NULL, (uint8_t*)header, &headerSize);
+	free(sealed);
+	if(unsealRet != SGX_SUCCESS || headerSize != sizeof(Saved_Table_Header) || header->magic != SAVED_TABLE_MAGIC
+			|| header->type != type || header->size <= 0){
+		printf("AUTHENTICITY FAILURE: could not unseal saved table header\n");
+		return 1;
+	}
+	return 0;
+}
+
+//enclave state that goes in a snapshot next to the blocks is encrypted under the table's key
+//the snapshot nonce and section number are authenticated with it so sections can't be moved between snapshots
+int writeSnapshotSection(int structureId, Saved_Table_Header* header, int section, void* data, int size, int fileId){
+	uint8_t aad[12];
+	memcpy(aad, header->nonce, 8);
+	memcpy(&aad[8], &section, 4);
+	uint8_t iv[12];
+	sgx_aes_gcm_128bit_tag_t macTag;
+	uint8_t* ciphertext = (uint8_t*)malloc(size+1);
+	if(ciphertext == NULL) return 1;
+	int ret = 0;
+	if(sgx_read_rand(iv, 12) != SGX_SUCCESS) ret = 1;
+	if(ret == 0 && sgx_rijndael128GCM_encrypt(oblivKeys[structureId], (uint8_t*)data, size, ciphertext, iv, 12, aad, 12, &macTag) != SGX_SUCCESS) ret = 1;
+	if(ret == 0){
+		ocall_write_file(iv, 12, fileId);
+		ocall_write_file(macTag, 16, fileId);
+		if(size > 0) ocall_write_file(ciphertext, size, fileId);
+	}
+	free(ciphertext);
+	return ret;
+}
+
+int readSnapshotSection(int structureId, Saved_Table_Header* header, int section, void* data, int size){
+	uint8_t aad[12];
+	memcpy(aad, header->nonce, 8);
+	memcpy(&aad[8], &section, 4);
+	uint8_t iv[12];
+	sgx_aes_gcm_128bit_tag_t macTag;
+	uint8_t* ciphertext = (uint8_t*)malloc(size+1);
+	if(ciphertext == NULL) return 1;
+	ocall_read_file(iv, 12);
+	ocall_read_file(macTag, 16);
+	if(size > 0) ocall_read_file(ciphertext, size);
+	int ret = 0;
+	if(sgx_rijndael128GCM_decrypt(oblivKeys[structureId], ciphertext, size, (uint8_t*)data, iv, 12, aad, 12, &macTag) != SGX_SUCCESS){
+		printf("AUTHENTICITY FAILURE: snapshot section %d does not decrypt\n", section);
+		ret = 1;
+	}
+	free(ciphertext);
+	return ret;
+}
+
+//writes an index table to testTable<tableSize>: a sealed header, the encrypted enclave state, then the oram buckets as they are
+//the buckets go straight from the app's copy to the file and are never decrypted. a snapshot already saved under tableSize is replaced
 int saveIndexTable(char* tableName, int tableSize){
 	int structureId = getTableId(tableName);
-	Oram_Bucket* bucket = (Oram_Bucket*)malloc(sizeof(Oram_Bucket));
-	Encrypted_Oram_Bucket* encBucket = (Encrypted_Oram_Bucket*)malloc(sizeof(Encrypted_Oram_Bucket));
-	//char savedTableName[20];
-	//sprintf(savedTableName, "testTable%d", numRows[structureId]);
-//things I need to save
-	ocall_write_file(&oblivStructureSizes[structureId], 4, tableSize); //printf("here %d\n", tableSize);
-	ocall_write_file(&oblivStructureTypes[structureId], 4, tableSize);
-	ocall_write_file(&schemas[structureId], sizeof(Schema), tableSize);
-	ocall_write_file(&rowsPerBlock[structureId], 4, tableSize);
-	ocall_write_file(&numRows[structureId], 4, tableSize);
-	ocall_write_file(&stashOccs[structureId], 4, tableSize);
-	ocall_write_file(&logicalSizes[structureId], 4, tableSize);
-	ocall_write_file(bPlusRoots[structureId], sizeof(node), tableSize);
-	ocall_write_file(usedBlocks[structureId], sizeof(uint8_t)*logicalSizes[structureId], tableSize);
-	ocall_write_file(positionMaps[structureId], sizeof(unsigned int)*logicalSizes[structureId], tableSize);
-	std::list<Oram_Block>::iterator stashScan = stashes[structureId]->begin();
-	for(int i = 0; i < stashOccs[structureId]; i++){
-		ocall_write_file(&(*stashScan), sizeof(Oram_Block), tableSize);
-		stashScan++;
-	}
-	for(int i = 0; i < logicalSizes[structureId]; i++){
-		ocall_read_block(structureId, i, sizeof(Encrypted_Oram_Bucket), encBucket);
-		if(decryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) return 1;
-		ocall_write_file(&bucket[0], sizeof(Oram_Bucket), tableSize);
+	if(posMapIds[structureId] != -1){
+		printf("saving tables with recursive position maps is not supported\n");
+		return 1;
 	}
-	return 0;
+	if(oblivStructureTypes[structureId] == TYPE_RING_ORAM || oblivStructureTypes[structureId] == TYPE_CIRCUIT_ORAM){
+		printf("saving ring or circuit oram tables is not supported\n");
+		return 1;
+	}
+	Saved_Table_Header header;
+	if(fillTableHeader(structureId, &header)) return 1;
+	header.freeListSize = freeListSizes[structureId];
+	header.stashOcc = stashOccs[structureId];
+	int logicalSize = logicalSizes[structureId];
+	Oram_Block* stashBlocks = (Oram_Block*)malloc((header.stashOcc+1)*sizeof(Oram_Block));
+	if(stashBlocks == NULL) return 1;
+	int numStashed = 0;
+	for(int i = 0; i < stashes[structureId].capacity; i++){
+		if(stashSlotUsed(structureId, i)) memcpy(&stashBlocks[numStashed++], &stashes[structureId].blocks[i], sizeof(Oram_Block));
+	}
+	//the file gets the app's copy of every bucket, so none can be left unwritten or stale
+	int ret = flushTreeTop(structureId);
+	if(ret == 0) ret = writeUnwrittenBlocks(structureId);
+	if(ret == 0) ocall_open_write(tableSize);
+	if(ret == 0) ret = writeTableHeader(&header, tableSize);
+	if(ret == 0) ret = writeSnapshotSection(structureId, &header, 0, bPlusRoots[structureId], sizeof(node), tableSize);
+	if(ret == 0) ret = writeSnapshotSection(structureId, &header, 1, usedBlocks[structureId], sizeof(uint8_t)*logicalSize, tableSize);
+	if(ret == 0) ret = writeSnapshotSection(structureId, &header, 2, positionMaps[structureId], sizeof(unsigned int)*logicalSize, tableSize);
+	if(ret == 0) ret = writeSnapshotSection(structureId, &header, 3, freeLists[structureId], sizeof(int)*header.freeListSize, tableSize);
+	if(ret == 0) ret = writeSnapshotSection(structureId, &header, 4, stashBlocks, sizeof(Oram_Block)*numStashed, tableSize);
+	if(ret == 0) ret = writeSnapshotSection(structureId, &header, 5, revNum[structureId], sizeof(int)*logicalSize, tableSize);
+	free(stashBlocks);
+	memset(&header, 0, sizeof(Saved_Table_Header));
+	if(ret == 0) ocall_write_structure(structureId, tableSize);
+	return ret;
 }
 
+//opens a snapshot from saveIndexTable as testTable<tableSize>, the buckets are streamed into the app's storage
+//without re-encryption and stay under the key they were saved with. a table kept in a mapped file gets its saved
+//file mapped back instead, so nothing is copied
 int loadIndexTable(int tableSize){
-	//printf("here. table name: %s\n", tableName);
 	int structureId = getNextId();
+	if(structureId == -1) return 1;
 	ocall_open_read(tableSize);
-	Oram_Block* block = (Oram_Block*)malloc(sizeof(Oram_Block));
-	Oram_Bucket* bucket = (Oram_Bucket*)malloc(sizeof(Oram_Bucket));
-	Encrypted_Oram_Bucket* encBucket = (Encrypted_Oram_Bucket*)malloc(sizeof(Encrypted_Oram_Bucket));
+	Saved_Table_Header header;
+	if(readTableHeader(&header, TYPE_TREE_ORAM)) return 1;
+	int logicalSize = header.logicalSize;
+	if(logicalSize != header.size || header.freeListSize < 0 || header.freeListSize > logicalSize || header.stashOcc < 0){
+		printf("AUTHENTICITY FAILURE: saved table header is inconsistent\n");
+		return 1;
+	}
+	oblivKeys[structureId] = (sgx_aes_gcm_128bit_key_t*)malloc(sizeof(sgx_aes_gcm_128bit_key_t));
+	if(oblivKeys[structureId] == NULL) return 1;
+	memcpy(oblivKeys[structureId], &header.key, sizeof(sgx_aes_gcm_128bit_key_t));
+	//claims the id, free_structure undoes everything below on failure
+	oblivStructureSizes[structureId] = header.size;
+	oblivStructureTypes[structureId] = TYPE_TREE_ORAM;
+	logicalSizes[structureId] = logicalSize;
+	posMapIds[structureId] = -1;
+	bPlusRoots[structureId] = (node*)malloc(sizeof(node));
+	usedBlocks[structureId] = (uint8_t*)malloc(sizeof(uint8_t)*logicalSize);
+	positionMaps[structureId] = (unsigned int*)malloc(sizeof(unsigned int)*logicalSize);
+	freeLists[structureId] = (int*)malloc(sizeof(int)*logicalSize);
+	freeListSizes[structureId] = header.freeListSize;
+	revNum[structureId] = (int*)malloc(sizeof(int)*logicalSize);
+	Oram_Block* stashBlocks = (Oram_Block*)malloc((header.stashOcc+1)*sizeof(Oram_Block));
+	int ret = 0;
+	if(!bPlusRoots[structureId] || !usedBlocks[structureId] || !positionMaps[structureId] || !freeLists[structureId] || !revNum[structureId] || !stashBlocks) ret = 1;
+	if(ret == 0 && (initIvCounter(structureId) || initStash(structureId) || initScratchArena(structureId, TYPE_TREE_ORAM))) ret = 1;
+	if(ret == 0) ret = readSnapshotSection(structureId, &header, 0, bPlusRoots[structureId], sizeof(node));
+	if(ret == 0) ret = readSnapshotSection(structureId, &header, 1, usedBlocks[structureId], sizeof(uint8_t)*logicalSize);
+	if(ret == 0) ret = readSnapshotSection(structureId, &header, 2, positionMaps[structureId], sizeof(unsigned int)*logicalSize);
+	if(ret == 0) ret = readSnapshotSection(structureId, &header, 3, freeLists[structureId], sizeof(int)*header.freeListSize);
+	if(ret == 0) ret = readSnapshotSection(structureId, &header, 4, stashBlocks, sizeof(Oram_Block)*header.stashOcc);
+	if(ret == 0) ret = readSnapshotSection(structureId, &header, 5, revNum[structureId], sizeof(int)*logicalSize);
+	for(int i = 0; i < header.stashOcc && ret == 0; i++){
+		if(stashInsert(structureId, &stashBlocks[i], positionMaps[structureId][stashBlocks[i].actualAddr]) == -1) ret = 1;
+	}
+	free(stashBlocks);
+	if(ret == 0){
+		blockDataSizes[structureId] = BLOCK_DATA_SIZE;
+		storageTypes[structureId] = header.storage;
+		ocall_newStructure(structureId, TYPE_TREE_ORAM, header.size, storedBlockSize(structureId), header.storage);
+		ocall_read_structure(&ret, structureId);
+		if(ret) printf("saved table file is truncated\n");
+		else ret = initTreeTop(structureId);
+	}
+	if(ret){
+		free_structure(structureId);
+		return 1;
+	}
 	tableNames[structureId] = (char*)malloc(20);
 	ocall_make_name(tableNames[structureId], tableSize);
-	//printf("here %s\n", tableNames[structureId]);
-	ocall_read_file(&oblivStructureSizes[structureId], 4);
-	ocall_read_file(&oblivStructureTypes[structureId], 4);
-	ocall_read_file(&schemas[structureId], sizeof(Schema));
-	ocall_read_file(&rowsPerBlock[structureId], 4);
-	ocall_read_file(&numRows[structureId], 4);
-	ocall_read_file(&stashOccs[structureId], 4);
-	ocall_read_file(&logicalSizes[structureId], 4); //printf("s %d, o %d, logical size: %d, size of node %d, uint8 %d", stashOccs[structureId], oblivStructureSizes[structureId], logicalSizes[structureId], sizeof(node), sizeof(uint8_t));
-	bPlusRoots[structureId] = (node*)malloc(sizeof(node));//printf("here");
-	usedBlocks[structureId] = (uint8_t*)malloc(sizeof(uint8_t)*logicalSizes[structureId]);
-	positionMaps[structureId] = (unsigned int*)malloc(sizeof(unsigned int)*logicalSizes[structureId]);
-	stashes[structureId] = new std::list<Oram_Block>();
-	ocall_read_file(bPlusRoots[structureId], sizeof(node));
-	ocall_read_file(usedBlocks[structureId], sizeof(uint8_t)*logicalSizes[structureId]);
-	ocall_read_file(positionMaps[structureId], sizeof(unsigned int)*logicalSizes[structureId]);
-	for(int i = 0; i < stashOccs[structureId]; i++){
-		ocall_read_file(&block[0], sizeof(Oram_Block));
-		stashes[structureId]->push_front(*block);
-	}
-	//ocall_read_file(&stashes[structureId][0], sizeof(Oram_Block)*stashOccs[structureId]);
-	//printf("here %d %d %d %d %d\n", oblivStructureSizes[structureId], rowsPerBlock[structureId], logicalSizes[structureId], numRows[structureId], stashOccs[structureId]);
-	ocall_newStructure(structureId, TYPE_TREE_ORAM, oblivStructureSizes[structureId]);
-	for(int i = 0; i < logicalSizes[structureId]; i++){
-		//printf("here1 %d %d %d", i, sizeof(Oram_Bucket), sizeof(Encrypted_Oram_Bucket));
-		ocall_read_file(&bucket[0], sizeof(Oram_Bucket));
-		//printf("here2 %d %d %d", i, bucket->blocks[0].actualAddr, bucket->blocks[0].data[0]);
-		if(encryptBlock(encBucket, bucket, obliv_key, TYPE_ORAM) != 0) return 1;
-		//printf("here3 %d", i);
-		ocall_write_block(structureId, i, sizeof(Encrypted_Oram_Bucket), encBucket);
-		//printf("here4 %d\n", i);
+	memcpy(&schemas[structureId], &header.schema, sizeof(Schema));
+	rowsPerBlock[structureId] = header.rowsPerBlock;
+	numRows[structureId] = header.numRows;
+	memset(&header, 0, sizeof(Saved_Table_Header));
+	return 0;
+}
+
+//hashes the version array of a linear table, the sealed header of a saved table keeps this
+int hashRevNums(int* revNums, int size, sgx_sha256_hash_t* hash){
+	sgx_sha_state_handle_t sha = NULL;
+	if(sgx_sha256_init(&sha) != SGX_SUCCESS) return 1;
+	int ret = 0;
+	for(int i = 0; i < size && ret == 0; i += SAVE_CHUNK_INTS){
+		int n = (size-i < SAVE_CHUNK_INTS) ? size-i : SAVE_CHUNK_INTS;
+		if(sgx_sha256_update((uint8_t*)&revNums[i], n*sizeof(int), sha) != SGX_SUCCESS) ret = 1;
+	}
+	if(ret == 0 && sgx_sha256_get_hash(sha, hash) != SGX_SUCCESS) ret = 1;
+	sgx_sha256_close(sha);
+	return ret;
+}
+
+//writes a linear table to testTable<fileId>: a sealed header, the version array, then the encrypted blocks as they are
+//the blocks go straight from the app's copy to the file and are never decrypted. a snapshot already saved under fileId is replaced
+int saveTable(char* tableName, int fileId){
+	int structureId = getTableId(tableName);
+	if(structureId == -1 || oblivStructureTypes[structureId] != TYPE_LINEAR_SCAN){
+		printf("only linear scan tables can be saved with saveTable\n");
+		return 1;
+	}
+	if(numColumnGroups[structureId] > 0){
+		printf("tables split into column groups can't be saved yet\n");
+		return 1;
+	}
+	Saved_Table_Header header;
+	if(writeUnwrittenBlocks(structureId)) return 1;
+	if(fillTableHeader(structureId, &header)) return 1;
+	int blocks = storedBlocks(structureId);
+	if(hashRevNums(revNum[structureId], blocks, &header.revNumHash)) return 1;
+	ocall_open_write(fileId);
+	int ret = writeTableHeader(&header, fileId);
+	memset(&header, 0, sizeof(Saved_Table_Header));
+	if(ret) return 1;
+	for(int i = 0; i < blocks; i += SAVE_CHUNK_INTS){
+		int n = (blocks-i < SAVE_CHUNK_INTS) ? blocks-i : SAVE_CHUNK_INTS;
+		ocall_write_file(&revNum[structureId][i], n*sizeof(int), fileId);
+	}
+	ocall_write_structure(structureId, fileId);
+	return 0;
+}
+
+//opens a file written by saveTable as tableName, the blocks are streamed into the app's storage without re-encryption
+//they stay under the key they were saved with, which only this enclave can unseal. as with loadIndexTable, a table
+//kept in a mapped file gets that file back without a copy
+int loadTable(char* tableName, int fileId){
+	if(getTableId(tableName) != -1) return 1;
+	int structureId = getNextId();
+	if(structureId == -1) return 1;
+	ocall_open_read(fileId);
+	Saved_Table_Header header;
+	if(readTableHeader(&header, TYPE_LINEAR_SCAN)) return 1;
+	int rpb = header.rowsPerBlock;
+	if(header.blockSize <= 0 || header.blockSize > BLOCK_DATA_SIZE || rpb <= 0 || rpb > SCAN_BATCH_SIZE
+			|| (rpb & (rpb-1)) != 0 || header.size%rpb != 0 || header.blockSize/rpb == 0){
+		printf("AUTHENTICITY FAILURE: saved table header is inconsistent\n");
+		return 1;
+	}
+
+	int size = header.size;
+	int blocks = size/rpb;
+	revNum[structureId] = (int*)malloc(blocks*sizeof(int));
+	oblivKeys[structureId] = (sgx_aes_gcm_128bit_key_t*)malloc(sizeof(sgx_aes_gcm_128bit_key_t));
+	if(revNum[structureId] == NULL || oblivKeys[structureId] == NULL){
+		free(revNum[structureId]);
+		free(oblivKeys[structureId]);
+		revNum[structureId] = NULL;
+		oblivKeys[structureId] = NULL;
+		return 1;
+	}
+	memcpy(oblivKeys[structureId], &header.key, sizeof(sgx_aes_gcm_128bit_key_t));
+	for(int i = 0; i < blocks; i += SAVE_CHUNK_INTS){
+		int n = (blocks-i < SAVE_CHUNK_INTS) ? blocks-i : SAVE_CHUNK_INTS;
+		ocall_read_file(&revNum[structureId][i], n*sizeof(int));
+	}
+	sgx_sha256_hash_t hash;
+	int ret = hashRevNums(revNum[structureId], blocks, &hash);
+	if(ret == 0 && memcmp(hash, header.revNumHash, sizeof(sgx_sha256_hash_t)) != 0){
+		printf("AUTHENTICITY FAILURE: saved table versions do not match its header\n");
+		ret = 1;
+	}
+	if(ret){
+		free(revNum[structureId]);
+		free(oblivKeys[structureId]);
+		revNum[structureId] = NULL;
+		oblivKeys[structureId] = NULL;
+		return 1;
+	}
+
+	logicalSizes[structureId] = size;
+	posMapIds[structureId] = -1;
+	oblivStructureSizes[structureId] = size;
+	oblivStructureTypes[structureId] = TYPE_LINEAR_SCAN;
+	blockDataSizes[structureId] = header.blockSize;
+	rowsPerBlock[structureId] = rpb;
+	if(initIvCounter(structureId) || initScratchArena(structureId, TYPE_LINEAR_SCAN)){
+		free_structure(structureId);
+		return 1;
+	}
+	storageTypes[structureId] = header.storage;
+	ocall_newStructure(structureId, TYPE_LINEAR_SCAN, blocks, storedBlockSize(structureId), header.storage);
+	ocall_read_structure(&ret, structureId);
+	if(ret){
+		printf("saved table file is truncated\n");
+		free_structure(structureId);
+		return 1;
 	}
+
+	int nameLen = strlen(tableName);
+	tableNames[structureId] = (char*)malloc(nameLen+1);
+	strncpy(tableNames[structureId], tableName, nameLen+1);
+	memcpy(&schemas[structureId], &header.schema, sizeof(Schema));
+	numRows[structureId] = header.numRows;
+	lastInserted[structureId] = header.lastInserted;
+	memset(&header, 0, sizeof(Saved_Table_Header));
 	return 0;
 }
+
+//first record under node j of level h of a bulk loaded tree
+int bulkLoadFirstRecord(Bulk_Load_Layout* layout, int h, int j){
+	for(; h > 0; h--){
+		j = (long long)j*layout->levelCount[h-1]/layout->levelCount[h];
+	}
+	return (long long)j*layout->numRecords/layout->levelCount[0];
+}
+
+//builds block number blockNum of a bulk loaded tree: records come first, then each level of nodes from the leaves up
+int bulkLoadBlock(int structureId, Bulk_Load_Layout* layout, int blockNum, Oram_Block* block){
+	if(blockNum < layout->numRecords){
+		if(opOneLinearScanBlock(layout->sourceId, layout->rowIndex[blockNum], (Linear_Scan_Block*)block->data, 0)) return 1;
+		if(layout->clearTail) memset(&block->data[BLOCK_DATA_SIZE-8], 0, 8);
+		block->actualAddr = blockNum;
+		block->revNum = 1;
+		return 0;
+	}
+	int h = 0;
+	while(blockNum >= layout->levelStart[h]+layout->levelCount[h]) h++;
+	int j = blockNum - layout->levelStart[h];
+	node* n = (node*)block;
+	memset(n, 0, sizeof(node));
+	for(int i = 0; i < MAX_ORDER; i++) n->pointers[i] = -1;
+	n->actualAddr = blockNum;
+	n->is_leaf = (h == 0);
+	n->is_root = (h == layout->numLevels-1);
+	if(h == 0){
+		int first = bulkLoadFirstRecord(layout, 0, j);
+		n->num_keys = bulkLoadFirstRecord(layout, 0, j+1) - first;
+		for(int i = 0; i < n->num_keys; i++){
+			n->keys[i] = layout->keys[first+i];
+			n->pointers[i] = first+i;
+		}
+		if(j+1 < layout->levelCount[0]) n->pointers[MAX_ORDER-1] = layout->levelStart[0]+j+1;
+	}
+	else{
+		int firstChild = (long long)j*layout->levelCount[h-1]/layout->levelCount[h];
+		int numChildren = (long long)(j+1)*layout->levelCount[h-1]/layout->levelCount[h] - firstChild;
+		for(int i = 0; i < numChildren; i++){
+			n->pointers[i] = layout->levelStart[h-1]+firstChild+i;
+			if(i > 0) n->keys[i-1] = layout->keys[bulkLoadFirstRecord(layout, h-1, firstChild+i)];
+		}
+		n->num_keys = numChildren-1;
+	}
+	block->revNum = 1;
+	return 0;
+}
+
+//builds the b+ tree of an empty index table from the rows of a linear scan table in one pass over the oram
+//rows must be sorted by keyCol unless presorted is 0, in which case they are bitonic sorted into a staging table first
+//nodes are filled to fillPercent of MAX_ORDER
+int bulkLoadIndexTable(char* tableName, char* sourceTableName, int keyCol, int fillPercent, int presorted){
+	int structureId = getTableId(tableName);
+	int sourceId = getTableId(sourceTableName);
+	if(structureId == -1 || sourceId == -1) return 1;
+	if(oblivStructureTypes[structureId] != TYPE_TREE_ORAM || oblivStructureTypes[sourceId] != TYPE_LINEAR_SCAN) return 1;
+	if(numRows[structureId] != 0 || bPlusRoots[structureId] != NULL){
+		printf("bulk load needs an empty index table\n");
+		return 1;
+	}
+	if(posMapIds[structureId] != -1){
+		printf("bulk loading tables with recursive position maps is not supported\n");
+		return 1;
+	}
+	if(keyCol < 0 || keyCol >= schemas[sourceId].numFields || schemas[sourceId].fieldTypes[keyCol] != INTEGER) return 1;
+	if(fillPercent <= 0 || fillPercent > 100) fillPercent = 100;
+	int keyOffset = schemas[sourceId].fieldOffsets[keyCol];
+	int sourceSize = oblivStructureSizes[sourceId];
+	uint8_t* batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
+
+	Bulk_Load_Layout layout;
+	layout.sourceId = sourceId;
+	layout.clearTail = 0;
+	int stagingId = -1;
+	char* stagingName = "BulkLoadSort";
+	if(!presorted){
+		if(getRowSize(&schemas[sourceId]) > BLOCK_DATA_SIZE-8){
+			printf("rows are too wide to sort for bulk load, load them presorted\n");
+			free(batch);
+			return 1;
+		}
+		//same layout the sort-merge join uses: key in the last 8 bytes, empty rows sort to the end
+		createTable(&schemas[sourceId], stagingName, strlen(stagingName), TYPE_LINEAR_SCAN, sourceSize, &stagingId);
+		for(int i = 0; i < sourceSize; i+=SCAN_BATCH_SIZE){
+			int n = (sourceSize-i < SCAN_BATCH_SIZE) ? sourceSize-i : SCAN_BATCH_SIZE;
+			opLinearScanBlocks(sourceId, i, n, (Linear_Scan_Block*)batch, 0);
+			for(int j = 0; j < n; j++){
+				uint8_t* slot = &batch[j*BLOCK_DATA_SIZE];
+				int empty = (slot[0] == '\0');
+				int key = 0x7fffffff;
+				if(!empty) memcpy(&key, &slot[keyOffset], 4);
+				memset(&slot[BLOCK_DATA_SIZE-4], 1+empty, 4);
+				memcpy(&slot[BLOCK_DATA_SIZE-8], &key, 4);
+			}
+			opLinearScanBlocks(stagingId, i, n, (Linear_Scan_Block*)batch, 1);
+		}
+		uint8_t* row1 = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+		uint8_t* row2 = (uint8_t*)malloc(BLOCK_DATA_SIZE);
+		bitonicSort(stagingId, 0, sourceSize, 0, row1, row2);
+		free(row1);
+		free(row2);
+		layout.sourceId = stagingId;
+		layout.clearTail = 1;
+	}
+
+	//collect keys in order, skipping empty rows
+	layout.keys = (int*)malloc(sourceSize*sizeof(int));
+	layout.rowIndex = (int*)malloc(sourceSize*sizeof(int));
+	int numRecords = 0;
+	int ret = 0;
+	for(int i = 0; i < sourceSize && ret == 0; i+=SCAN_BATCH_SIZE){
+		int n = (sourceSize-i < SCAN_BATCH_SIZE) ? sourceSize-i : SCAN_BATCH_SIZE;
+		opLinearScanBlocks(layout.sourceId, i, n, (Linear_Scan_Block*)batch, 0);
+		for(int j = 0; j < n; j++){
+			uint8_t* slot = &batch[j*BLOCK_DATA_SIZE];
+			if(slot[0] == '\0') continue;
+			memcpy(&layout.keys[numRecords], &slot[keyOffset], 4);
+			if(numRecords > 0 && layout.keys[numRecords] < layout.keys[numRecords-1]){
+				printf("rows are not sorted by key, bulk load them with presorted = 0\n");
+				ret = 1;
+				break;
+			}
+			layout.rowIndex[numRecords++] = i+j;
+		}
+	}
+	free(batch);
+	layout.numRecords = numRecords;
+
+	//shape of the tree, every node on a level gets the same number of entries give or take one
+	int leafFill = (MAX_ORDER-1)*fillPercent/100;
+	int nodeFill = MAX_ORDER*fillPercent/100;
+	if(leafFill < 1) leafFill = 1;
+	if(nodeFill < 3) nodeFill = 3;
+	int numBlocks = numRecords;
+	layout.numLevels = 0;
+	int count = (numRecords+leafFill-1)/leafFill;
+	while(ret == 0 && numRecords > 0){
+		layout.levelStart[layout.numLevels] = numBlocks;
+		layout.levelCount[layout.numLevels] = count;
+		layout.numLevels++;
+		numBlocks += count;
+		if(count == 1) break;
+		count = (count+nodeFill-1)/nodeFill;
+	}
+	int treeSize = logicalSizes[structureId];
+	if(ret == 0 && numBlocks > treeSize){
+		printf("table too small for bulk load: %d blocks needed, %d available\n", numBlocks, treeSize);
+		ret = 1;
+	}
+	if(ret != 0 || numRecords == 0){
+		free(layout.keys);
+		free(layout.rowIndex);
+		if(stagingId != -1) deleteTable(stagingName);
+		return ret;
+	}
+
+	//each block goes in the deepest bucket with room on the path to its leaf, which is where eviction would put it
+	//the few that don't fit go to the stash
+	uint8_t* bucketFill = (uint8_t*)malloc(treeSize);
+	int* bucketOf = (int*)malloc(numBlocks*sizeof(int));
+	int* bucketStarts = (int*)malloc((treeSize+1)*sizeof(int));
+	int* members = (int*)malloc(numBlocks*sizeof(int));
+	memset(bucketFill, 0, treeSize);
+	for(int b = 0; b < numBlocks; b++){
+		int bucketNum = treeSize/2 + positionMaps[structureId][b];
+		while(bucketNum > 0 && bucketFill[bucketNum] == BUCKET_SIZE) bucketNum = (bucketNum-1)/2;
+		if(bucketFill[bucketNum] == BUCKET_SIZE) bucketNum = -1;
+		else bucketFill[bucketNum]++;
+		bucketOf[b] = bucketNum;
+	}
+	bucketStarts[0] = 0;
+	for(int i = 0; i < treeSize; i++){
+		bucketStarts[i+1] = bucketStarts[i] + bucketFill[i];
+		bucketFill[i] = 0;
+	}
+	for(int b = 0; b < numBlocks; b++){
+		if(bucketOf[b] != -1) members[bucketStarts[bucketOf[b]] + bucketFill[bucketOf[b]]++] = b;
+	}
+	free(bucketFill);
+
+	//write every bucket once, in order, a batch of them encrypted per call
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	int encBucketSize = sizeof(Encrypted_Oram_Bucket);
+	Oram_Bucket* plainBatch = (Oram_Bucket*)malloc(SCAN_BATCH_SIZE*sizeof(Oram_Bucket));
+	Encrypted_Oram_Bucket* encBatch = (Encrypted_Oram_Bucket*)malloc(SCAN_BATCH_SIZE*encBucketSize);
+	for(int start = 0; start < treeSize && ret == 0; start += SCAN_BATCH_SIZE){
+		int n = (treeSize-start < SCAN_BATCH_SIZE) ? treeSize-start : SCAN_BATCH_SIZE;
+		for(int j = 0; j < n && ret == 0; j++){
+			int bucketNum = start+j;
+			Oram_Bucket* bucket = &plainBatch[j];
+			memcpy(bucket, arena->junk, sizeof(Oram_Bucket));
+			for(int k = bucketStarts[bucketNum]; k < bucketStarts[bucketNum+1]; k++){
+				int b = members[k];
+				if(bulkLoadBlock(structureId, &layout, b, &bucket->blocks[k-bucketStarts[bucketNum]])) ret = 1;
+				bucket->leaves[k-bucketStarts[bucketNum]] = positionMaps[structureId][b];
+			}
+		}
+		if(ret == 0 && encryptBlocks(structureId, encBatch, plainBatch, n, oblivKeys[structureId], TYPE_ORAM) != 0) ret = 1;
+		if(ret == 0) ocall_write_blocks(structureId, start, n, encBucketSize, encBatch);
+		markWritten(structureId, start, n);
+	}
+	//the top buckets were just replaced under the tree-top cache
+	freeTreeTop(structureId);
+	if(ret == 0 && initTreeTop(structureId)) ret = 1;
+	for(int b = 0; b < numBlocks && ret == 0; b++){
+		if(bucketOf[b] != -1) continue;
+		if(bulkLoadBlock(structureId, &layout, b, arena->block)) ret = 1;
+		else if(stashInsert(structureId, arena->block, positionMaps[structureId][b]) == -1) ret = 1;
+	}
+	free(plainBatch);
+	free(encBatch);
+	free(bucketOf);
+	free(bucketStarts);
+	free(members);
+
+	if(ret == 0){
+		for(int b = 0; b < numBlocks; b++){
+			usedBlocks[structureId][b] = 1;
+			revNum[structureId][b] = 1;
+		}
+		rebuildFreeList(structureId);
+		bPlusRoots[structureId] = (node*)malloc(sizeof(node));
+		ret = bulkLoadBlock(structureId, &layout, numBlocks-1, (Oram_Block*)bPlusRoots[structureId]);
+		numRows[structureId] = numRecords;
+	}
+	free(layout.keys);
+	free(layout.rowIndex);
+	if(stagingId != -1) deleteTable(stagingName);
+	return ret;
+}
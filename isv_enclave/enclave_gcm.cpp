@@ -0,0 +1,229 @@
+#include "definitions.h"
+#include "isv_enclave.h"
+
+//aes-128-gcm over a batch of blocks, GCM_LANES of them side by side so their aes rounds and ghash multiplies
+//overlap in the pipeline instead of each block waiting on its own previous step. the output is plain gcm with a
+//12 byte iv and no aad, the same as sgx_rijndael128GCM, so a block written one way reads back the other way.
+//every cpu with sgx has aes-ni and pclmulqdq. the enclave builds with -nostdinc, which leaves out the intrinsics
+//headers, so this uses the gcc builtins they wrap
+#define GCM_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+typedef long long gcm_v2di __attribute__((vector_size(16)));
+typedef int gcm_v4si __attribute__((vector_size(16)));
+typedef unsigned int gcm_v4su __attribute__((vector_size(16)));
+typedef char gcm_v16qi __attribute__((vector_size(16)));
+
+#define GCM_EXPAND_KEY(k, i, rcon) do { \
+	gcm_v2di assist = (gcm_v2di)__builtin_ia32_pshufd((gcm_v4si)__builtin_ia32_aeskeygenassist128(k[i-1], rcon), 0xff); \
+	gcm_v2di prev = k[i-1]; \
+	prev ^= __builtin_ia32_pslldqi128(prev, 32); \
+	prev ^= __builtin_ia32_pslldqi128(prev, 32); \
+	prev ^= __builtin_ia32_pslldqi128(prev, 32); \
+	k[i] = prev ^ assist; \
+} while(0)
+
+GCM_TARGET static void gcmExpandKey(const sgx_aes_gcm_128bit_key_t *key, gcm_v2di* roundKeys){
+	memcpy(&roundKeys[0], key, 16);
+	GCM_EXPAND_KEY(roundKeys, 1, 0x01);
+	GCM_EXPAND_KEY(roundKeys, 2, 0x02);
+	GCM_EXPAND_KEY(roundKeys, 3, 0x04);
+	GCM_EXPAND_KEY(roundKeys, 4, 0x08);
+	GCM_EXPAND_KEY(roundKeys, 5, 0x10);
+	GCM_EXPAND_KEY(roundKeys, 6, 0x20);
+	GCM_EXPAND_KEY(roundKeys, 7, 0x40);
+	GCM_EXPAND_KEY(roundKeys, 8, 0x80);
+	GCM_EXPAND_KEY(roundKeys, 9, 0x1b);
+	GCM_EXPAND_KEY(roundKeys, 10, 0x36);
+}
+
+//ghash works on bit reflected values, reversing the bytes lets pclmulqdq do the multiply
+GCM_TARGET static inline gcm_v2di gcmReverse(gcm_v2di v){
+	const gcm_v16qi order = {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0};
+	return (gcm_v2di)__builtin_ia32_pshufb128((gcm_v16qi)v, order);
+}
+
+//folds the upper half of a 256 bit product back in, modulo x^128 + x^7 + x^2 + x + 1
+GCM_TARGET static inline gcm_v2di gcmReduce(gcm_v2di lo, gcm_v2di mid, gcm_v2di hi){
+	const gcm_v2di poly = {1, (long long)0xc200000000000000ULL};
+	lo ^= __builtin_ia32_pslldqi128(mid, 64);
+	hi ^= __builtin_ia32_psrldqi128(mid, 64);
+	lo = (gcm_v2di)__builtin_ia32_pshufd((gcm_v4si)lo, 0x4e) ^ __builtin_ia32_pclmulqdq128(lo, poly, 0x10);
+	lo = (gcm_v2di)__builtin_ia32_pshufd((gcm_v4si)lo, 0x4e) ^ __builtin_ia32_pclmulqdq128(lo, poly, 0x10);
+	return hi ^ lo;
+}
+
+//a*h in GF(2^128) on byte reversed values, h as gcmHashKey leaves it
+GCM_TARGET static inline gcm_v2di gcmMul(gcm_v2di a, gcm_v2di h){
+	return gcmReduce(__builtin_ia32_pclmulqdq128(a, h, 0x00),
+			__builtin_ia32_pclmulqdq128(a, h, 0x10) ^ __builtin_ia32_pclmulqdq128(a, h, 0x01),
+			__builtin_ia32_pclmulqdq128(a, h, 0x11));
+}
+
+//byte reverses H and divides it by x, which saves shifting every product left by one bit to line it up
+GCM_TARGET static gcm_v2di gcmHashKey(const gcm_v2di* roundKeys){
+	gcm_v2di h = roundKeys[0];
+	for(int r = 1; r < 10; r++) h = __builtin_ia32_aesenc128(h, roundKeys[r]);
+	h = gcmReverse(__builtin_ia32_aesenclast128(h, roundKeys[10]));
+	unsigned long long low = h[0], high = h[1];
+	gcm_v2di shifted = {(long long)(low << 1), (long long)((high << 1) | (low >> 63))};
+	if(high >> 63){
+		gcm_v2di poly = {1, (long long)0xc200000000000000ULL};
+		shifted ^= poly;
+	}
+	return shifted;
+}
+
+//repeats a step for every lane. the steps of lanes past the ones in use drop out once lanes is a constant, and
+//the rest end up as straight line code the cpu can overlap, where a loop over the lanes would keep them in memory
+#define GCM_EACH_LANE(step) step(0) step(1) step(2) step(3) step(4) step(5) step(6) step(7)
+#if GCM_LANES > 8
+#error "GCM_EACH_LANE only covers 8 lanes"
+#endif
+
+#define GCM_LANE_COUNTER(l) if(l < lanes) state[l] = base[l] | (gcm_v2di)word;
+#define GCM_LANE_WHITEN(l) if(l < lanes) state[l] ^= roundKeys[0];
+#define GCM_LANE_ROUND(l) if(l < lanes) state[l] = __builtin_ia32_aesenc128(state[l], roundKey);
+#define GCM_LANE_LAST(l) if(l < lanes) state[l] = __builtin_ia32_aesenclast128(state[l], roundKeys[10]);
+#define GCM_LANE_DATA(l) if(l < lanes){ \
+	gcm_v2di data, result; \
+	memcpy(&data, &in[l][offset], 16); \
+	result = data ^ state[l]; \
+	memcpy(&out[l][offset], &result, 16); \
+	hash[l] = gcmMul(hash[l] ^ gcmReverse(encrypt ? result : data), hashKey); \
+}
+
+//aes on one counter block per lane, a round of every lane before the next round
+#define GCM_AES_LANES() do { \
+	gcm_v2di roundKey; \
+	GCM_EACH_LANE(GCM_LANE_WHITEN) \
+	for(int r = 1; r < 10; r++){ \
+		roundKey = roundKeys[r]; \
+		GCM_EACH_LANE(GCM_LANE_ROUND) \
+	} \
+	GCM_EACH_LANE(GCM_LANE_LAST) \
+} while(0)
+
+//runs up to GCM_LANES blocks of len bytes through gcm together and leaves each one's tag in tags. the ghash is
+//taken over the ciphertext, which is out when encrypting and in when decrypting. always inlined so every call
+//gets lanes as a constant
+GCM_TARGET static inline __attribute__((always_inline)) void gcmLanes(const gcm_v2di* roundKeys, gcm_v2di hashKey,
+		int lanes, int len, int encrypt, const uint8_t** in, uint8_t** out, const uint8_t** ivs, gcm_v2di* tags){
+	gcm_v2di base[GCM_LANES], state[GCM_LANES], hash[GCM_LANES];
+	uint8_t pad[16];
+	for(int l = 0; l < lanes; l++){
+		memset(pad, 0, 16);
+		memcpy(pad, ivs[l], 12);
+		memcpy(&base[l], pad, 16);
+		hash[l] = (gcm_v2di){0, 0};
+	}
+	//counter 1 masks the tag, the data starts at counter 2
+	gcm_v4su word = {0, 0, 0, __builtin_bswap32(1)};
+	GCM_EACH_LANE(GCM_LANE_COUNTER)
+	GCM_AES_LANES();
+	for(int l = 0; l < lanes; l++) tags[l] = state[l];
+	int offset = 0;
+	for(int counter = 2; offset + 16 <= len; offset += 16, counter++){
+		word[3] = __builtin_bswap32(counter);
+		GCM_EACH_LANE(GCM_LANE_COUNTER)
+		GCM_AES_LANES();
+		GCM_EACH_LANE(GCM_LANE_DATA)
+	}
+	if(offset < len){
+		//the last piece is padded with zeros for the ghash
+		int n = len - offset;
+		word[3] = __builtin_bswap32(2 + offset/16);
+		GCM_EACH_LANE(GCM_LANE_COUNTER)
+		GCM_AES_LANES();
+		for(int l = 0; l < lanes; l++){
+			gcm_v2di data, result;
+			memset(pad, 0, 16);
+			memcpy(pad, &in[l][offset], n);
+			memcpy(&data, pad, 16);
+			result = data ^ state[l];
+			memcpy(pad, &result, 16);
+			memset(&pad[n], 0, 16 - n);
+			memcpy(&result, pad, 16);
+			memcpy(&out[l][offset], pad, n);
+			hash[l] = gcmMul(hash[l] ^ gcmReverse(encrypt ? result : data), hashKey);
+		}
+	}
+	//the length block, no aad then the ciphertext length in bits, already in reversed byte order
+	gcm_v2di lengths = {(long long)len*8, 0};
+	for(int l = 0; l < lanes; l++){
+		tags[l] ^= gcmReverse(gcmMul(hash[l] ^ lengths, hashKey));
+	}
+	memset(state, 0, sizeof(state));
+}
+
+//a full group of GCM_LANES blocks, or what is left at the end of a batch in groups of 4, 2 and 1
+GCM_TARGET static void gcmGroup(const gcm_v2di* roundKeys, gcm_v2di hashKey, int lanes, int len, int encrypt,
+		const uint8_t** in, uint8_t** out, const uint8_t** ivs, gcm_v2di* tags){
+	if(lanes == GCM_LANES){
+		gcmLanes(roundKeys, hashKey, GCM_LANES, len, encrypt, in, out, ivs, tags);
+		return;
+	}
+	for(int done = 0; done < lanes; ){
+		int n = (lanes - done >= 4) ? 4 : (lanes - done >= 2) ? 2 : 1;
+		if(n == 4) gcmLanes(roundKeys, hashKey, 4, len, encrypt, &in[done], &out[done], &ivs[done], &tags[done]);
+		else if(n == 2) gcmLanes(roundKeys, hashKey, 2, len, encrypt, &in[done], &out[done], &ivs[done], &tags[done]);
+		else gcmLanes(roundKeys, hashKey, 1, len, encrypt, &in[done], &out[done], &ivs[done], &tags[done]);
+		done += n;
+	}
+}
+
+//encrypts numBlocks plaintexts of len bytes, ptStride bytes apart, into encrypted blocks encStride bytes apart that
+//are laid out as ciphertext[len], macTag[16], iv[12]. the ivs have to be written already
+GCM_TARGET int gcmEncryptBlocks(const sgx_aes_gcm_128bit_key_t *key, const uint8_t *pt, int ptStride, uint8_t *enc, int encStride, int len, int numBlocks){
+	gcm_v2di roundKeys[11], hashKey = {0, 0}, tags[GCM_LANES];
+	const uint8_t* in[GCM_LANES];
+	const uint8_t* ivs[GCM_LANES];
+	uint8_t* out[GCM_LANES];
+	gcmExpandKey(key, roundKeys);
+	hashKey = gcmHashKey(roundKeys);
+	for(int i = 0; i < numBlocks; i += GCM_LANES){
+		int lanes = (numBlocks - i < GCM_LANES) ? numBlocks - i : GCM_LANES;
+		for(int l = 0; l < lanes; l++){
+			in[l] = &pt[(long)(i+l)*ptStride];
+			out[l] = &enc[(long)(i+l)*encStride];
+			ivs[l] = &out[l][len+16];
+		}
+		gcmGroup(roundKeys, hashKey, lanes, len, 1, in, out, ivs, tags);
+		for(int l = 0; l < lanes; l++) memcpy(&out[l][len], &tags[l], 16);
+	}
+	memset(roundKeys, 0, sizeof(roundKeys));
+	memset(&hashKey, 0, sizeof(hashKey));
+	return 0;
+}
+
+//decrypts numBlocks blocks laid out as gcmEncryptBlocks writes them. returns 1 if any tag doesn't match, with
+//that block's plaintext zeroed
+GCM_TARGET int gcmDecryptBlocks(const sgx_aes_gcm_128bit_key_t *key, const uint8_t *enc, int encStride, uint8_t *pt, int ptStride, int len, int numBlocks){
+	gcm_v2di roundKeys[11], hashKey = {0, 0}, tags[GCM_LANES];
+	const uint8_t* in[GCM_LANES];
+	const uint8_t* ivs[GCM_LANES];
+	uint8_t* out[GCM_LANES];
+	int failed = 0;
+	gcmExpandKey(key, roundKeys);
+	hashKey = gcmHashKey(roundKeys);
+	for(int i = 0; i < numBlocks && !failed; i += GCM_LANES){
+		int lanes = (numBlocks - i < GCM_LANES) ? numBlocks - i : GCM_LANES;
+		for(int l = 0; l < lanes; l++){
+			in[l] = &enc[(long)(i+l)*encStride];
+			out[l] = &pt[(long)(i+l)*ptStride];
+			ivs[l] = &in[l][len+16];
+		}
+		gcmGroup(roundKeys, hashKey, lanes, len, 0, in, out, ivs, tags);
+		for(int l = 0; l < lanes; l++){
+			gcm_v2di stored;
+			memcpy(&stored, &in[l][len], 16);
+			gcm_v2di diff = stored ^ tags[l];
+			if((diff[0] | diff[1]) != 0){
+				memset(out[l], 0, len);
+				failed = 1;
+			}
+		}
+	}
+	memset(roundKeys, 0, sizeof(roundKeys));
+	memset(&hashKey, 0, sizeof(hashKey));
+	return failed;
+}
@@ -0,0 +1,278 @@
+#include "definitions.h"
+#include "isv_enclave.h"
+
+//ring oram (Ren et al.): each bucket is RING_Z real slots and RING_S dummies, every slot encrypted on its own,
+//so an access reads a single slot per bucket instead of a whole path. the slot metadata a bucket header would
+//hold lives in the enclave next to the position map, which saves the header round trip
+int* ringSlotAddrs[NUM_STRUCTURES] = {0};//block in each slot, -1 for a dummy, RING_SLOTS per bucket
+uint16_t* ringUnread[NUM_STRUCTURES] = {0};//bit per slot not read since its bucket was last written
+uint8_t* ringReads[NUM_STRUCTURES] = {0};//slots read from each bucket since it was last written
+int ringAccessCounts[NUM_STRUCTURES] = {0};//accesses since the last eviction
+int ringEvictCounts[NUM_STRUCTURES] = {0};//evictions so far, picks the next eviction path
+
+int initRingOram(int structureId){
+	int buckets = logicalSizes[structureId];
+	ringSlotAddrs[structureId] = (int*)malloc(buckets*RING_SLOTS*sizeof(int));
+	ringUnread[structureId] = (uint16_t*)malloc(buckets*sizeof(uint16_t));
+	ringReads[structureId] = (uint8_t*)malloc(buckets*sizeof(uint8_t));
+	if(!ringSlotAddrs[structureId] || !ringUnread[structureId] || !ringReads[structureId]){
+		freeRingOram(structureId);
+		return 1;
+	}
+	//a bucket that was never written is all dummies, nothing has been read from it
+	memset(ringSlotAddrs[structureId], 0xff, buckets*RING_SLOTS*sizeof(int));
+	for(int i = 0; i < buckets; i++) ringUnread[structureId][i] = (1 << RING_SLOTS) - 1;
+	memset(ringReads[structureId], 0, buckets*sizeof(uint8_t));
+	ringAccessCounts[structureId] = 0;
+	ringEvictCounts[structureId] = 0;
+	return 0;
+}
+
+void freeRingOram(int structureId){
+	free(ringSlotAddrs[structureId]);
+	free(ringUnread[structureId]);
+	free(ringReads[structureId]);
+	ringSlotAddrs[structureId] = NULL;
+	ringUnread[structureId] = NULL;
+	ringReads[structureId] = NULL;
+	ringAccessCounts[structureId] = 0;
+	ringEvictCounts[structureId] = 0;
+}
+
+int ringRand(unsigned int bound, unsigned int* value){
+	if(sgx_read_rand((uint8_t*)value, sizeof(unsigned int)) != SGX_SUCCESS) return 1;
+	*value = *value % bound;
+	return 0;
+}
+
+//a random slot of bucket that has not been read since it was written and holds a dummy
+//there is always one: reads stop at RING_S before a reshuffle and only the block itself ever takes a real slot
+int ringPickDummy(int structureId, int bucket, int* slot){
+	int candidates[RING_SLOTS];
+	int numCandidates = 0;
+	for(int j = 0; j < RING_SLOTS; j++){
+		if(((ringUnread[structureId][bucket] >> j) & 1) && ringSlotAddrs[structureId][bucket*RING_SLOTS+j] == -1) candidates[numCandidates++] = j;
+	}
+	if(numCandidates == 0){
+		printf("ring oram bucket %d has no dummies left\n", bucket);
+		return 1;
+	}
+	unsigned int pick = 0;
+	if(ringRand(numCandidates, &pick)) return 1;
+	*slot = candidates[pick];
+	return 0;
+}
+
+//indices of what is left unread of bucket: its real blocks, padded out with unread dummies to RING_Z slots
+int ringUnreadSlots(int structureId, int bucket, int* indices){
+	int n = 0;
+	for(int j = 0; j < RING_SLOTS; j++){
+		if(((ringUnread[structureId][bucket] >> j) & 1) && ringSlotAddrs[structureId][bucket*RING_SLOTS+j] != -1) indices[n++] = bucket*RING_SLOTS+j;
+	}
+	for(int j = 0; j < RING_SLOTS && n < RING_Z; j++){
+		if(((ringUnread[structureId][bucket] >> j) & 1) && ringSlotAddrs[structureId][bucket*RING_SLOTS+j] == -1) indices[n++] = bucket*RING_SLOTS+j;
+	}
+	return n;
+}
+
+//encrypts a fresh copy of bucket from the numReal blocks at the front of the arena's ringBucket, dummies filling
+//the rest, and puts each block in a random slot. enc and indices get RING_SLOTS entries for ocall_write_slots
+int ringSealBucket(int structureId, int bucket, int numReal, Encrypted_Oram_Block* enc, int* indices){
+	Oram_Block* plain = scratchArenas[structureId].ringBucket;
+	for(int k = numReal; k < RING_SLOTS; k++){
+		memset(&plain[k], 0, sizeof(Oram_Block));
+		plain[k].actualAddr = -1;
+	}
+	int perm[RING_SLOTS];
+	for(int k = 0; k < RING_SLOTS; k++) perm[k] = k;
+	for(int k = RING_SLOTS-1; k > 0; k--){
+		unsigned int r = 0;
+		if(ringRand(k+1, &r)) return 1;
+		int t = perm[k];
+		perm[k] = perm[r];
+		perm[r] = t;
+	}
+	for(int k = 0; k < RING_SLOTS; k++){
+		indices[k] = bucket*RING_SLOTS+perm[k];
+		ringSlotAddrs[structureId][indices[k]] = plain[k].actualAddr;
+	}
+	ringUnread[structureId][bucket] = (1 << RING_SLOTS) - 1;
+	ringReads[structureId][bucket] = 0;
+	return encryptBlocks(structureId, enc, plain, RING_SLOTS, oblivKeys[structureId], TYPE_RING_ORAM);
+}
+
+//decrypts the real blocks among the n slots just read into enc, in the order of indices, into the arena's ringBucket
+//returns how many there were, or -1
+int ringOpenSlots(int structureId, Encrypted_Oram_Block* enc, int* indices, int n){
+	Oram_Block* plain = scratchArenas[structureId].ringBucket;
+	int numReal = 0;
+	for(int k = 0; k < n; k++){
+		int addr = ringSlotAddrs[structureId][indices[k]];
+		if(addr == -1) continue;
+		if(decryptBlock(&enc[k], &plain[numReal], oblivKeys[structureId], TYPE_RING_ORAM) != 0 || plain[numReal].actualAddr != addr){
+			printf("AUTHENTICITY FAILURE: ring oram slot %d did not hold block %d\n", indices[k], addr);
+			return -1;
+		}
+		numReal++;
+	}
+	return numReal;
+}
+
+//a bucket that has run out of dummies gets its real blocks back in a freshly shuffled copy
+int ringReshuffle(int structureId, int bucket){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	int encSize = sizeof(Encrypted_Oram_Block);
+	int n = ringUnreadSlots(structureId, bucket, arena->slotIndices);
+	int numReal = 0;
+	if(blockWritten(structureId, bucket)){
+		ocall_read_slots(structureId, n, encSize, arena->slotIndices, arena->encSlots);
+		numReal = ringOpenSlots(structureId, arena->encSlots, arena->slotIndices, n);
+		if(numReal == -1) return 1;
+	}
+	if(ringSealBucket(structureId, bucket, numReal, arena->encSlots, arena->slotIndices)) return 1;
+	ocall_write_slots(structureId, RING_SLOTS, encSize, arena->slotIndices, arena->encSlots);
+	markWritten(structureId, bucket, 1);
+	return 0;
+}
+
+//reads what is left of every bucket on the path to leaf into the stash and writes the path back filled
+//deepest first from the stash, the same greedy placement opOramBlock does
+int ringEvictPath(int structureId, unsigned int leaf){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Oram_Stash* stash = &stashes[structureId];
+	int encSize = sizeof(Encrypted_Oram_Block);
+	int treeSize = logicalSizes[structureId];
+	int levels = (int)log2(treeSize+1.1);
+	int n = 0;
+	for(int i = 0; i < levels; i++){
+		int bucket = pathBucket(treeSize, leaf, i);
+		if(blockWritten(structureId, bucket)) n += ringUnreadSlots(structureId, bucket, &arena->slotIndices[n]);
+	}
+	if(n > 0) ocall_read_slots(structureId, n, encSize, arena->slotIndices, arena->encSlots);
+	for(int k = 0; k < n; k += RING_Z){
+		int count = (n-k < RING_Z) ? n-k : RING_Z;
+		int numReal = ringOpenSlots(structureId, &arena->encSlots[k], &arena->slotIndices[k], count);
+		if(numReal == -1) return 1;
+		for(int j = 0; j < numReal; j++){
+			int addr = arena->ringBucket[j].actualAddr;
+			if(stashInsert(structureId, &arena->ringBucket[j], positionMaps[structureId][addr]) == -1) return 1;
+		}
+	}
+
+	for(int s = 0; s < stash->capacity; s++){
+		if(stashSlotUsed(structureId, s)) stash->depths[s] = stashDeepestLevel(treeSize, leaf, stash->leaves[s], levels);
+	}
+	int numCandidates = stashOrderByDepth(structureId, levels);
+	int nextCandidate = 0;
+	for(int i = levels-1; i >= 0; i--){
+		int placed = 0;
+		while(placed < RING_Z && nextCandidate < numCandidates && stash->depths[stash->order[nextCandidate]] >= i){
+			memcpy(&arena->ringBucket[placed], &stash->blocks[stash->order[nextCandidate]], sizeof(Oram_Block));
+			stashRemove(structureId, stash->order[nextCandidate]);
+			nextCandidate++;
+			placed++;
+		}
+		int level = levels-1-i;
+		if(ringSealBucket(structureId, pathBucket(treeSize, leaf, level), placed, &arena->encSlots[level*RING_SLOTS], &arena->slotIndices[level*RING_SLOTS])) return 1;
+	}
+	ocall_write_slots(structureId, levels*RING_SLOTS, encSize, arena->slotIndices, arena->encSlots);
+	for(int i = 0; i < levels; i++) markWritten(structureId, pathBucket(treeSize, leaf, i), 1);
+	return 0;
+}
+
+//opOramBlock for TYPE_RING_ORAM structures, same arguments and results
+//online the access reads one slot from each bucket on the block's path, in one ocall, and writes nothing;
+//the path writes are left to the eviction every RING_A accesses and to reshuffles of buckets out of dummies
+int opRingOramBlock(int structureId, int index, Oram_Block* retBlock, int write){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	Oram_Stash* stash = &stashes[structureId];
+	int blockSize = sizeof(Oram_Block);
+	int treeSize = logicalSizes[structureId];
+	int levels = (int)log2(treeSize+1.1);
+	unsigned int newLeaf = 0;
+	if(ringRand(treeSize/2+1, &newLeaf)) return 1;
+	unsigned int oldLeaf = positionMaps[structureId][index];
+	positionMaps[structureId][index] = newLeaf;
+
+	//the block's own slot where it is on the path, a random unread dummy everywhere else
+	int foundLevel = -1;
+	for(int i = 0; i < levels; i++){
+		int bucket = pathBucket(treeSize, oldLeaf, i);
+		int slot = -1;
+		for(int j = 0; j < RING_SLOTS; j++){
+			if(((ringUnread[structureId][bucket] >> j) & 1) && ringSlotAddrs[structureId][bucket*RING_SLOTS+j] == index) slot = j;
+		}
+		if(slot != -1) foundLevel = i;
+		else if(ringPickDummy(structureId, bucket, &slot)) return 1;
+		ringUnread[structureId][bucket] &= ~(1 << slot);
+		ringReads[structureId][bucket]++;
+		arena->slotIndices[i] = bucket*RING_SLOTS+slot;
+	}
+	ocall_read_slots(structureId, levels, sizeof(Encrypted_Oram_Block), arena->slotIndices, arena->encSlots);
+	if(foundLevel != -1){
+		if(ringOpenSlots(structureId, &arena->encSlots[foundLevel], &arena->slotIndices[foundLevel], 1) != 1) return 1;
+		if(stashInsert(structureId, arena->ringBucket, newLeaf) == -1) return 1;
+	}
+
+	//read/write target block from stash
+	int slot = -1;
+	for(int s = 0; s < stash->capacity; s++){
+		if(stashSlotUsed(structureId, s) && stash->blocks[s].actualAddr == index) slot = s;
+	}
+	if(slot == -1){//the desired block has not been initialized
+		if(revNum[structureId][index] != 0){
+			printf("AUTHENTICITY FAILURE: block %d is missing from its ring oram path\n", index);
+			return 1;
+		}
+		memset(arena->block, 0, blockSize);
+		arena->block->actualAddr = index;
+		slot = stashInsert(structureId, arena->block, newLeaf);
+		if(slot == -1) return 1;
+	}
+	stash->leaves[slot] = newLeaf;
+	Oram_Block* stored = &stash->blocks[slot];
+	if(write != 1 && stored->revNum != revNum[structureId][index]){
+		printf("AUTHENTICITY FAILURE: block version not as expected! Expected %d, got %d\n", revNum[structureId][index], stored->revNum);
+		return 1;
+	}
+	if(write == ORAM_POSMAP_SWAP){
+		applyPosMapSwap(stored, retBlock);
+		revNum[structureId][index]++;
+		stored->revNum = revNum[structureId][index];
+	}
+	else if(write){
+		retBlock->actualAddr = index;
+		revNum[structureId][index]++;
+		retBlock->revNum = revNum[structureId][index];
+		memcpy(stored, retBlock, blockSize);
+	}
+	else{
+		memcpy(retBlock, stored, blockSize);
+	}
+
+	if(++ringAccessCounts[structureId] == RING_A){
+		ringAccessCounts[structureId] = 0;
+		if(ringEvictPath(structureId, evictionLeaf(logicalSizes[structureId], ringEvictCounts[structureId]++))) return 1;
+	}
+	for(int i = 0; i < levels; i++){
+		int bucket = pathBucket(treeSize, oldLeaf, i);
+		if(ringReads[structureId][bucket] >= RING_S && ringReshuffle(structureId, bucket)) return 1;
+	}
+
+	if(stashOccs[structureId] > EXTRA_STASH_SPACE){
+		printf("using too much stash! %d\n", stashOccs[structureId]);
+		return 1;
+	}
+	return 0;
+}
+
+//seals buckets [start, end) empty, for when blocks are not left to lazy initialization
+int writeEmptyRingBuckets(int structureId, int start, int end){
+	Scratch_Arena* arena = &scratchArenas[structureId];
+	for(int b = start; b < end; b++){
+		if(ringSealBucket(structureId, b, 0, arena->encSlots, arena->slotIndices)) return 1;
+		ocall_write_slots(structureId, RING_SLOTS, sizeof(Encrypted_Oram_Block), arena->slotIndices, arena->encSlots);
+		markWritten(structureId, b, 1);
+	}
+	return 0;
+}
@@ -72,6 +72,31 @@ sgx_status_t testOramSafePerformance(int structNum, int queryIndex, Oram_Block*
 	return ret;
 }
 
+//encrypts and then decrypts numBlocks linear scan blocks rounds times, batchSize blocks per call, for the app to time
+sgx_status_t testBlockCryptoPerformance(int structNum, int numBlocks, int rounds, int batchSize){
+	if(batchSize < 1 || batchSize > numBlocks) batchSize = numBlocks;
+	Real_Linear_Scan_Block* plain = (Real_Linear_Scan_Block*)malloc(numBlocks*sizeof(Real_Linear_Scan_Block));
+	Encrypted_Linear_Scan_Block* enc = (Encrypted_Linear_Scan_Block*)malloc(numBlocks*sizeof(Encrypted_Linear_Scan_Block));
+	if(plain == NULL || enc == NULL){
+		free(plain);
+		free(enc);
+		return SGX_ERROR_OUT_OF_MEMORY;
+	}
+	memset(plain, 'a', numBlocks*sizeof(Real_Linear_Scan_Block));
+	int retInt = 0;
+	for(int r = 0; r < rounds && retInt == 0; r++){
+		for(int i = 0; i < numBlocks && retInt == 0; i += batchSize){
+			int n = (numBlocks-i < batchSize) ? numBlocks-i : batchSize;
+			retInt = encryptBlocks(structNum, &enc[i], &plain[i], n, obliv_key, TYPE_LINEAR_SCAN);
+			if(retInt == 0) retInt = decryptBlocks(&enc[i], &plain[i], n, obliv_key, TYPE_LINEAR_SCAN);
+		}
+	}
+	free(plain);
+	free(enc);
+	if(retInt) return SGX_ERROR_UNEXPECTED;
+	return SGX_SUCCESS;
+}
+
 sgx_status_t testOpOram(){
 	sgx_status_t ret = SGX_SUCCESS;
 	int retInt = 0;
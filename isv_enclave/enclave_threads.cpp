@@ -0,0 +1,130 @@
+#include "definitions.h"
+#include "isv_enclave.h"
+#include "sgx_thread.h"
+
+//worker pool for splitting linear scans across enclave threads
+//the app parks threads in scanWorkerLoop, then every runScan hands each of them one partition
+sgx_thread_mutex_t scanPoolLock = SGX_THREAD_MUTEX_INITIALIZER;
+sgx_thread_cond_t scanPoolWork = SGX_THREAD_COND_INITIALIZER;
+sgx_thread_cond_t scanPoolDone = SGX_THREAD_COND_INITIALIZER;
+int scanThreads = 1; //threads a scan is split across, counting the one that calls runScan
+int scanWorkers = 0; //threads parked in scanWorkerLoop
+int stopScanPool = 0;
+Scan_Job* scanJob = NULL;
+int scanParts = 0; //partitions in the current job
+int nextScanPart = 0; //next partition a worker should take
+int scanPartsLeft = 0; //partitions handed to workers that are not finished yet
+Scan_Partition scanPartitions[MAX_SCAN_THREADS];
+
+int initScanPartition(Scan_Partition* part){
+	if(part->batch != NULL) return 0;
+	part->batch = (uint8_t*)malloc(SCAN_BATCH_SIZE*BLOCK_DATA_SIZE);
+	part->real = (Real_Linear_Scan_Block*)malloc(SCAN_BATCH_SIZE*sizeof(Real_Linear_Scan_Block));
+	part->encBlocks = (Encrypted_Linear_Scan_Block*)malloc(SCAN_BATCH_SIZE*sizeof(Encrypted_Linear_Scan_Block));
+	if(!part->batch || !part->real || !part->encBlocks){
+		free(part->batch);
+		free(part->real);
+		free(part->encBlocks);
+		memset(part, 0, sizeof(Scan_Partition));
+		return 1;
+	}
+	return 0;
+}
+
+//scans use at most numThreads threads, fewer if not that many workers have entered the enclave
+int setScanThreads(int numThreads){
+	if(numThreads < 1) numThreads = 1;
+	if(numThreads > MAX_SCAN_THREADS) numThreads = MAX_SCAN_THREADS;
+	int ret = 0;
+	sgx_thread_mutex_lock(&scanPoolLock);
+	for(int i = 0; i < numThreads && ret == 0; i++){
+		ret = initScanPartition(&scanPartitions[i]);
+	}
+	if(ret == 0) scanThreads = numThreads;
+	sgx_thread_mutex_unlock(&scanPoolLock);
+	return ret;
+}
+
+//called by each app worker thread, returns once stopScanWorkers is called
+int scanWorkerLoop(){
+	sgx_thread_mutex_lock(&scanPoolLock);
+	scanWorkers++;
+	while(!stopScanPool){
+		if(scanJob != NULL && nextScanPart < scanParts){
+			Scan_Job* job = scanJob;
+			Scan_Partition* part = &scanPartitions[nextScanPart++];
+			sgx_thread_mutex_unlock(&scanPoolLock);
+			job->scan(job, part);
+			sgx_thread_mutex_lock(&scanPoolLock);
+			scanPartsLeft--;
+			if(scanPartsLeft == 0) sgx_thread_cond_signal(&scanPoolDone);
+		}
+		else {
+			sgx_thread_cond_wait(&scanPoolWork, &scanPoolLock);
+		}
+	}
+	scanWorkers--;
+	if(scanWorkers == 0) stopScanPool = 0; //the pool can be started again
+	sgx_thread_mutex_unlock(&scanPoolLock);
+	return 0;
+}
+
+int stopScanWorkers(){
+	sgx_thread_mutex_lock(&scanPoolLock);
+	if(scanWorkers > 0) stopScanPool = 1;
+	sgx_thread_cond_broadcast(&scanPoolWork);
+	sgx_thread_mutex_unlock(&scanPoolLock);
+	return 0;
+}
+
+//splits blocks [startIndex, endIndex) of job->structureId into one partition per thread and runs job->scan on each
+//partitions start on batch boundaries and depend only on the range and the thread count, never on the data
+//the calling thread takes partition 0; returns the number of partitions, whose results are in scanPartitions, or -1
+int runScan(Scan_Job* job, int startIndex, int endIndex){
+	if(initScanPartition(&scanPartitions[0])) return -1;
+	sgx_thread_mutex_lock(&scanPoolLock);
+	int numParts = scanThreads;
+	if(numParts > scanWorkers+1) numParts = scanWorkers+1;
+	sgx_thread_mutex_unlock(&scanPoolLock);
+	if(MIXED_USE_MODE) numParts = 1; //the oram bucket cache is shared
+	int numBatches = (endIndex-startIndex+SCAN_BATCH_SIZE-1)/SCAN_BATCH_SIZE;
+	if(numParts > numBatches) numParts = numBatches;
+	if(numParts < 1) numParts = 1;
+
+	for(int p = 0; p < numParts; p++){
+		Scan_Partition* part = &scanPartitions[p];
+		part->start = startIndex + (numBatches*p/numParts)*SCAN_BATCH_SIZE;
+		part->end = startIndex + (numBatches*(p+1)/numParts)*SCAN_BATCH_SIZE;
+		if(part->end > endIndex) part->end = endIndex;
+		part->ret = 0;
+		part->count = 0;
+		part->firstMatch = -1;
+		part->lastMatch = -1;
+		part->stat = 0;
+		part->statRow = -1;
+		part->statSet = 0;
+	}
+
+	if(numParts > 1){
+		sgx_thread_mutex_lock(&scanPoolLock);
+		scanJob = job;
+		scanParts = numParts;
+		nextScanPart = 1;
+		scanPartsLeft = numParts-1;
+		sgx_thread_cond_broadcast(&scanPoolWork);
+		sgx_thread_mutex_unlock(&scanPoolLock);
+	}
+	job->scan(job, &scanPartitions[0]);
+	if(numParts > 1){
+		sgx_thread_mutex_lock(&scanPoolLock);
+		while(scanPartsLeft > 0) sgx_thread_cond_wait(&scanPoolDone, &scanPoolLock);
+		scanJob = NULL;
+		scanParts = 0;
+		sgx_thread_mutex_unlock(&scanPoolLock);
+	}
+
+	for(int p = 0; p < numParts; p++){
+		if(scanPartitions[p].ret) return -1;
+	}
+	return numParts;
+}
@@ -3,11 +3,11 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
-#include <list>
 #include <cstring>
 #include "isv_enclave_t.h"
 #include "sgx_tkey_exchange.h"
 #include "sgx_tcrypto.h"
+#include "sgx_tseal.h"
 #include "string.h"
 #include "stdio.h"
 
@@ -15,6 +15,9 @@
 
 //key for reading/writing to oblivious data structures
 extern sgx_aes_gcm_128bit_key_t *obliv_key;
+extern sgx_aes_gcm_128bit_key_t* oblivKeys[NUM_STRUCTURES];
+extern sgx_aes_ctr_128bit_key_t *iv_key;
+extern Iv_Counter ivCounters[NUM_STRUCTURES];
 //for keeping track of structures, should reflect the structures held by the untrusted app;
 extern int oblivStructureSizes[NUM_STRUCTURES]; //actual size, not logical size for orams
 extern Obliv_Type oblivStructureTypes[NUM_STRUCTURES];
@@ -25,17 +28,39 @@ extern int rowsPerBlock[NUM_STRUCTURES];
 extern int numRows[NUM_STRUCTURES];
 //specific to oram structures
 extern unsigned int* positionMaps[NUM_STRUCTURES];
+extern int posMapIds[NUM_STRUCTURES];
 extern uint8_t* usedBlocks[NUM_STRUCTURES];
+extern int* freeLists[NUM_STRUCTURES];
+extern int freeListSizes[NUM_STRUCTURES];
 extern int* revNum[NUM_STRUCTURES];
-extern std::list<Oram_Block>* stashes[NUM_STRUCTURES];
+extern Oram_Stash stashes[NUM_STRUCTURES];
 extern int stashOccs[NUM_STRUCTURES];//stash occupancy, number of elements in stash
 extern int logicalSizes[NUM_STRUCTURES];
+extern uint8_t* writtenBlocks[NUM_STRUCTURES];
+extern int blockDataSizes[NUM_STRUCTURES];
+extern Storage_Type storageTypes[NUM_STRUCTURES];
+extern int numColumnGroups[NUM_STRUCTURES];
+extern int columnGroupIds[NUM_STRUCTURES][MAX_COLS];
+extern int columnGroupStarts[NUM_STRUCTURES][MAX_COLS+1];
+extern int scanGroupMasks[NUM_STRUCTURES];
 extern node *bPlusRoots[NUM_STRUCTURES];
 extern int lastInserted[NUM_STRUCTURES];
+//specific to ring oram structures
+extern int* ringSlotAddrs[NUM_STRUCTURES];
+extern uint16_t* ringUnread[NUM_STRUCTURES];
+extern uint8_t* ringReads[NUM_STRUCTURES];
+extern int ringAccessCounts[NUM_STRUCTURES];
+extern int ringEvictCounts[NUM_STRUCTURES];
+//specific to circuit oram structures
+extern int circuitEvictCounts[NUM_STRUCTURES];
 
 extern int maxPad;
 extern int currentPad;
 extern Oram_Bucket linOramCache;
+extern Scratch_Arena scratchArenas[NUM_STRUCTURES];
+extern Oram_Bucket* treeTops[NUM_STRUCTURES];
+extern int treeTopLevels[NUM_STRUCTURES];
+extern int treeTopBudget;
 
 
 //isv_enclave.cpp
@@ -48,44 +73,146 @@ sgx_status_t send_msg(
 //enclave_data_structures.cpp
 extern int opOneLinearScanBlock(int structureId, int index, Linear_Scan_Block* block, int write);
 extern int opLinearScanBlock(int structureId, int index, Linear_Scan_Block* block, int write);
+extern int opLinearScanBlocks(int structureId, int startIndex, int numBlocks, Linear_Scan_Block* blocks, int write);
+extern int opLinearScanBlocksWith(int structureId, int startIndex, int numBlocks, Linear_Scan_Block* blocks, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int rewriteBlocks(Scan_Job* job, Scan_Partition* part);
+extern int decryptScanBatch(int structureId, int startIndex, int count, Linear_Scan_Block* blocks, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int decryptLinearBatch(int structureId, int startIndex, int count, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int opPackedRows(int structureId, int startRow, int numRows, Linear_Scan_Block* rows, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int opRowSlots(int structureId, int startRow, int numRows, Linear_Scan_Block* rows, int rowOffset, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int opColumnGroupRows(int structureId, int startRow, int numRows, Linear_Scan_Block* rows, int write, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int openScan(Scan_Iterator* it, int structureId, int startIndex, int endIndex);
+extern int scanNextBatchWith(Scan_Iterator* it, Linear_Scan_Block* blocks, Real_Linear_Scan_Block* real, Encrypted_Linear_Scan_Block* encBlocks);
+extern int scanNextBatch(Scan_Iterator* it, Linear_Scan_Block* blocks);
+extern void closeScan(Scan_Iterator* it);
 extern int opLinearScanUnencryptedBlock(int structureId, int index, Linear_Scan_Block* block, int write);
 extern int opOramBlock(int structureId, int index, Oram_Block* retBlock, int write);
 extern int posMapAccess(int structureId, int index, int* value, int write);
+extern int posMapSwap(int structureId, int index, unsigned int newLeaf, unsigned int* oldLeaf, int safe);
+extern void applyPosMapSwap(Oram_Block* stored, Oram_Block* request);
 extern sgx_status_t oramDistribution(int structureId);
 extern int opOramBlockSafe(int structureId, int index, Oram_Block* retBlock, int write);
 extern int opOramTreeBlock(int structureId, int index, Oram_Tree_Block* block, int write);
-extern int encryptBlock(void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type);
+extern int initIvCounter(int structureId);
+extern int makeIvs(int structureId, uint8_t* iv, int count, int stride);
+extern int encryptBlocks(int structureId, void *ct, void *pt, int numBlocks, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type);
+extern int decryptBlocks(void *ct, void *pt, int numBlocks, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type);
+extern int gcmEncryptBlocks(const sgx_aes_gcm_128bit_key_t *key, const uint8_t *pt, int ptStride, uint8_t *enc, int encStride, int len, int numBlocks);
+extern int gcmDecryptBlocks(const sgx_aes_gcm_128bit_key_t *key, const uint8_t *enc, int encStride, uint8_t *pt, int ptStride, int len, int numBlocks);
+extern int encryptBlock(int structureId, void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type);
 extern int decryptBlock(void *ct, void *pt, sgx_aes_gcm_128bit_key_t *key, Obliv_Type type);
+extern int linearEncBlockSize(int structureId);
+extern int storedBlockSize(int structureId);
+extern int storedBlocks(int structureId);
+extern int encryptLinearBlocks(int structureId, void *ct, Real_Linear_Scan_Block *pt, int numBlocks);
+extern int decryptLinearBlocks(int structureId, void *ct, Real_Linear_Scan_Block *pt, int numBlocks);
 extern int getNextId();
 extern sgx_status_t total_init();
 extern sgx_status_t init_structure(int size, Obliv_Type type, int* structureId);
+extern sgx_status_t init_structure_with_options(int size, Obliv_Type type, int* structureId, Table_Options options);
+extern sgx_status_t init_column_groups(int size, int* structureId, int numGroups, int* groupStarts, Table_Options options);
+extern int setScanGroups(int structureId, int groupMask);
+extern int columnGroupOf(int structureId, int offset);
 extern sgx_status_t free_oram(int structureId);
 extern sgx_status_t free_structure(int structureId);
+extern int initFreeList(int structureId);
+extern void rebuildFreeList(int structureId);
 extern int newBlock(int structureId);
 extern int freeBlock(int structureId, int blockNum);
+extern int initScratchArena(int structureId, Obliv_Type type);
+extern void freeScratchArena(int structureId);
+extern int refillJunkPool(int structureId, int maxBuckets);
+extern Encrypted_Oram_Bucket* takeJunkBucket(int structureId);
+extern sgx_status_t refillJunkPools();
+extern int setTreeTopBudget(int bytes);
+extern int getTreeTopLevels(int structureId);
+extern int initTreeTop(int structureId);
+extern int flushTreeTop(int structureId);
+extern void freeTreeTop(int structureId);
+extern int initStash(int structureId);
+extern void freeStash(int structureId);
+extern int writeEmptyBlocks(int structureId, int start, int end);
+extern int initWrittenBlocks(int structureId, int size);
+extern int growWrittenBlocks(int structureId, int oldSize, int newSize);
+extern int blockWritten(int structureId, int index);
+extern void markWritten(int structureId, int start, int count);
+extern int countWritten(int structureId, int start, int count);
+extern int writeUnwrittenBlocks(int structureId);
+extern int setLazyInit(int on);
+extern int pathBucket(int treeSize, unsigned int leaf, int level);
+extern unsigned int evictionLeaf(int treeSize, int count);
+extern int growLinear(int structureId);
+extern int shrinkLinear(int structureId, int newSize);
+extern int growOram(int structureId);
+extern int stashInsert(int structureId, Oram_Block* block, unsigned int leaf);
+extern void stashRemove(int structureId, int slot);
+extern int stashSlotUsed(int structureId, int slot);
+extern int stashDeepestLevel(int treeSize, int pathLeaf, int destLeaf, int levels);
+extern int stashOrderByDepth(int structureId, int levels);
+
+//enclave_ring_oram.cpp
+extern int initRingOram(int structureId);
+extern void freeRingOram(int structureId);
+extern int ringRand(unsigned int bound, unsigned int* value);
+extern int ringPickDummy(int structureId, int bucket, int* slot);
+extern int ringUnreadSlots(int structureId, int bucket, int* indices);
+extern int ringSealBucket(int structureId, int bucket, int numReal, Encrypted_Oram_Block* enc, int* indices);
+extern int ringOpenSlots(int structureId, Encrypted_Oram_Block* enc, int* indices, int n);
+extern int ringReshuffle(int structureId, int bucket);
+extern int ringEvictPath(int structureId, unsigned int leaf);
+extern int opRingOramBlock(int structureId, int index, Oram_Block* retBlock, int write);
+extern int writeEmptyRingBuckets(int structureId, int start, int end);
+
+//enclave_circuit_oram.cpp
+extern int circuitReadPath(int structureId, unsigned int leaf);
+extern int circuitWritePath(int structureId, unsigned int leaf);
+extern int circuitEvictPath(int structureId, unsigned int leaf);
+extern int opCircuitOramBlock(int structureId, int index, Oram_Block* retBlock, int write);
+
+//enclave_threads.cpp
+extern Scan_Partition scanPartitions[MAX_SCAN_THREADS];
+extern int initScanPartition(Scan_Partition* part);
+extern int setScanThreads(int numThreads);
+extern int scanWorkerLoop();
+extern int stopScanWorkers();
+extern int runScan(Scan_Job* job, int startIndex, int endIndex);
 
 //enclave_db.cpp
 extern int incrementNumRows(int structureId);
 extern int getNumRows(int structureId);
 extern int rowMatchesCondition(Condition c, uint8_t* row, Schema s);
+extern void selectCountScan(Scan_Job* job, Scan_Partition* part);
+extern void aggregateScan(Scan_Job* job, Scan_Partition* part);
+extern void rewriteScan(Scan_Job* job, Scan_Partition* part);
+extern void deleteRewrite(Scan_Job* job, Scan_Partition* part, uint8_t* rows, int firstRow, int numRows);
+extern void updateRewrite(Scan_Job* job, Scan_Partition* part, uint8_t* rows, int firstRow, int numRows);
+extern void readScan(Scan_Job* job, Scan_Partition* part);
 extern int createTable(Schema *schema, char* tableName, int nameLen, Obliv_Type type, int numberOfRows, int* structureId);
+extern int createTableWithOptions(Schema *schema, char* tableName, int nameLen, Obliv_Type type, int numberOfRows, int* structureId, Table_Options options);
 extern int growStructure(int structureId);
+extern int compactTable(char* tableName);
 extern int getTableId(char *tableName);
 extern int renameTable(char *oldTableName, char *newTableName);
 extern int insertRow(char* tableName, uint8_t* row, int key);
+extern int nextAppendSlot(int structureId);
 extern int insertLinRowFast(char* tableName, uint8_t* row);
 extern int insertIndexRowFast(char* tableName, uint8_t* row, int key);
 extern int deleteRow(char* tableName, int key);
 extern int deleteRows(char* tableName, Condition c, int startKey, int endKey);
 extern int updateRows(char* tableName, Condition c, int colChoice, uint8_t* colVal, int startKey, int endKey);
+extern int queryColumnGroups(int structureId, Condition* c, int colChoice, int groupCol, int secondCol);
 extern int selectRows(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate);
 extern int highCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate);
+extern int runSelectRows(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate);
+extern int runHighCardLinGroupBy(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int intermediate);
 extern int printTable(char* tableName);
 extern int printTableCheating(char* tableName);
 extern int createTestTable(char* tableName, int numRows);
 extern Schema getTableSchema(char *tableName);
 extern int deleteTable(char *tableName);
 
+extern int compactPass(int structureId, int stride, int* dist, uint8_t* batch);
+extern int compactLinearRows(int structureId);
 extern void bitonicSort(int tableId, int startIndex, int size, int flipped, uint8_t* row1, uint8_t* row2);
 extern void bitonicMerge(int tableId, int startIndex, int size, int flipped, uint8_t* row1, uint8_t* row2);
 extern void smallBitonicSort(uint8_t* bothTables, int startIndex, int size, int flipped);
@@ -101,8 +228,19 @@ extern void opaqueSort(int tableId, int size);
 extern int joinTables(char* tableName1, char* tableName2, int joinCol1, int joinCol2, int startKey, int endKey);
 extern int indexSelect(char* tableName, int colChoice, Condition c, int aggregate, int groupCol, int algChoice, int key_start, int key_end, int intermediate);
 extern int createTestTableIndex(char* tableName, int numberOfRows);
+extern int fillTableHeader(int structureId, Saved_Table_Header* header);
+extern int writeTableHeader(Saved_Table_Header* header, int fileId);
+extern int readTableHeader(Saved_Table_Header* header, Obliv_Type type);
+extern int writeSnapshotSection(int structureId, Saved_Table_Header* header, int section, void* data, int size, int fileId);
+extern int readSnapshotSection(int structureId, Saved_Table_Header* header, int section, void* data, int size);
 extern int saveIndexTable(char* tableName, int tableSize);
 extern int loadIndexTable(int tableSize);
+extern int hashRevNums(int* revNums, int size, sgx_sha256_hash_t* hash);
+extern int saveTable(char* tableName, int fileId);
+extern int loadTable(char* tableName, int fileId);
+extern int bulkLoadFirstRecord(Bulk_Load_Layout* layout, int h, int j);
+extern int bulkLoadBlock(int structureId, Bulk_Load_Layout* layout, int blockNum, Oram_Block* block);
+extern int bulkLoadIndexTable(char* tableName, char* sourceTableName, int keyCol, int fillPercent, int presorted);
 
 //enclave_tests.cpp
 extern sgx_status_t run_tests();
@@ -115,6 +253,7 @@ extern sgx_status_t testLinScanBlockUnencryptedWritePerformance(int structNum, i
 extern sgx_status_t testOramPerformance(int structNum, int queryIndex, Oram_Block* b, int respLen);
 extern sgx_status_t testOramSafePerformance(int structNum, int queryIndex, Oram_Block* b, int respLen);
 extern sgx_status_t testOpOram();
+extern sgx_status_t testBlockCryptoPerformance(int structNum, int numBlocks, int rounds, int batchSize);
 extern sgx_status_t testOpLinScanBlock();
 
 // FUNCTION PROTOTYPES. (from B+ tree)
@@ -145,6 +284,7 @@ node * insert_into_node_after_splitting(int structureId, node * root, node * par
 node * insert_into_parent(int structureId, node * root, node * left, int key, node * right);
 node * insert_into_new_root(int structureId, node * left, int key, node * right);
 node * start_new_tree(int structureId, int key, record * pointer);
+int indexHasRoom(int structureId);
 node * insert(int structureId,  node * root, int key, record *pointer );
 
 // Deletion.